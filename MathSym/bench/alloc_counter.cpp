@@ -0,0 +1,40 @@
+#include "bench.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+
+//
+// Replacements of the global operator new and delete that count the
+// allocations of the whole executable, for the allocations per operation of
+// the benchmarks
+//
+
+namespace {
+
+atomic<size_t> numAllocations(0);
+
+void * countedAllocate(size_t size) {
+    numAllocations.fetch_add(1, memory_order_relaxed);
+    if (void * pointer = malloc(size ? size : 1))
+        return pointer;
+    throw bad_alloc();
+}
+
+}
+
+
+size_t allocationCount() {
+    return numAllocations.load(memory_order_relaxed);
+}
+
+
+void * operator new(size_t size) { return countedAllocate(size); }
+void * operator new[](size_t size) { return countedAllocate(size); }
+void operator delete(void * pointer) noexcept { free(pointer); }
+void operator delete[](void * pointer) noexcept { free(pointer); }
+void operator delete(void * pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void * pointer, size_t) noexcept { free(pointer); }
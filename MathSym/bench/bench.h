@@ -0,0 +1,51 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//
+// Benchmarks of the MathSym modules. Each benchmark is a command of the
+// MathSymBench executable, run from the directory with the config files.
+//
+
+const std::string TOKENIZER_CONFIG = "tokenizer_config.txt";
+const std::string PARSER_CONFIG = "parser_config.txt";
+const std::string SEMANTICS_CONFIG = "semantics_config.txt";
+
+// Wall-clock stopwatch in nanoseconds
+class Stopwatch {
+public:
+    Stopwatch() : _start(std::chrono::steady_clock::now()) {}
+
+    double elapsedNs() const {
+        return std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - _start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Number of allocations by operator new since the start, counted by the
+// replacement of the global operator new in alloc_counter.cpp
+size_t allocationCount();
+
+int benchStartup(const std::vector<std::string> & args);
+int benchMultiply(const std::vector<std::string> & args);
+int benchBatch(const std::vector<std::string> & args);
+int benchPrepared(const std::vector<std::string> & args);
+int benchNumeric(const std::vector<std::string> & args);
+int benchEngines(const std::vector<std::string> & args);
+int benchRoots(const std::vector<std::string> & args);
+int benchStages(const std::vector<std::string> & args);
+int benchDeep(const std::vector<std::string> & args);
+int benchPower(const std::vector<std::string> & args);
+int benchRational(const std::vector<std::string> & args);
+int benchServer(const std::vector<std::string> & args);
+int benchPipeline(const std::vector<std::string> & args);
+int benchMapped(const std::vector<std::string> & args);
+
+#endif // !BENCH_H
@@ -0,0 +1,64 @@
+#include "batch.h"
+#include "bench.h"
+#include "grammar.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+
+//
+// Throughput of the batch evaluator on a synthetic workload, for a doubling
+// number of threads up to the number of hardware threads. The output of every
+// run is compared with that of the single-threaded run.
+//
+int benchBatch(const vector<string> & args) {
+    size_t numLines = args.empty() ? 200000 : stoul(args[0]);
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+
+    const char * expressions[] = {
+        "(x+1)*(x-2)*(x+3) - 4*x/2",
+        "(6-4)*(5+2)/(4*(4+6/3))",
+        "(x-1)*(x-2) = 0",
+        "3*x + 1 = 2*x - 5",
+        "1/(x-1)",
+        "(1 + 2",
+    };
+    string input;
+    for (size_t i = 0; i < numLines; i++) {
+        input += expressions[i % (sizeof(expressions) / sizeof(expressions[0]))];
+        input += '\n';
+    }
+
+    size_t maxThreads = max(1u, thread::hardware_concurrency());
+    string expected;
+    double baseSeconds = 0;
+    for (size_t threads = 1; ; threads = min(threads * 2, maxThreads)) {
+        istringstream in(input);
+        ostringstream out;
+        BatchStats stats = BatchEvaluator(tokenizer, grammar, threads).run(in, out);
+
+        if (threads == 1) {
+            expected = out.str();
+            baseSeconds = stats.seconds;
+        } else if (out.str() != expected) {
+            cerr << "Error: Output with " << threads << " threads differs from 1 thread" << endl;
+            return 1;
+        }
+
+        cout << "batch.threads_" << threads << ".lines_per_s " << stats.lines / stats.seconds << endl;
+        cout << "batch.threads_" << threads << ".speedup " << baseSeconds / stats.seconds << endl;
+        if (threads == maxThreads)
+            break;
+    }
+    return 0;
+}
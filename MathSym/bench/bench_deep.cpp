@@ -0,0 +1,119 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "prepared_expression.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+
+namespace {
+
+struct Shape {
+    const char * name;
+    string (*line)(size_t numTokens);
+};
+
+// x + 1 + x + 1 ..., a left spine as deep as the line is long
+string flatSum(size_t numTokens) {
+    string line = "x";
+    for (size_t i = 1; i + 1 < numTokens; i += 2)
+        line += (i % 4 == 1) ? "+1" : "+x";
+    return line;
+}
+
+// ((((x + 1) + 1) + 1) ...)
+string nestedGroups(size_t numTokens) {
+    size_t depth = numTokens / 4;
+    string line = string(depth, '(') + "x";
+    for (size_t i = 0; i < depth; i++)
+        line += "+1)";
+    return line;
+}
+
+// 1 - (x - (1 - (x ...))), a right spine through the groups
+string rightNested(size_t numTokens) {
+    size_t depth = numTokens / 4;
+    string line;
+    for (size_t i = 0; i < depth; i++)
+        line += (i % 2) ? "x-(" : "1-(";
+    return line + "x" + string(depth, ')');
+}
+
+// Sums on both sides of an equation
+string equation(size_t numTokens) {
+    return flatSum(numTokens / 2) + "=" + flatSum(numTokens / 2 - 1);
+}
+
+const Shape SHAPES[] = {
+    { "flat_sum", flatSum },
+    { "nested_groups", nestedGroups },
+    { "right_nested", rightNested },
+    { "equation", equation },
+};
+
+}
+
+
+//
+// Stress test of the depth of the trees: lines of up to the given number of
+// tokens (default 1000000), whose trees are about as deep, are evaluated and
+// prepared with both parsing engines, which must neither fail nor run out of
+// stack. Each shape runs at a quarter, half and all of the tokens, and the
+// time per token must stay about the same for the time to be linear.
+//
+int benchDeep(const vector<string> & args) {
+    size_t maxTokens = max<size_t>(16, args.empty() ? 1000000 : stoul(args[0]));
+
+    Tokenizer tokenizer;
+    Grammar ll1;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !ll1.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+    Grammar precedence = ll1;
+    if (!precedence.setEngine(Grammar::OPERATOR_PRECEDENCE))
+        return 1;
+
+    Evaluator evaluators[2] = { Evaluator(tokenizer, ll1), Evaluator(tokenizer, precedence) };
+    const char * engineNames[2] = { "ll1", "precedence" };
+    PreparedExpression prepared;
+    int failures = 0;
+    for (const auto & shape : SHAPES) {
+        for (int e = 0; e < 2; e++) {
+            double firstNsPerToken = 0, nsPerToken = 0;
+            for (size_t numTokens = maxTokens / 4; numTokens <= maxTokens; numTokens *= 2) {
+                string line = shape.line(numTokens);
+                string prefix = string("deep.") + shape.name + "." + engineNames[e] + "." + to_string(numTokens);
+
+                Stopwatch evaluateStopwatch;
+                const Result & result = evaluators[e].evaluate(line);
+                double evaluateNs = evaluateStopwatch.elapsedNs();
+                if (!result.ok) {
+                    cerr << "Error: " << prefix << " failed: " << result.text << endl;
+                    failures++;
+                }
+
+                Stopwatch prepareStopwatch;
+                if (!evaluators[e].prepare(line, prepared).ok) {
+                    cerr << "Error: " << prefix << " failed to prepare" << endl;
+                    failures++;
+                }
+                double prepareNs = prepareStopwatch.elapsedNs();
+
+                nsPerToken = evaluateNs / numTokens;
+                if (firstNsPerToken == 0)
+                    firstNsPerToken = nsPerToken;
+                cout << prefix << ".evaluate_ns_per_token " << nsPerToken << endl;
+                cout << prefix << ".prepare_ns_per_token " << prepareNs / numTokens << endl;
+            }
+            // Time per token at the most tokens over at the least
+            cout << "deep." << shape.name << "." << engineNames[e] << ".growth "
+                << (firstNsPerToken > 0 ? nsPerToken / firstNsPerToken : 0) << endl;
+        }
+    }
+    cout << "deep.failures " << failures << endl;
+    return failures == 0 ? 0 : 1;
+}
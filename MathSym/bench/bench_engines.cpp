@@ -0,0 +1,154 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "prepared_expression.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+
+namespace {
+
+// Characters inserted into a line to break it
+const char EDITS[] = "+-*/^=()x2 ";
+
+// Random expression of the language, following the productions of
+// parser_config.txt down to the given depth
+class ExpressionGenerator {
+public:
+    explicit ExpressionGenerator(unsigned seed) : _rng(seed) {}
+
+    string line() {
+        string text = _expression(MAX_DEPTH);
+        if (_chance(5))
+            text += " = " + _expression(MAX_DEPTH);
+
+        // Some lines are broken by one edit, for the syntax errors
+        if (_chance(4)) {
+            size_t pos = _rng() % (text.size() + 1);
+            if (_chance(2) && pos < text.size())
+                text.erase(pos, 1);
+            else
+                text.insert(pos, 1, EDITS[_rng() % (sizeof(EDITS) - 1)]);
+        }
+        return text;
+    }
+
+private:
+    static const int MAX_DEPTH = 4;
+
+    bool _chance(unsigned oneIn) { return _rng() % oneIn == 0; }
+
+    string _expression(int depth) {
+        string text = _term(depth);
+        for (unsigned n = _rng() % 3; n > 0; n--)
+            text += (_chance(2) ? " + " : " - ") + _term(depth);
+        return text;
+    }
+
+    string _term(int depth) {
+        string text = (_chance(6) ? "-" : "") + _factor(depth);
+        for (unsigned n = _rng() % 3; n > 0; n--)
+            text += (_chance(3) ? "/" : "*") + _factor(depth);
+        return text;
+    }
+
+    string _factor(int depth) {
+        string text = _base(depth);
+        if (_chance(6))
+            text += "^" + to_string(_rng() % 4);
+        return text;
+    }
+
+    string _base(int depth) {
+        unsigned choice = _rng() % 4;
+        if (depth > 0 && choice == 0)
+            return "(" + _expression(depth - 1) + ")";
+        if (choice == 1)
+            return "x";
+        return to_string(_rng() % 10) + (_chance(8) ? ".5" : "");
+    }
+
+    mt19937 _rng;
+};
+
+}
+
+
+//
+// Differential check of the two parsing engines: every line of a random
+// corpus, with syntax errors, must give the same result and error column
+// with the operator precedence table as with the LL(1) table. Then both are
+// timed on the corpus.
+//
+int benchEngines(const vector<string> & args) {
+    size_t numLines = args.empty() ? 200000 : stoul(args[0]);
+    int repeats = 5;
+
+    Tokenizer tokenizer;
+    Grammar ll1;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !ll1.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+
+    Grammar precedence = ll1;
+    if (!precedence.setEngine(Grammar::OPERATOR_PRECEDENCE))
+        return 1;
+
+    ExpressionGenerator generator(1);
+    vector<string> lines(numLines);
+    for (auto & line : lines)
+        line = generator.line();
+
+    Evaluator ll1Evaluator(tokenizer, ll1);
+    Evaluator precedenceEvaluator(tokenizer, precedence);
+    size_t syntaxErrors = 0, mismatches = 0;
+    for (const auto & line : lines) {
+        Result expected = ll1Evaluator.evaluate(line);
+        const Result & actual = precedenceEvaluator.evaluate(line);
+        syntaxErrors += (expected.errorColumn != Result::NO_COLUMN);
+        if (actual.ok != expected.ok || actual.text != expected.text
+            || actual.errorColumn != expected.errorColumn) {
+            if (mismatches++ < 10)
+                cerr << "Error: Engines differ on \"" << line << "\": \"" << expected.text << "\" vs. \""
+                    << actual.text << '"' << endl;
+        }
+    }
+    cout << "engines.lines " << numLines << endl;
+    cout << "engines.syntax_errors " << syntaxErrors << endl;
+    cout << "engines.mismatches " << mismatches << endl;
+    if (mismatches != 0)
+        return 1;
+
+    // Best of the repeats, alternating the engines. Preparing a line parses
+    // it without evaluating it, so it mostly times the engine.
+    PreparedExpression prepared;
+    Evaluator * evaluators[2] = { &ll1Evaluator, &precedenceEvaluator };
+    const char * engineNames[2] = { "ll1", "precedence" };
+    double evaluateNs[2] = { 1e300, 1e300 }, prepareNs[2] = { 1e300, 1e300 };
+    for (int r = 0; r < repeats; r++) {
+        for (int e = 0; e < 2; e++) {
+            Stopwatch evaluateStopwatch;
+            for (const auto & line : lines)
+                evaluators[e]->evaluate(line);
+            evaluateNs[e] = min(evaluateNs[e], evaluateStopwatch.elapsedNs());
+
+            Stopwatch prepareStopwatch;
+            for (const auto & line : lines)
+                evaluators[e]->prepare(line, prepared);
+            prepareNs[e] = min(prepareNs[e], prepareStopwatch.elapsedNs());
+        }
+    }
+
+    for (int e = 0; e < 2; e++) {
+        cout << "engines." << engineNames[e] << ".evaluate_ns_per_line " << evaluateNs[e] / numLines << endl;
+        cout << "engines." << engineNames[e] << ".prepare_ns_per_line " << prepareNs[e] / numLines << endl;
+    }
+    cout << "engines.evaluate_speedup " << evaluateNs[0] / evaluateNs[1] << endl;
+    cout << "engines.prepare_speedup " << prepareNs[0] / prepareNs[1] << endl;
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "bench.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+struct BenchCommand {
+    const char * name;
+    int (*run)(const vector<string> & args);
+    const char * usage;
+};
+
+const BenchCommand BENCH_COMMANDS[] = {
+    { "startup", benchStartup, "startup [iterations]  - cold init vs. loading the grammar cache" },
+    { "multiply", benchMultiply, "multiply [max size]   - checks and times schoolbook, Karatsuba and FFT products" },
+    { "batch", benchBatch, "batch [lines]         - batch throughput by number of threads" },
+    { "prepared", benchPrepared, "prepared [iterations] - binding a prepared equation vs. evaluating its text" },
+    { "numeric", benchNumeric, "numeric [points]      - evaluation at many values of x by each method" },
+    { "engines", benchEngines, "engines [lines]       - checks the precedence engine against LL(1) and times both" },
+    { "roots", benchRoots, "roots [max degree]    - checks and times the roots of polynomials by degree" },
+    { "stages", benchStages, "stages [scale]        - time and allocations per line of each stage on generated corpora" },
+    { "deep", benchDeep, "deep [tokens]         - evaluates lines with trees as deep as their tokens, up to 1M" },
+    { "power", benchPower, "power [max exponent]  - compares (x+1)^n with the product of n factors" },
+    { "rational", benchRational, "rational [lines]      - exact rational arithmetic vs. doubles on generated corpora" },
+    { "server", benchServer, "server [address [connections [requests [depth]]]] - load generator of the server mode" },
+    { "pipeline", benchPipeline, "pipeline [lines]      - pipelined batch mode vs. one thread and the thread pool" },
+    { "mapped", benchMapped, "mapped [megabytes]    - batch input from a mapped file vs. getline() on a stream" },
+};
+
+
+int main(int argc, char * argv[])
+{
+    if (argc >= 2) {
+        string name = argv[1];
+        vector<string> args(argv + 2, argv + argc);
+        for (const auto & command : BENCH_COMMANDS)
+            if (name == command.name)
+                return command.run(args);
+    }
+
+    cerr << "Usage: MathSymBench <command> [args]" << endl << endl;
+    cerr << "Commands:" << endl;
+    for (const auto & command : BENCH_COMMANDS)
+        cerr << "    " << command.usage << endl;
+    return 1;
+}
@@ -0,0 +1,173 @@
+#include "batch.h"
+#include "bench.h"
+#include "grammar.h"
+#include "mapped_file.h"
+#include "tokenizer.h"
+#include "vector_kernels.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+using namespace std;
+
+
+namespace {
+
+const char * BENCH_INPUT = "mathsym_bench_input.txt";
+
+// Writes lines of expressions and equations of typical lengths, with varying
+// numbers, up to the given size
+bool writeInput(const string & fileName, size_t size) {
+    mt19937 random(5);
+    uniform_int_distribution<int> number(1, 999);
+    string text;
+    for (size_t i = 0; text.size() < size; i++) {
+        string a = to_string(number(random)), b = to_string(number(random));
+        switch (i % 4) {
+            case 0: text += "(x+" + a + ")*(x-" + b + ")"; break;
+            case 1: text += "x^2-" + a + "*x=" + b; break;
+            case 2: text += a + "/" + b + "+x^3"; break;
+            default: text += "(x-" + a + ")^3/" + b + " = 0"; break;
+        }
+        text += '\n';
+    }
+    ofstream file(fileName, ios::binary);
+    file.write(text.data(), text.size());
+    return !file.fail();
+}
+
+struct SplitRun {
+    double seconds = 0;
+    size_t lines = 0;
+    size_t checksum = 0;   // Sum of the line lengths, the same for every method
+    size_t allocations = 0;
+};
+
+SplitRun splitWithGetline(const string & fileName) {
+    SplitRun run;
+    Stopwatch stopwatch;
+    size_t allocations = allocationCount();
+    ifstream file(fileName, ios::binary);
+    string line;
+    while (getline(file, line)) {
+        run.lines++;
+        run.checksum += line.size();
+    }
+    run.allocations = allocationCount() - allocations;
+    run.seconds = stopwatch.elapsedNs() / 1e9;
+    return run;
+}
+
+SplitRun splitWithMemchr(const MappedFile & file) {
+    SplitRun run;
+    Stopwatch stopwatch;
+    size_t allocations = allocationCount();
+    const char * next = file.data(), * end = file.data() + file.size();
+    while (next != end) {
+        const char * lineBreak = (const char *)memchr(next, '\n', end - next);
+        const char * lineEnd = lineBreak ? lineBreak : end;
+        run.lines++;
+        run.checksum += lineEnd - next;
+        next = lineBreak ? lineBreak + 1 : end;
+    }
+    run.allocations = allocationCount() - allocations;
+    run.seconds = stopwatch.elapsedNs() / 1e9;
+    return run;
+}
+
+SplitRun splitWithKernel(const MappedFile & file) {
+    SplitRun run;
+    Stopwatch stopwatch;
+    size_t allocations = allocationCount();
+    const char * next = file.data(), * end = file.data() + file.size();
+    const char * breaks[512];
+    while (next != end) {
+        size_t numBreaks = VectorKernels::findLineBreaks(next, end, breaks, 512);
+        for (size_t i = 0; i < numBreaks; i++) {
+            run.lines++;
+            run.checksum += breaks[i] - next;
+            next = breaks[i] + 1;
+        }
+        if (numBreaks == 0) {
+            run.lines++;
+            run.checksum += end - next;
+            next = end;
+        }
+    }
+    run.allocations = allocationCount() - allocations;
+    run.seconds = stopwatch.elapsedNs() / 1e9;
+    return run;
+}
+
+}
+
+
+//
+// Batch input from a mapped file against getline() on a file stream, on a
+// generated file of the given number of MB (default 16). First the line
+// splitting alone, by getline(), by memchr() per line and by the vector
+// kernel, then whole batch runs on one thread without the result cache, whose
+// outputs are compared.
+//
+int benchMapped(const vector<string> & args) {
+    size_t megabytes = args.empty() ? 16 : max<size_t>(1, stoul(args[0]));
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+    if (grammar.hasPrecedenceTable())
+        grammar.setEngine(Grammar::OPERATOR_PRECEDENCE);
+
+    if (!writeInput(BENCH_INPUT, megabytes * 1024 * 1024)) {
+        cerr << "Error: Failed to write " << BENCH_INPUT << endl;
+        return 1;
+    }
+    MappedFile file;
+    if (!file.open(BENCH_INPUT)) {
+        cerr << "Error: Failed to map " << BENCH_INPUT << endl;
+        remove(BENCH_INPUT);
+        return 1;
+    }
+    file.adviseSequential();
+    double megabytesRead = file.size() / 1e6;
+
+    bool ok = true;
+    SplitRun getlineRun = splitWithGetline(BENCH_INPUT);
+    const SplitRun splitRuns[] = { getlineRun, splitWithMemchr(file), splitWithKernel(file) };
+    const char * splitNames[] = { "getline", "memchr", "kernel" };
+    for (size_t i = 0; i < 3; i++) {
+        const SplitRun & run = splitRuns[i];
+        if (run.lines != getlineRun.lines || run.checksum != getlineRun.checksum) {
+            cerr << "Error: Lines split by " << splitNames[i] << " differ from getline" << endl;
+            ok = false;
+        }
+        string prefix = string("mapped.split.") + splitNames[i];
+        cout << prefix << ".mb_per_s " << megabytesRead / run.seconds << endl;
+        cout << prefix << ".allocations_per_line " << (double)run.allocations / run.lines << endl;
+    }
+
+    ResultCache cache(0);
+    BatchEvaluator batchEvaluator(tokenizer, grammar, 1, &cache);
+    ifstream in(BENCH_INPUT, ios::binary);
+    ostringstream streamOut, mappedOut;
+    BatchStats streamStats = batchEvaluator.run(in, streamOut);
+    BatchStats mappedStats = batchEvaluator.run(file.data(), file.data() + file.size(), mappedOut);
+    if (streamOut.str() != mappedOut.str()) {
+        cerr << "Error: Output of the mapped file differs from the stream" << endl;
+        ok = false;
+    }
+    cout << "mapped.batch.getline.lines_per_s " << streamStats.lines / streamStats.seconds << endl;
+    cout << "mapped.batch.mapped.lines_per_s " << mappedStats.lines / mappedStats.seconds << endl;
+    cout << "mapped.batch.speedup " << streamStats.seconds / mappedStats.seconds << endl;
+
+    file.close();
+    remove(BENCH_INPUT);
+    return ok ? 0 : 1;
+}
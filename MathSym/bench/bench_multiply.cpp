@@ -0,0 +1,157 @@
+#include "bench.h"
+#include "convolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+
+namespace {
+
+const char * ALGORITHM_NAMES[] = { "automatic", "schoolbook", "karatsuba", "fft" };
+
+vector<double> randomCoefficients(size_t size, bool integers, mt19937 & random) {
+    uniform_real_distribution<double> real(-1, 1);
+    uniform_int_distribution<int> integer(-1000, 1000);
+    vector<double> coefficients(size);
+    for (auto & c : coefficients)
+        c = integers ? integer(random) : real(random);
+    return coefficients;
+}
+
+// Largest difference from the schoolbook product, relative to the largest
+// possible magnitude of a coefficient
+double relativeError(const vector<double> & lhs, const vector<double> & rhs,
+    Convolution::Algorithm algorithm) {
+
+    vector<double> expected = Convolution::multiply(lhs, rhs, Convolution::SCHOOLBOOK);
+    vector<double> actual = Convolution::multiply(lhs, rhs, algorithm);
+    if (actual.size() != expected.size())
+        return INFINITY;
+
+    double maxLhs = 0, maxRhs = 0, maxError = 0;
+    for (double c : lhs)
+        maxLhs = max(maxLhs, fabs(c));
+    for (double c : rhs)
+        maxRhs = max(maxRhs, fabs(c));
+    for (size_t i = 0; i < actual.size(); i++)
+        maxError = max(maxError, fabs(actual[i] - expected[i]));
+
+    double scale = maxLhs * maxRhs * min(lhs.size(), rhs.size());
+    return scale == 0 ? maxError : maxError / scale;
+}
+
+// Largest difference from the schoolbook product, relative to each
+// coefficient, which the error relative to the largest one can hide
+double coefficientError(const vector<double> & lhs, const vector<double> & rhs,
+    Convolution::Algorithm algorithm) {
+
+    vector<double> expected = Convolution::multiply(lhs, rhs, Convolution::SCHOOLBOOK);
+    vector<double> actual = Convolution::multiply(lhs, rhs, algorithm);
+    if (actual.size() != expected.size())
+        return INFINITY;
+
+    double maxError = 0;
+    for (size_t i = 0; i < actual.size(); i++) {
+        double error = fabs(actual[i] - expected[i]);
+        maxError = max(maxError, expected[i] == 0 ? error : error / fabs(expected[i]));
+    }
+    return maxError;
+}
+
+double timeUs(const vector<double> & lhs, const vector<double> & rhs,
+    Convolution::Algorithm algorithm) {
+
+    // Repeat until the total time is long enough to measure
+    int repetitions = 0;
+    Stopwatch stopwatch;
+    do {
+        volatile double sink = Convolution::multiply(lhs, rhs, algorithm)[0];
+        (void)sink;
+        repetitions++;
+    } while (stopwatch.elapsedNs() < 20e6);
+    return stopwatch.elapsedNs() / repetitions / 1000;
+}
+
+}
+
+
+//
+// Checks the Karatsuba and FFT products against the schoolbook product, then
+// times all three for growing operand sizes to locate the thresholds used by
+// Convolution::choose()
+//
+int benchMultiply(const vector<string> & args) {
+    size_t maxSize = args.empty() ? 4096 : stoul(args[0]);
+    const double TOLERANCE = 1e-12;
+    mt19937 random(12345);
+
+    const size_t checkSizes[][2] = {
+        { 1, 1 }, { 1, 100 }, { 2, 3 }, { 47, 48 }, { 48, 48 }, { 49, 97 }, { 100, 1000 },
+        { 255, 257 }, { 767, 768 }, { 1000, 1000 }, { 1024, 1025 }, { 3000, 50 }, { 4000, 4000 },
+    };
+    bool ok = true;
+    for (const auto & sizes : checkSizes) {
+        for (bool integers : { false, true }) {
+            vector<double> lhs = randomCoefficients(sizes[0], integers, random);
+            vector<double> rhs = randomCoefficients(sizes[1], integers, random);
+            for (auto algorithm : { Convolution::KARATSUBA, Convolution::FFT }) {
+                double error = relativeError(lhs, rhs, algorithm);
+                // Integer products are exact below 2^53
+                bool passed = integers ? error == 0 : error <= TOLERANCE;
+                if (!passed) {
+                    cerr << "Error: " << ALGORITHM_NAMES[algorithm] << " product of sizes "
+                        << sizes[0] << " x " << sizes[1] << (integers ? " (integers)" : "")
+                        << " differs from schoolbook by " << error << endl;
+                    ok = false;
+                }
+            }
+        }
+    }
+
+    // The automatic product must keep every coefficient, however small next
+    // to the largest, within the tolerance of schoolbook: the low ones of
+    // (x - 0.01)^400 (x + 0.02)^400, the middle ones of powers of (x + 0.1)
+    // and (x + 0.5), and those of integers beyond 2^53, such as in (x + 2)^500
+    const double factors[][2] = { { -0.01, 0.02 }, { 0.1, 0.1 }, { 0.5, 0.5 }, { 2, 2 } };
+    const int numFactors[] = { 400, 300, 500, 250 };
+    vector<double> lhs, rhs;
+    for (size_t k = 0; k < 4; k++) {
+        lhs = { 1 };
+        rhs = { 1 };
+        for (int i = 0; i < numFactors[k]; i++) {
+            lhs = Convolution::multiply(lhs, { factors[k][0], 1 }, Convolution::SCHOOLBOOK);
+            rhs = Convolution::multiply(rhs, { factors[k][1], 1 }, Convolution::SCHOOLBOOK);
+        }
+        double error = coefficientError(lhs, rhs, Convolution::AUTOMATIC);
+        if (!(error <= TOLERANCE)) {
+            cerr << "Error: automatic product of (x" << showpos << factors[k][0] << ")^" << numFactors[k]
+                << " and (x" << factors[k][1] << noshowpos << ")^" << numFactors[k]
+                << " differs from schoolbook by " << error << " in a coefficient" << endl;
+            ok = false;
+        }
+    }
+
+    if (!ok)
+        return 1;
+    cout << "multiply.check passed" << endl;
+
+    for (size_t size = 16; size <= maxSize; size *= 2) {
+        for (size_t n : { size, size + size / 2 }) {
+            if (n > maxSize)
+                continue;
+            // The fast paths are only chosen for integer coefficients
+            lhs = randomCoefficients(n, true, random);
+            rhs = randomCoefficients(n, true, random);
+            for (auto algorithm : { Convolution::SCHOOLBOOK, Convolution::KARATSUBA, Convolution::FFT })
+                cout << "multiply." << n << "." << ALGORITHM_NAMES[algorithm] << "_us "
+                    << timeUs(lhs, rhs, algorithm) << endl;
+            cout << "multiply." << n << ".automatic "
+                << ALGORITHM_NAMES[Convolution::choose(lhs, rhs)] << endl;
+        }
+    }
+    return 0;
+}
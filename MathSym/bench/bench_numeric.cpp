@@ -0,0 +1,105 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "prepared_expression.h"
+#include "tokenizer.h"
+#include "vector_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+
+
+namespace {
+
+// Plain scalar evaluation of the same expressions, for the reference values
+double cubic(double x) { return (x + 1) * (x - 2) * (x + 3) - 4 * x / 2; }
+double power(double x) { double y = 1; for (int i = 0; i < 100; i++) y *= x; return y - x; }
+
+}
+
+
+//
+// Evaluates expressions at an array of x values with each numeric method,
+// checks the values against scalar C++ code, and reports the throughput
+//
+int benchNumeric(const vector<string> & args) {
+    size_t count = args.empty() ? 1000000 : stoul(args[0]);
+    int repeats = 20;
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+
+    // x^100 - x is sparse once expanded, so AUTOMATIC runs its program
+    string powerText = "x";
+    for (int i = 1; i < 100; i++)
+        powerText += "*x";
+    powerText += " - x";
+
+    struct Case {
+        const char * name;
+        string text;
+        double (*reference)(double);
+    } cases[] = {
+        { "cubic", "(x+1)*(x-2)*(x+3) - 4*x/2", cubic },
+        { "power", powerText, power },
+    };
+    const char * methodNames[] = { "automatic", "horner", "program" };
+
+    vector<double> xs(count), values(count);
+    for (size_t i = 0; i < count; i++)
+        xs[i] = -1 + 2.0 * i / count;
+
+    Evaluator evaluator(tokenizer, grammar);
+    cout << "numeric.instruction_set " << VectorKernels::instructionSet() << endl;
+    for (auto & c : cases) {
+        PreparedExpression prepared;
+        if (!evaluator.prepare(c.text, prepared).ok)
+            return 1;
+
+        double referenceNs = 0;
+        for (int r = 0; r < repeats; r++) {
+            Stopwatch stopwatch;
+            for (size_t i = 0; i < count; i++)
+                values[i] = c.reference(xs[i]);
+            referenceNs += stopwatch.elapsedNs();
+        }
+        vector<double> expected = values;
+        cout << "numeric." << c.name << ".scalar_mpoints_per_s " << count * repeats / referenceNs * 1000 << endl;
+
+        for (int method = PreparedExpression::AUTOMATIC; method <= PreparedExpression::PROGRAM; method++) {
+            double ns = 0;
+            for (int r = 0; r < repeats; r++) {
+                fill(values.begin(), values.end(), NAN);
+                Stopwatch stopwatch;
+                const Result & result = prepared.evaluateAt(xs.data(), count, values.data(),
+                    (PreparedExpression::NumericMethod)method);
+                ns += stopwatch.elapsedNs();
+                if (!result.ok) {
+                    cerr << "Error: " << result.text << endl;
+                    return 1;
+                }
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                if (!(fabs(values[i] - expected[i]) <= 1e-12 * max(1.0, fabs(expected[i])))) {
+                    cerr << "Error: " << c.name << " by " << methodNames[method] << " at x = " << xs[i]
+                        << " is " << values[i] << " instead of " << expected[i] << endl;
+                    return 1;
+                }
+            }
+
+            // Bytes read from xs and written to values
+            cout << "numeric." << c.name << "." << methodNames[method] << ".mpoints_per_s "
+                << count * repeats / ns * 1000 << endl;
+            cout << "numeric." << c.name << "." << methodNames[method] << ".gb_per_s "
+                << 16.0 * count * repeats / ns << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "batch.h"
+#include "bench.h"
+#include "grammar.h"
+#include "result_cache.h"
+#include "spsc_queue.h"
+#include "tokenizer.h"
+
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+
+namespace {
+
+// Lines of every stage and answer, with varying numbers so that the result
+// cache does not hide the work
+string generateInput(size_t numLines) {
+    mt19937 random(11);
+    uniform_int_distribution<int> number(1, 99);
+    string input;
+    for (size_t i = 0; i < numLines; i++) {
+        string a = to_string(number(random)), b = to_string(number(random)), c = to_string(number(random));
+        switch (i % 5) {
+            case 0: input += "(x+" + a + ")*(x-" + b + ")*(x+" + c + ") - " + a + "*x/" + b; break;
+            case 1: input += "(x-" + a + ")*(x-" + b + ") = " + c; break;
+            case 2: input += "((" + a + "+x)*(" + b + "-x))^3 - " + c + "*x^4"; break;
+            case 3: input += a + "/(x-" + b + ") + " + c; break;
+            default: input += "(" + a + " + " + b + "*x"; break;
+        }
+        input += '\n';
+    }
+    return input;
+}
+
+// Items per second through a queue between two threads
+double queueThroughput(size_t numItems) {
+    SpscQueue<size_t> queue(1024);
+    size_t sum = 0;
+    Stopwatch stopwatch;
+    thread consumer([&]() {
+        for (size_t i = 0; i < numItems; i++)
+            sum += queue.pop();
+    });
+    for (size_t i = 0; i < numItems; i++)
+        queue.push(i);
+    consumer.join();
+    double seconds = stopwatch.elapsedNs() / 1e9;
+    return sum == numItems * (numItems - 1) / 2 ? numItems / seconds : 0;
+}
+
+}
+
+
+//
+// Throughput of the pipelined batch mode against one thread and against the
+// pool with as many threads as the pipeline has stages, without the result
+// cache, with the output of each compared with that of one thread. Also
+// measures the SpscQueue alone.
+//
+int benchPipeline(const vector<string> & args) {
+    size_t numLines = args.empty() ? 200000 : stoul(args[0]);
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+    if (grammar.hasPrecedenceTable())
+        grammar.setEngine(Grammar::OPERATOR_PRECEDENCE);
+
+    string input = generateInput(numLines);
+    string expected;
+    double baseSeconds = 0;
+    const char * modes[] = { "threads_1", "pipeline", "threads_5" };
+    for (const char * mode : modes) {
+        string name = mode;
+        ResultCache cache(0);
+        BatchEvaluator batchEvaluator(tokenizer, grammar, name == "threads_5" ? 5 : 1, &cache);
+        batchEvaluator.setPipelined(name == "pipeline");
+
+        istringstream in(input);
+        ostringstream out;
+        BatchStats stats = batchEvaluator.run(in, out);
+        if (name == "threads_1") {
+            expected = out.str();
+            baseSeconds = stats.seconds;
+        } else if (out.str() != expected) {
+            cerr << "Error: Output of " << name << " differs from 1 thread" << endl;
+            return 1;
+        }
+
+        cout << "pipeline." << name << ".lines_per_s " << stats.lines / stats.seconds << endl;
+        cout << "pipeline." << name << ".speedup " << baseSeconds / stats.seconds << endl;
+    }
+
+    double itemsPerSecond = queueThroughput(10000000);
+    if (itemsPerSecond == 0) {
+        cerr << "Error: Items lost or changed by the queue" << endl;
+        return 1;
+    }
+    cout << "pipeline.queue.items_per_s " << itemsPerSecond << endl;
+    return 0;
+}
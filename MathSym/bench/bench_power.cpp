@@ -0,0 +1,105 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "semantics.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+
+namespace {
+
+// Best time of a few evaluations of the line, which must succeed
+double timeNs(Evaluator & evaluator, const string & line, bool & ok) {
+    double best = 1e300;
+    for (int r = 0; r < 3; r++) {
+        Stopwatch stopwatch;
+        ok = evaluator.evaluate(line).ok;
+        best = min(best, stopwatch.elapsedNs());
+    }
+    return best;
+}
+
+}
+
+
+//
+// Compares (x+1)^n, expanded by repeated squaring, with the product of n
+// factors x+1, for n doubling up to the given maximum (default 1024). Both
+// must give the same answer while the binomial coefficients are exact in
+// doubles, up to n = 50. Then times the largest power of x+1 allowed, and
+// checks that the next one is rejected, and so are products over the same
+// bounds.
+//
+int benchPower(const vector<string> & args) {
+    int maxExponent = args.empty() ? 1024 : stoi(args[0]);
+    const int EXACT_EXPONENT = 50;
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+    if (grammar.hasPrecedenceTable())
+        grammar.setEngine(Grammar::OPERATOR_PRECEDENCE);
+
+    Evaluator evaluator(tokenizer, grammar);
+    int mismatches = 0;
+    for (int n = 2; n <= maxExponent; n *= 2) {
+        string power = "(x+1)^" + to_string(n);
+        string product = "(x+1)";
+        for (int i = 1; i < n; i++)
+            product += "*(x+1)";
+
+        bool powerOk, productOk;
+        evaluator.resetStats();
+        double powerNs = timeNs(evaluator, power, powerOk);
+        uint64_t powerNodes = evaluator.stats().astNodes();
+        evaluator.resetStats();
+        double productNs = timeNs(evaluator, product, productOk);
+        uint64_t productNodes = evaluator.stats().astNodes();
+        if (!powerOk || !productOk || (n <= EXACT_EXPONENT
+            && evaluator.evaluate(power).text != evaluator.evaluate(product).text)) {
+            cerr << "Error: (x+1)^" << n << " differs from the product of its factors" << endl;
+            mismatches++;
+        }
+
+        string prefix = "power." + to_string(n);
+        cout << prefix << ".power_us " << powerNs / 1000 << endl;
+        cout << prefix << ".product_us " << productNs / 1000 << endl;
+        cout << prefix << ".speedup " << productNs / powerNs << endl;
+        cout << prefix << ".power_ast_nodes " << powerNodes / 3 << endl;
+        cout << prefix << ".product_ast_nodes " << productNodes / 3 << endl;
+    }
+    cout << "power.mismatches " << mismatches << endl;
+
+    // The largest power allowed, and the smallest one rejected for its number
+    // of terms, which must fail before doing any work
+    string largest = "(x+1)^" + to_string(Semantics::MAX_POWER_TERMS - 1);
+    string rejected = "(x+1)^" + to_string(Semantics::MAX_POWER_TERMS);
+    bool largestOk, rejectedOk;
+    double largestNs = timeNs(evaluator, largest, largestOk);
+    double rejectedNs = timeNs(evaluator, rejected, rejectedOk);
+    if (!largestOk || rejectedOk) {
+        cerr << "Error: " << (largestOk ? rejected + " was not rejected" : largest + " failed") << endl;
+        return 1;
+    }
+    cout << "power.largest.power_us " << largestNs / 1000 << endl;
+    cout << "power.rejected.power_us " << rejectedNs / 1000 << endl;
+
+    // Products have the same bounds, on their terms and on their degree
+    string productLine = largest + "*" + largest;
+    string degreeLine = "x^" + to_string(Semantics::MAX_POWER_DEGREE) + "*x";
+    bool productOk, degreeOk;
+    double productNs = timeNs(evaluator, productLine, productOk);
+    timeNs(evaluator, degreeLine, degreeOk);
+    if (productOk || degreeOk) {
+        cerr << "Error: " << (productOk ? productLine : degreeLine) << " was not rejected" << endl;
+        return 1;
+    }
+    cout << "power.rejected.product_us " << productNs / 1000 << endl;
+    return mismatches == 0 ? 0 : 1;
+}
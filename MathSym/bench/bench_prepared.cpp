@@ -0,0 +1,80 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "prepared_expression.h"
+#include "tokenizer.h"
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+
+//
+// Evaluates a quadratic equation with many different coefficients, once by
+// binding the placeholders of a prepared expression and once by formatting
+// and evaluating the text of each equation. Both must give the same results.
+//
+int benchPrepared(const vector<string> & args) {
+    size_t iterations = args.empty() ? 200000 : stoul(args[0]);
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+
+    Evaluator evaluator(tokenizer, grammar);
+    PreparedExpression prepared;
+    const Result & prepareResult = evaluator.prepare("$a*x*x + $b*x - $c = 0", prepared);
+    if (!prepareResult.ok) {
+        cerr << "Error: " << prepareResult.text << endl;
+        return 1;
+    }
+    int a = prepared.parameterIndex("a"), b = prepared.parameterIndex("b"), c = prepared.parameterIndex("c");
+
+    // Small integer coefficients, so that the text has the exact same values
+    auto coefficient = [](size_t i, size_t modulus) { return (double)(i % modulus) + 1; };
+
+    size_t checksum = 0;
+    Stopwatch preparedStopwatch;
+    for (size_t i = 0; i < iterations; i++) {
+        prepared.bind(a, coefficient(i, 7));
+        prepared.bind(b, coefficient(i, 11));
+        prepared.bind(c, coefficient(i, 13));
+        checksum += prepared.evaluate().text.size();
+    }
+    double preparedNs = preparedStopwatch.elapsedNs();
+
+    string line;
+    Stopwatch textStopwatch;
+    for (size_t i = 0; i < iterations; i++) {
+        line = to_string(i % 7 + 1) + "*x*x + " + to_string(i % 11 + 1) + "*x - " + to_string(i % 13 + 1) + " = 0";
+        checksum -= evaluator.evaluate(line).text.size();
+    }
+    double textNs = textStopwatch.elapsedNs();
+
+    // Check the results one by one over a full period of the coefficients
+    for (size_t i = 0; i < 7 * 11 * 13 && i < iterations; i++) {
+        prepared.bind(a, coefficient(i, 7));
+        prepared.bind(b, coefficient(i, 11));
+        prepared.bind(c, coefficient(i, 13));
+        line = to_string(i % 7 + 1) + "*x*x + " + to_string(i % 11 + 1) + "*x - " + to_string(i % 13 + 1) + " = 0";
+        const Result & expected = evaluator.evaluate(line);
+        const Result & actual = prepared.evaluate();
+        if (actual.ok != expected.ok || actual.text != expected.text) {
+            cerr << "Error: Prepared result \"" << actual.text << "\" differs from \""
+                << expected.text << "\" for " << line << endl;
+            return 1;
+        }
+    }
+    if (checksum != 0) {
+        cerr << "Error: Prepared and text results differ" << endl;
+        return 1;
+    }
+
+    cout << "prepared.bound_ns " << preparedNs / iterations << endl;
+    cout << "prepared.text_ns " << textNs / iterations << endl;
+    cout << "prepared.speedup " << textNs / preparedNs << endl;
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "rational.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+
+namespace {
+
+// Answers that doubles only approximate or print rounded
+struct ExactCase {
+    const char * line;
+    const char * answer;
+};
+
+const ExactCase EXACT_CASES[] = {
+    { "1/3+1/3+1/3", "ans = 1" },
+    { "0.1+0.2", "ans = 3/10" },
+    { "1/3+1/6", "ans = 1/2" },
+    { "x/3 - x/2", "ans = (-1/6)x" },
+    { "2^100", "ans = 1267650600228229401496703205376" },
+    { "(2^64+1)*(2^64-1)", "ans = 340282366920938463463374607431768211455" },
+    { "2^(-10)", "ans = 1/1024" },
+    { "(10^30+1)-10^30", "ans = 1" },
+    { "(x+1/2)^2", "ans = x^2 + x + 1/4" },
+    { "3*x = 1", "x = 1/3" },
+    { "6*x^2 - x - 1 = 0", "x = 1/2 or x = -1/3" },
+};
+
+// Numbers up to the given one, x and parentheses, with a division by a
+// number in one in the given number of operators, if any
+string randomLine(mt19937 & random, int divisionEvery, int maxNumber) {
+    uniform_int_distribution<int> number(1, maxNumber), length(4, 12);
+    string line;
+    int numOperands = length(random), open = 0;
+    for (int i = 0; i < numOperands; i++) {
+        if (i > 0)
+            line += (divisionEvery > 0 && random() % divisionEvery == 0) ? '/' : "+-*"[random() % 3];
+        if (i + 2 < numOperands && (line.empty() || line.back() != '/') && random() % 4 == 0) {
+            line += '(';
+            open++;
+        }
+        // Divisions are by numbers, to stay polynomials
+        if (!line.empty() && line.back() == '/')
+            line += to_string(number(random));
+        else
+            line += (random() % 3 == 0) ? "x" : to_string(number(random));
+        if (open > 0 && random() % 3 == 0) {
+            line += ')';
+            open--;
+        }
+    }
+    return line + string(open, ')');
+}
+
+struct Corpus {
+    const char * name;
+    vector<string> lines;
+};
+
+struct Run {
+    double nsPerLine = 0;
+    double allocationsPerLine = 0;
+    vector<string> answers;
+};
+
+// Best of a few passes over the corpus, then one more to keep the answers
+Run evaluateCorpus(Evaluator & evaluator, const vector<string> & lines) {
+    Run run;
+    double bestNs = 1e300;
+    size_t allocations = 0;
+    for (int pass = 0; pass < 3; pass++) {
+        size_t allocationsBefore = allocationCount();
+        Stopwatch stopwatch;
+        for (const auto & line : lines)
+            evaluator.evaluate(line);
+        bestNs = min(bestNs, stopwatch.elapsedNs());
+        allocations = allocationCount() - allocationsBefore;
+    }
+    run.nsPerLine = bestNs / lines.size();
+    run.allocationsPerLine = (double)allocations / lines.size();
+
+    for (const auto & line : lines)
+        run.answers.push_back(evaluator.evaluate(line).text);
+    return run;
+}
+
+}
+
+
+//
+// Compares exact rational arithmetic with doubles on generated corpora of
+// the given number of lines (default 2000): small integers, where the exact
+// numbers stay inline and need no allocation, fractions, and numbers beyond
+// 64 bits, which promote them to big integers. Both modes are timed on the
+// same lines and their answers compared. The exact answers of a few lines
+// that doubles get wrong are also checked, and the bound on exact powers and
+// products.
+//
+int benchRational(const vector<string> & args) {
+    size_t numLines = max<size_t>(1, args.empty() ? 2000 : stoul(args[0]));
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+    if (grammar.hasPrecedenceTable())
+        grammar.setEngine(Grammar::OPERATOR_PRECEDENCE);
+
+    Evaluator doubles(tokenizer, grammar), exact(tokenizer, grammar);
+    exact.setExact(true);
+
+    int failures = 0;
+    for (const auto & exactCase : EXACT_CASES) {
+        const Result & result = exact.evaluate(exactCase.line);
+        if (result.text != exactCase.answer) {
+            cerr << "Error: " << exactCase.line << " gives " << result.text << " instead of "
+                << exactCase.answer << endl;
+            failures++;
+        }
+    }
+
+    // Exact powers of polynomials are bounded by their estimated size, and
+    // the first one over the bound must fail before doing any work
+    Stopwatch powerStopwatch;
+    bool largestOk = exact.evaluate("(x+3)^999").ok;
+    double largestNs = powerStopwatch.elapsedNs();
+    bool rejectedOk = exact.evaluate("(x+3)^1000").ok;
+    double rejectedNs = powerStopwatch.elapsedNs() - largestNs;
+    if (!largestOk || rejectedOk) {
+        cerr << "Error: " << (largestOk ? "(x+3)^1000 was not rejected" : "(x+3)^999 failed") << endl;
+        failures++;
+    }
+    cout << "rational.largest_power_us " << largestNs / 1000 << endl;
+    cout << "rational.rejected_power_us " << rejectedNs / 1000 << endl;
+
+    // And so are products, whose operands are within the bound
+    Stopwatch productStopwatch;
+    if (exact.evaluate("(x+3)^999*(x+3)^999").ok) {
+        cerr << "Error: (x+3)^999*(x+3)^999 was not rejected" << endl;
+        failures++;
+    }
+    cout << "rational.rejected_product_us " << productStopwatch.elapsedNs() / 1000 << endl;
+
+    // The arithmetic of inline fractions must not allocate
+    size_t allocationsBefore = allocationCount();
+    bool allSmall = true;
+    for (int i = 1; i <= 100000; i++) {
+        Rational a = Rational(i % 97 + 1) / Rational(i % 89 + 1), b = Rational(i) / Rational(i % 7 + 1);
+        Rational c = (a + b) * (a - b) / b;
+        allSmall = allSmall && c.isSmall();
+    }
+    size_t smallAllocations = allocationCount() - allocationsBefore;
+    if (smallAllocations != 0 || !allSmall) {
+        cerr << "Error: the arithmetic of small fractions allocated " << smallAllocations << " times" << endl;
+        failures++;
+    }
+    cout << "rational.small_arithmetic_allocations " << smallAllocations << endl;
+
+    mt19937 random(2024);
+    Corpus corpora[3] = { { "integers", {} }, { "fractions", {} }, { "big", {} } };
+    for (size_t i = 0; i < numLines; i++) {
+        corpora[0].lines.push_back(randomLine(random, 0, 9));
+        corpora[1].lines.push_back(randomLine(random, 3, 9));
+        // Coefficients of (x+1)^n pass 2^64 from n = 68
+        corpora[2].lines.push_back("(x+" + to_string(random() % 9 + 1) + ")^" + to_string(60 + random() % 40)
+            + "*(" + randomLine(random, 4, 1000000) + ")");
+    }
+
+    for (const auto & corpus : corpora) {
+        Run doubleRun = evaluateCorpus(doubles, corpus.lines);
+        Run exactRun = evaluateCorpus(exact, corpus.lines);
+        size_t differences = 0;
+        for (size_t i = 0; i < corpus.lines.size(); i++)
+            differences += doubleRun.answers[i] != exactRun.answers[i];
+
+        string prefix = string("rational.") + corpus.name;
+        cout << prefix << ".double_ns_per_line " << doubleRun.nsPerLine << endl;
+        cout << prefix << ".exact_ns_per_line " << exactRun.nsPerLine << endl;
+        cout << prefix << ".slowdown " << exactRun.nsPerLine / doubleRun.nsPerLine << endl;
+        cout << prefix << ".double_allocations_per_line " << doubleRun.allocationsPerLine << endl;
+        cout << prefix << ".exact_allocations_per_line " << exactRun.allocationsPerLine << endl;
+        cout << prefix << ".different_answers " << differences << endl;
+    }
+    cout << "rational.failures " << failures << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "root_finder.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+
+namespace {
+
+// Relative backward error of a root: |p(z)| over the sum of the absolute
+// values of the terms, evaluated in 1/z outside the unit disk
+double backwardError(const vector<double> & coefficients, complex<double> z) {
+    size_t n = coefficients.size() - 1;
+    bool reversed = abs(z) > 1;
+    complex<double> x = reversed ? 1.0 / z : z;
+    complex<double> value = 0;
+    double bound = 0;
+    for (size_t i = 0; i <= n; i++) {
+        double c = reversed ? coefficients[i] : coefficients[n - i];
+        value = value * x + c;
+        bound = bound * abs(x) + abs(c);
+    }
+    return abs(value) / bound;
+}
+
+}
+
+
+//
+// Time to find all the roots of polynomials of a doubling degree: with
+// random coefficients, whose roots cluster near the unit circle, and
+// x^n - 1, whose roots are the n-th roots of unity. Every root is checked
+// by its backward error, and the multiplicities must add up to the degree.
+//
+int benchRoots(const vector<string> & args) {
+    int maxDegree = args.empty() ? RootFinder::MAX_DEGREE : stoi(args[0]);
+
+    // Solutions through the whole evaluator, with multiple and complex roots
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+    Evaluator evaluator(tokenizer, grammar);
+    evaluator.setComplexSolutions(true);
+    const char * equations[][2] = {
+        { "(x-1)*(x-2)*(x+3) = 0", "x = -3 or x = 1 or x = 2" },
+        { "(x-1)*(x-1)*(x-1)*(x-1)*(x+2) = 0", "x = -2 or x = 1" },
+        { "(x*x+1)*(x*x+1)*(x-3) = 0", "x = 3 or x = i or x = -i" },
+    };
+    for (const auto & equation : equations) {
+        const Result & result = evaluator.evaluate(equation[0]);
+        if (result.text != equation[1]) {
+            cerr << "Error: Wrong solutions of " << equation[0] << ": " << result.text << endl;
+            return 1;
+        }
+    }
+
+    mt19937 rng(1);
+    uniform_real_distribution<double> distribution(-1, 1);
+    vector<RootFinder::Root> roots;
+    for (int degree = min(4, maxDegree); ; degree = min(degree * 2, maxDegree)) {
+        vector<double> random(degree + 1), unity(degree + 1, 0.0);
+        for (auto & c : random)
+            c = distribution(rng);
+        unity[0] = -1;
+        unity[degree] = 1;
+
+        struct Case {
+            const char * name;
+            const vector<double> & coefficients;
+            int realRoots;   // Or -1 if unknown
+        } cases[] = { { "random", random, -1 }, { "unity", unity, 2 - degree % 2 } };
+        for (const auto & c : cases) {
+            int solves = 0;
+            Stopwatch stopwatch;
+            do {
+                RootFinder::findRoots(c.coefficients, roots);
+                solves++;
+            } while (stopwatch.elapsedNs() < 2e8);
+            double nsPerSolve = stopwatch.elapsedNs() / solves;
+
+            int count = 0, realCount = 0;
+            double maxError = 0;
+            for (const auto & root : roots) {
+                count += root.multiplicity;
+                realCount += root.real;
+                maxError = max(maxError, backwardError(c.coefficients, root.value));
+            }
+            if (count != degree || maxError > 1e-12 * degree
+                || (c.realRoots != -1 && realCount != c.realRoots)) {
+                cerr << "Error: Wrong roots of the " << c.name << " polynomial of degree " << degree
+                    << ": " << count << " roots, " << realCount << " real, backward error " << maxError << endl;
+                return 1;
+            }
+
+            cout << "roots." << c.name << ".degree_" << degree << ".us_per_solve " << nsPerSolve / 1e3 << endl;
+            cout << "roots." << c.name << ".degree_" << degree << ".backward_error " << maxError << endl;
+        }
+        if (degree == maxDegree)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,262 @@
+#include "bench.h"
+#include "grammar.h"
+#include "server.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+#ifdef __linux__
+
+namespace {
+
+const char * BENCH_SOCKET = "mathsym_bench.sock";
+
+// Connects to an address in the syntax of Server::listen, or returns -1
+int connectTo(const string & address) {
+    string port = address.compare(0, 10, "localhost:") == 0 ? address.substr(10) : address;
+    int fd;
+    if (!port.empty() && port.size() <= 5 && port.find_first_not_of("0123456789") == string::npos) {
+        sockaddr_in socketAddress = {};
+        socketAddress.sin_family = AF_INET;
+        socketAddress.sin_port = htons((uint16_t)stoi(port));
+        socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int noDelay = 1;
+        if (fd >= 0)
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if (fd >= 0 && connect(fd, (sockaddr *)&socketAddress, sizeof(socketAddress)) == 0)
+            return fd;
+    } else if (address.size() < sizeof(sockaddr_un::sun_path)) {
+        sockaddr_un socketAddress = {};
+        socketAddress.sun_family = AF_UNIX;
+        copy(address.begin(), address.end(), socketAddress.sun_path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (sockaddr *)&socketAddress, sizeof(socketAddress)) == 0)
+            return fd;
+    } else {
+        return -1;
+    }
+    if (fd >= 0)
+        close(fd);
+    return -1;
+}
+
+void appendFrame(string & buffer, const string & payload) {
+    uint32_t length = (uint32_t)payload.size();
+    char bytes[4] = { (char)(length >> 24), (char)(length >> 16), (char)(length >> 8), (char)length };
+    buffer.append(bytes, 4);
+    buffer += payload;
+}
+
+bool sendAll(int fd, const string & data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (count <= 0)
+            return false;
+        sent += count;
+    }
+    return true;
+}
+
+// Reads the next response, buffering what comes after it
+bool readFrame(int fd, string & buffer, size_t & start, string & payload) {
+    char chunk[64 * 1024];
+    while (true) {
+        if (buffer.size() - start >= 4) {
+            const unsigned char * b = (const unsigned char *)&buffer[start];
+            size_t length = ((size_t)b[0] << 24) | ((size_t)b[1] << 16) | ((size_t)b[2] << 8) | b[3];
+            if (buffer.size() - start - 4 >= length) {
+                payload.assign(buffer, start + 4, length);
+                start += 4 + length;
+                if (start == buffer.size()) {
+                    buffer.clear();
+                    start = 0;
+                }
+                return true;
+            }
+        }
+        ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+        if (count <= 0)
+            return false;
+        buffer.append(chunk, count);
+    }
+}
+
+// Expressions and equations with varying numbers, so that few are repeated
+vector<string> generateLines(size_t numLines) {
+    mt19937 random(7);
+    uniform_int_distribution<int> number(1, 999);
+    vector<string> lines;
+    for (size_t i = 0; i < numLines; i++) {
+        string a = to_string(number(random)), b = to_string(number(random)), c = to_string(number(random));
+        switch (i % 4) {
+            case 0: lines.push_back("(x+" + a + ")*(x-" + b + ")+" + c + "*x"); break;
+            case 1: lines.push_back("x^2-" + a + "*x+" + b + "=" + c); break;
+            case 2: lines.push_back(a + "/" + b + "+x^3-" + c + "*x^2"); break;
+            default: lines.push_back("(x-" + a + ")^3/" + b + "=0"); break;
+        }
+    }
+    return lines;
+}
+
+struct LoadResult {
+    double seconds = 0;
+    size_t requests = 0;
+    size_t failures = 0;      // Lost connections and responses out of order
+    vector<double> latenciesUs;
+};
+
+//
+// Each connection sends its requests in windows of depth pipelined requests,
+// written at once, and then reads their responses. The latency of a request
+// is from the write of its window to the read of its response.
+//
+LoadResult generateLoad(const string & address, const vector<string> & lines, size_t numConnections,
+    size_t requestsPerConnection, size_t depth) {
+    vector<vector<double>> latencies(numConnections);
+    atomic<size_t> failures(0);
+    vector<thread> clients;
+    Stopwatch stopwatch;
+    for (size_t c = 0; c < numConnections; c++) {
+        clients.emplace_back([&, c]() {
+            int fd = connectTo(address);
+            if (fd < 0) {
+                failures++;
+                return;
+            }
+            string requests, buffer, response;
+            size_t start = 0, sent = 0;
+            latencies[c].reserve(requestsPerConnection);
+            while (sent < requestsPerConnection) {
+                size_t window = min(depth, requestsPerConnection - sent);
+                requests.clear();
+                for (size_t i = 0; i < window; i++)
+                    appendFrame(requests, lines[(c * requestsPerConnection + sent + i) % lines.size()]);
+
+                Stopwatch windowStopwatch;
+                if (!sendAll(fd, requests)) {
+                    failures++;
+                    break;
+                }
+                for (size_t i = 0; i < window; i++) {
+                    // Responses are numbered in request order on each connection
+                    string number = to_string(sent + i + 1) + '\t';
+                    if (!readFrame(fd, buffer, start, response) || response.compare(0, number.size(), number) != 0) {
+                        failures++;
+                        close(fd);
+                        return;
+                    }
+                    latencies[c].push_back(windowStopwatch.elapsedNs() / 1000);
+                }
+                sent += window;
+            }
+            close(fd);
+        });
+    }
+    for (auto & client : clients)
+        client.join();
+
+    LoadResult result;
+    result.seconds = stopwatch.elapsedNs() / 1e9;
+    result.failures = failures;
+    for (const auto & connectionLatencies : latencies)
+        result.latenciesUs.insert(result.latenciesUs.end(), connectionLatencies.begin(), connectionLatencies.end());
+    result.requests = result.latenciesUs.size();
+    sort(result.latenciesUs.begin(), result.latenciesUs.end());
+    return result;
+}
+
+double percentile(const vector<double> & sorted, double fraction) {
+    if (sorted.empty())
+        return 0;
+    size_t rank = (size_t)ceil(fraction * sorted.size());
+    return sorted[max<size_t>(rank, 1) - 1];
+}
+
+}
+
+
+//
+// Load generator of the server mode: connections send pipelined requests
+// and the throughput and the percentiles of the latency are measured. Given
+// an address, it loads the server listening there, with the given number of
+// connections (default 4), requests per connection (default 25000) and
+// requests in flight per connection (default 16). Otherwise it starts a
+// server in a thread, on a Unix domain socket, and runs 1 to 16 connections
+// with and without pipelining.
+//
+int benchServer(const vector<string> & args) {
+    vector<string> lines = generateLines(4096);
+    string address = args.empty() ? "-" : args[0];
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    unique_ptr<Server> server;
+    thread serverThread;
+    vector<size_t> connectionCounts = { 1, 4, 16 }, depths = { 1, 16 };
+    size_t totalRequests = 100000;
+    if (address == "-") {
+        if (!tokenizer.init(TOKENIZER_CONFIG)
+            || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+            return 1;
+        if (grammar.hasPrecedenceTable())
+            grammar.setEngine(Grammar::OPERATOR_PRECEDENCE);
+        server.reset(new Server(tokenizer, grammar));
+        if (!server->listen(BENCH_SOCKET))
+            return 1;
+        serverThread = thread([&]() { server->run(); });
+        address = BENCH_SOCKET;
+    } else {
+        connectionCounts = { args.size() > 1 ? max<size_t>(1, stoul(args[1])) : 4 };
+        totalRequests = connectionCounts[0] * (args.size() > 2 ? max<size_t>(1, stoul(args[2])) : 25000);
+        depths = { args.size() > 3 ? max<size_t>(1, stoul(args[3])) : 16 };
+    }
+
+    size_t failures = 0;
+    for (size_t numConnections : connectionCounts) {
+        for (size_t depth : depths) {
+            LoadResult result = generateLoad(address, lines, numConnections, totalRequests / numConnections, depth);
+            failures += result.failures;
+
+            string prefix = "server." + to_string(numConnections) + "_connections.depth_" + to_string(depth);
+            cout << prefix << ".requests_per_s " << (result.seconds > 0 ? result.requests / result.seconds : 0) << endl;
+            cout << prefix << ".p50_us " << percentile(result.latenciesUs, 0.5) << endl;
+            cout << prefix << ".p99_us " << percentile(result.latenciesUs, 0.99) << endl;
+            cout << prefix << ".max_us " << (result.latenciesUs.empty() ? 0 : result.latenciesUs.back()) << endl;
+        }
+    }
+    cout << "server.failures " << failures << endl;
+
+    if (server) {
+        server->stop();
+        serverThread.join();
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+#else
+
+int benchServer(const vector<string> &) {
+    cerr << "Error: The server mode needs epoll, which is only on Linux" << endl;
+    return 1;
+}
+
+#endif
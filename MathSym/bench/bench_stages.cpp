@@ -0,0 +1,188 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "parser.h"
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+
+namespace {
+
+struct Corpus {
+    const char * name;
+    vector<string> lines;
+};
+
+// Long flat sums of numbers and multiples of x
+string flatSum(mt19937 & rng, int numTerms) {
+    string line = "1";
+    for (int i = 1; i < numTerms; i++) {
+        line += (rng() % 2) ? " + " : " - ";
+        line += to_string(rng() % 100);
+        if (rng() % 2)
+            line += "*x";
+    }
+    return line;
+}
+
+// Deeply nested parentheses, each level adding an operation
+string nested(mt19937 & rng, int depth) {
+    string line = "x";
+    const char * operators[] = { "+", "-", "*", "/" };
+    for (int i = 0; i < depth; i++)
+        line = "(" + line + operators[rng() % 4] + to_string(rng() % 9 + 1) + ")";
+    return line;
+}
+
+// Products of many linear factors, which expand into a polynomial of that degree
+string product(mt19937 & rng, int numFactors) {
+    string line;
+    for (int i = 0; i < numFactors; i++) {
+        line += (i == 0) ? "(x" : "*(x";
+        line += (rng() % 2) ? "+" : "-";
+        line += to_string(rng() % 9 + 1) + ")";
+    }
+    return line;
+}
+
+// Equation with integer roots, of degree 1 to 4
+string equation(mt19937 & rng) {
+    return product(rng, 1 + rng() % 4) + " = " + to_string(rng() % 10);
+}
+
+// Short lines of arithmetic, polynomials and equations, as typed at the prompt
+string mixedLine(mt19937 & rng) {
+    switch (rng() % 4) {
+        case 0: return to_string(rng() % 100) + " * (" + to_string(rng() % 10) + " + 4) / 2 - 7";
+        case 1: return "3*x + " + to_string(rng() % 10) + " = 2*x - 5";
+        case 2: return product(rng, 3) + " - 4*x/2";
+        default: return equation(rng);
+    }
+}
+
+void generateCorpora(size_t scale, vector<Corpus> & corpora) {
+    mt19937 rng(1);
+    corpora = { { "flat_sum", {} }, { "nested", {} }, { "product", {} }, { "equations", {} }, { "mixed", {} } };
+    for (size_t i = 0; i < 1000 * scale; i++)
+        corpora[0].lines.push_back(flatSum(rng, 256));
+    for (size_t i = 0; i < 2000 * scale; i++)
+        corpora[1].lines.push_back(nested(rng, 64));
+    for (size_t i = 0; i < 2000 * scale; i++)
+        corpora[2].lines.push_back(product(rng, 24));
+    for (size_t i = 0; i < 20000 * scale; i++)
+        corpora[3].lines.push_back(equation(rng));
+    for (size_t i = 0; i < 20000 * scale; i++)
+        corpora[4].lines.push_back(mixedLine(rng));
+}
+
+// Time and allocations of the best of a few runs of a stage over a corpus
+struct Measurement {
+    double ns = 1e300;
+    size_t allocations = 0;
+};
+
+template<typename Run>
+Measurement measure(Run run) {
+    const int REPEATS = 5;
+    Measurement best;
+    for (int r = 0; r < REPEATS; r++) {
+        size_t allocations = allocationCount();
+        Stopwatch stopwatch;
+        run();
+        double ns = stopwatch.elapsedNs();
+        if (ns < best.ns) {
+            best.ns = ns;
+            best.allocations = allocationCount() - allocations;
+        }
+    }
+    return best;
+}
+
+void report(const string & prefix, const Measurement & measurement, size_t numLines, size_t bytes) {
+    double seconds = measurement.ns / 1e9;
+    cout << prefix << ".ns_per_op " << measurement.ns / numLines << endl;
+    cout << prefix << ".allocs_per_op " << (double)measurement.allocations / numLines << endl;
+    cout << prefix << ".mb_per_s " << (seconds > 0 ? bytes / seconds / 1e6 : 0) << endl;
+}
+
+}
+
+
+//
+// Time per line, allocations per line, and input throughput of each stage
+// of the evaluation over generated corpora: tokenizing, parsing into the
+// AST, evaluating the AST (which includes solving equations), and the whole
+// of Evaluator::evaluate without the result cache. The evaluation stage is
+// the parse and evaluation together, less the parse alone.
+//
+int benchStages(const vector<string> & args) {
+    size_t scale = args.empty() ? 1 : max<size_t>(1, stoul(args[0]));
+
+    Tokenizer tokenizer;
+    Grammar grammar;
+    if (!tokenizer.init(TOKENIZER_CONFIG)
+        || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+        return 1;
+    if (grammar.hasPrecedenceTable())
+        grammar.setEngine(Grammar::OPERATOR_PRECEDENCE);
+    cout << "stages.engine " << (grammar.engine() == Grammar::LL1 ? "ll1" : "precedence") << endl;
+
+    vector<Corpus> corpora;
+    generateCorpora(scale, corpora);
+
+    Parser parser(grammar);
+    Evaluator evaluator(tokenizer, grammar);
+    Result result;
+    for (const auto & corpus : corpora) {
+        const auto & lines = corpus.lines;
+        size_t bytes = 0;
+        vector<vector<Token>> tokens(lines.size());
+        for (size_t i = 0; i < lines.size(); i++) {
+            bytes += lines[i].size() + 1;
+            tokenizer.tokenize(lines[i], tokens[i], result);
+        }
+
+        vector<Token> lineTokens;
+        Measurement tokenize = measure([&]() {
+            for (const auto & line : lines) {
+                lineTokens.clear();
+                tokenizer.tokenize(line, lineTokens, result);
+            }
+        });
+        Measurement parse = measure([&]() {
+            for (size_t i = 0; i < lines.size(); i++)
+                parser.parseTree(tokens[i], lines[i], result);
+        });
+        Measurement parseAndEvaluate = measure([&]() {
+            for (size_t i = 0; i < lines.size(); i++) {
+                result.clear();
+                if (parser.parseTree(tokens[i], lines[i], result))
+                    parser.evaluateTree(result);
+            }
+        });
+        Measurement evaluate;
+        evaluate.ns = max(0.0, parseAndEvaluate.ns - parse.ns);
+        evaluate.allocations = parseAndEvaluate.allocations - min(parse.allocations, parseAndEvaluate.allocations);
+        Measurement endToEnd = measure([&]() {
+            for (const auto & line : lines)
+                evaluator.evaluate(line);
+        });
+
+        size_t numTokens = 0;
+        for (const auto & tokenized : tokens)
+            numTokens += tokenized.size();
+        string prefix = string("stages.") + corpus.name;
+        cout << prefix << ".lines " << lines.size() << endl;
+        cout << prefix << ".tokens_per_line " << (double)numTokens / lines.size() << endl;
+        report(prefix + ".tokenize", tokenize, lines.size(), bytes);
+        report(prefix + ".parse", parse, lines.size(), bytes);
+        report(prefix + ".evaluate", evaluate, lines.size(), bytes);
+        report(prefix + ".end_to_end", endToEnd, lines.size(), bytes);
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "bench.h"
+#include "grammar.h"
+#include "grammar_cache.h"
+#include "tokenizer.h"
+
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+
+const string BENCH_CACHE = "bench_grammar_cache.bin";
+
+//
+// Compares building the tokenizer and grammar tables from the config files
+// against loading them from the binary grammar cache (including hashing the
+// config files, as done at every startup)
+//
+int benchStartup(const vector<string> & args) {
+    int iterations = args.empty() ? 200 : stoi(args[0]);
+    const vector<string> configFiles = { TOKENIZER_CONFIG, PARSER_CONFIG, SEMANTICS_CONFIG };
+
+    double coldNs = 0;
+    for (int i = 0; i < iterations; i++) {
+        Stopwatch stopwatch;
+        Tokenizer tokenizer;
+        Grammar grammar;
+        if (!tokenizer.init(TOKENIZER_CONFIG)
+            || !grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+            return 1;
+        coldNs += stopwatch.elapsedNs();
+
+        if (i == 0 && !GrammarCache::save(BENCH_CACHE, GrammarCache::hashFiles(configFiles),
+            tokenizer, grammar)) {
+            cerr << "Error: Failed to write " << BENCH_CACHE << endl;
+            return 1;
+        }
+    }
+
+    double cachedNs = 0;
+    for (int i = 0; i < iterations; i++) {
+        Stopwatch stopwatch;
+        Tokenizer tokenizer;
+        Grammar grammar;
+        if (!GrammarCache::load(BENCH_CACHE, GrammarCache::hashFiles(configFiles), tokenizer, grammar)) {
+            cerr << "Error: Failed to load " << BENCH_CACHE << endl;
+            return 1;
+        }
+        cachedNs += stopwatch.elapsedNs();
+    }
+    remove(BENCH_CACHE.c_str());
+
+    cout << "startup.cold_init_us " << coldNs / iterations / 1000 << endl;
+    cout << "startup.cached_load_us " << cachedNs / iterations / 1000 << endl;
+    cout << "startup.speedup " << coldNs / cachedNs << endl;
+    return 0;
+}
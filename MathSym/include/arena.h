@@ -0,0 +1,101 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//
+// Chunked bump allocator. Objects are allocated by advancing a pointer in the
+// current chunk, and are all released at once by reset(), which keeps the
+// chunks for reuse. Only trivially destructible objects may be allocated, as
+// their destructors are never run.
+//
+class Arena {
+public:
+    explicit Arena(size_t chunkSize = DEFAULT_CHUNK_SIZE) : _chunkSize(chunkSize) {}
+
+    Arena(Arena &&) = default;
+    Arena & operator=(Arena &&) = default;
+
+    void * allocate(size_t size, size_t alignment) {
+        size_t offset = (_offset + alignment - 1) & ~(alignment - 1);
+        if (_current == _chunks.size() || offset + size > _chunks[_current].size) {
+            _nextChunk(size + alignment);
+            offset = 0;
+        }
+
+        _offset = offset + size;
+        _highWaterMark = std::max(_highWaterMark, bytesUsed());
+        return _chunks[_current].data.get() + offset;
+    }
+
+    template<typename T>
+    T * create() {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T();
+    }
+
+    template<typename T>
+    T * allocateArray(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Releases all the objects in O(1)
+    void reset() {
+        _current = 0;
+        _offset = 0;
+        _bytesInPreviousChunks = 0;
+    }
+
+    size_t bytesUsed() const { return _bytesInPreviousChunks + _offset; }
+    size_t bytesReserved() const {
+        size_t reserved = 0;
+        for (const auto & chunk : _chunks)
+            reserved += chunk.size;
+        return reserved;
+    }
+
+    // Number of chunks allocated since construction, which are never freed
+    size_t numChunks() const { return _chunks.size(); }
+
+    // Largest number of bytes in use at any time since construction
+    size_t highWaterMark() const { return _highWaterMark; }
+
+private:
+    static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    // Moves on to the next chunk with room for the given size, allocating a
+    // new one if none of the remaining chunks is big enough
+    void _nextChunk(size_t size) {
+        if (_current < _chunks.size())
+            _bytesInPreviousChunks += _offset;
+        _current = (_current < _chunks.size()) ? _current + 1 : _current;
+        while (_current < _chunks.size() && _chunks[_current].size < size)
+            _current++;
+
+        if (_current == _chunks.size()) {
+            size_t chunkSize = std::max(_chunkSize, size);
+            _chunks.push_back({ std::unique_ptr<char[]>(new char[chunkSize]), chunkSize });
+        }
+        _offset = 0;
+    }
+
+    size_t _chunkSize;
+    std::vector<Chunk> _chunks;
+    size_t _current = 0;   // Index of the chunk allocated from
+    size_t _offset = 0;    // Bytes used in the current chunk
+    size_t _bytesInPreviousChunks = 0;
+    size_t _highWaterMark = 0;
+};
+
+#endif // !ARENA_H
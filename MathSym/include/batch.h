@@ -0,0 +1,146 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "arena.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "parser.h"
+#include "result.h"
+#include "result_cache.h"
+#include "tokenizer.h"
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct BatchStats {
+    size_t lines = 0;
+    size_t errors = 0;
+    size_t bytes = 0;      // Input bytes, including line breaks
+    size_t threads = 0;
+    double seconds = 0;
+    size_t skippedEvaluations = 0;   // Repeated subexpressions not evaluated again
+};
+
+//
+// Non-interactive evaluation of a stream of expressions, one per line. Every
+// input line produces exactly one output line, tab-separated:
+//
+//     <line number>  ok     <answer>
+//     <line number>  error  <column>  <message>
+//
+// Line numbers and columns start at 1; the column is "-" for errors that do
+// not refer to a position in the line. The output is written in large
+// blocks, without flushing after every line.
+//
+// The input is split into chunks of consecutive lines, which are evaluated
+// in parallel by a WorkStealingPool, each worker with its own Evaluator over
+// the shared Grammar and ResultCache. The output of the chunks is written in
+// input order, and a bounded number of chunks is in flight at a time so that
+// memory stays constant however long the input is.
+//
+// In the pipelined mode, the chunks instead go through a thread per stage:
+// reading, tokenizing, parsing, evaluating and writing, connected by bounded
+// SpscQueues. The parsing stage builds the trees of a chunk in the arena of
+// the chunk, and the evaluating stage evaluates them with a Parser of its
+// own. Each stage handles the chunks in input order, and a fixed number of
+// chunks circulates, so that a slow stage holds back the ones before it.
+//
+class BatchEvaluator {
+public:
+    // Evaluates with the given number of threads, or one per hardware thread
+    // if 0, and with the given result cache, if any
+    BatchEvaluator(const Tokenizer & tokenizer, const Grammar & grammar, size_t numThreads = 1,
+        ResultCache * cache = NULL)
+        : _tokenizer(tokenizer), _grammar(grammar), _numThreads(numThreads), _cache(cache) {}
+
+    // Whether the answers to equations also list their complex solutions
+    void setComplexSolutions(bool complexSolutions) { _complexSolutions = complexSolutions; }
+
+    // Whether lines are evaluated with exact rational arithmetic
+    void setExact(bool exact) { _exact = exact; }
+
+    // Whether the stages run in a pipeline, whatever the number of threads
+    void setPipelined(bool pipelined) { _pipelined = pipelined; }
+
+    BatchStats run(std::istream & in, std::ostream & out);
+
+    // Evaluates the lines of the text [begin, end), such as a mapped file,
+    // in place: the lines are found by a vectorized scan and passed on as
+    // pointers into the text, which is never copied nor written
+    BatchStats run(const char * begin, const char * end, std::ostream & out);
+
+    // Appends the output line of a result to text
+    static void formatResult(std::string & text, size_t lineNumber, const Result & result);
+
+private:
+    static const size_t OUTPUT_BLOCK_SIZE = 64 * 1024;
+    static const size_t CHUNK_LINES = 512;
+    static const size_t CHUNKS_IN_FLIGHT_PER_THREAD = 4;
+    static const size_t PIPELINE_CHUNKS = 8;
+
+    // Line of the input, without its line break
+    struct LineView {
+        const char * begin;
+        const char * end;
+    };
+
+    struct Chunk {
+        size_t firstLine = 0;
+        std::vector<LineView> lines;
+        size_t numLines = 0;    // Lines in use; the vectors keep their memory for reuse
+        std::vector<std::string> texts;   // Lines read from a stream, which the views point into
+        std::string output;
+        size_t errors = 0;
+        bool done = false;
+    };
+
+    // Chunk of the pipelined mode, with the state of its lines between the
+    // stages
+    struct StagedChunk : Chunk {
+        enum LineState {
+            TOKEN_ERROR,    // Answered by the tokenizer
+            SYNTAX_ERROR,   // Answered by the parser, to store in the cache
+            CACHED,         // Answered from the cache
+            PARSED          // To evaluate and store in the cache
+        };
+
+        struct Line {
+            LineState state = TOKEN_ERROR;
+            std::vector<Token> tokens;
+            std::string key;   // Of the result cache
+            Parser::Tree tree;
+            Result result;
+        };
+
+        std::vector<Line> staged;
+        Arena astArena;    // Trees of the lines
+    };
+
+    // Fills a chunk with the next lines of the input and returns their
+    // number, 0 at the end
+    typedef std::function<size_t(Chunk & chunk, BatchStats & stats)> ChunkReader;
+
+    BatchStats _run(const ChunkReader & readChunk, std::ostream & out);
+    size_t _readChunk(std::istream & in, Chunk & chunk, BatchStats & stats) const;
+    size_t _splitChunk(const char *& next, const char * end, Chunk & chunk, BatchStats & stats) const;
+    void _evaluateChunk(Chunk & chunk, Evaluator & evaluator) const;
+
+    void _runPipeline(const ChunkReader & readChunk, BatchStats & stats,
+        const std::function<void(const Chunk &)> & writeChunk) const;
+    void _tokenizeChunk(StagedChunk & chunk) const;
+    void _parseChunk(StagedChunk & chunk, Parser & parser) const;
+    void _evaluateTrees(StagedChunk & chunk, Parser & parser) const;
+
+    const Tokenizer & _tokenizer;
+    const Grammar & _grammar;
+    size_t _numThreads;
+    ResultCache * _cache;
+    bool _complexSolutions = false;
+    bool _exact = false;
+    bool _pipelined = false;
+};
+
+#endif // !BATCH_H
@@ -0,0 +1,73 @@
+#ifndef BIG_INTEGER_H
+#define BIG_INTEGER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Signed integer of any size, stored as its sign and the base 2^32 digits of
+// its magnitude, least significant first, without leading zero digits. It has
+// what exact rationals need once they overflow 64 bits: arithmetic, the
+// greatest common divisor, the integer square root and conversions.
+//
+class BigInteger {
+public:
+    BigInteger() {}
+    BigInteger(int64_t value);
+
+    bool isZero() const { return _digits.empty(); }
+    bool isNegative() const { return _negative; }
+    bool isOne() const { return !_negative && _digits.size() == 1 && _digits[0] == 1; }
+
+    // Whether the value is in (INT64_MIN, INT64_MAX], in which case it is set
+    // in value. INT64_MIN is left out so that small values can be negated.
+    bool toInt64(int64_t & value) const;
+
+    // The value as m * 2^exponent with 0.5 <= |m| < 1, like frexp(), which
+    // does not overflow for values beyond the range of a double
+    double frexp(int & exponent) const;
+
+    // Decimal digits, with a leading '-' if negative
+    std::string toString() const;
+
+    BigInteger operator-() const;
+    BigInteger abs() const;
+
+    friend BigInteger operator+(const BigInteger & lhs, const BigInteger & rhs);
+    friend BigInteger operator-(const BigInteger & lhs, const BigInteger & rhs);
+    friend BigInteger operator*(const BigInteger & lhs, const BigInteger & rhs);
+
+    // Quotient rounded toward 0 and the remainder, with the sign of lhs.
+    // rhs must not be 0.
+    static void divide(const BigInteger & lhs, const BigInteger & rhs, BigInteger & quotient,
+        BigInteger & remainder);
+    friend BigInteger operator/(const BigInteger & lhs, const BigInteger & rhs);
+
+    // Greatest common divisor, which is never negative
+    static BigInteger gcd(BigInteger lhs, BigInteger rhs);
+
+    // Largest integer whose square is at most the value, which must not be
+    // negative
+    BigInteger sqrt() const;
+
+    // Negative, 0 or positive as lhs is less than, equal to or greater than rhs
+    static int compare(const BigInteger & lhs, const BigInteger & rhs);
+    friend bool operator==(const BigInteger & lhs, const BigInteger & rhs) { return compare(lhs, rhs) == 0; }
+    friend bool operator!=(const BigInteger & lhs, const BigInteger & rhs) { return compare(lhs, rhs) != 0; }
+
+private:
+    typedef std::vector<uint32_t> Digits;
+
+    static int _compareMagnitudes(const Digits & lhs, const Digits & rhs);
+    static Digits _addMagnitudes(const Digits & lhs, const Digits & rhs);
+    static Digits _subtractMagnitudes(const Digits & lhs, const Digits & rhs);   // lhs >= rhs
+    static void _divideMagnitudes(const Digits & lhs, const Digits & rhs, Digits & quotient, Digits & remainder);
+    static void _trim(Digits & digits);
+    static BigInteger _signed(Digits digits, bool negative);
+
+    bool _negative = false;
+    Digits _digits;
+};
+
+#endif // !BIG_INTEGER_H
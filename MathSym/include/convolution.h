@@ -0,0 +1,47 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include <cstddef>
+#include <vector>
+
+//
+// Products of dense polynomials, given as coefficient arrays indexed by
+// exponent. Small operands are multiplied with the schoolbook algorithm,
+// medium ones with Karatsuba, and large ones with an FFT-based convolution;
+// the size thresholds were picked with the MathSymBench multiply command.
+//
+// Karatsuba and the FFT subtract large intermediate values, so their error
+// is relative to the largest coefficients rather than to each coefficient.
+// That is harmless for integer coefficients, where the result can be made
+// exact, but it wipes out the small coefficients of e.g. a product of many
+// (x - 0.01) factors, so other operands are always multiplied by schoolbook.
+//
+class Convolution {
+public:
+    enum Algorithm { AUTOMATIC, SCHOOLBOOK, KARATSUBA, FFT };
+
+    // Returns the lhs.size() + rhs.size() - 1 coefficients of the product.
+    // Both operands must be non-empty.
+    static std::vector<double> multiply(const std::vector<double> & lhs,
+        const std::vector<double> & rhs, Algorithm algorithm = AUTOMATIC);
+
+    // The algorithm used by AUTOMATIC for the given operands
+    static Algorithm choose(const std::vector<double> & lhs, const std::vector<double> & rhs);
+
+private:
+    // Karatsuba and FFT products of integers are exact below this magnitude
+    static const double EXACT_INTEGER_LIMIT;
+
+    // Below this size of the smaller operand, schoolbook is fastest
+    static const size_t KARATSUBA_MIN_SIZE = 160;
+    // Karatsuba recursion falls back to schoolbook below this size
+    static const size_t KARATSUBA_BASE_SIZE = 64;
+    // From this size of the smaller operand on, FFT is fastest
+    static const size_t FFT_MIN_SIZE = 384;
+
+    static void _schoolbook(const double * a, size_t na, const double * b, size_t nb, double * c);
+    static void _karatsuba(const double * a, size_t na, const double * b, size_t nb, double * c);
+    static void _fft(const double * a, size_t na, const double * b, size_t nb, double * c);
+};
+
+#endif // !CONVOLUTION_H
@@ -0,0 +1,47 @@
+#ifndef DFA_H
+#define DFA_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//
+// Deterministic finite automaton that recognizes a prioritized set of regular
+// expressions at once. Each rule is compiled into a Thompson NFA, and all the
+// NFAs are then merged into a single table-driven DFA by subset construction,
+// so that matching the next token is a single linear scan of the input.
+//
+class DFA {
+    friend class GrammarCache;
+
+public:
+    struct SyntaxError : std::runtime_error {
+        SyntaxError(const std::string & msg) : std::runtime_error(msg) {}
+    };
+
+    // Adds a rule matching the given regular expression (a subset of the
+    // ECMAScript syntax). Rules added first have higher priority.
+    void addRule(const std::string & regex);
+
+    void compile();
+
+    // Matches the longest prefix of [begin, end) accepted by the rule of
+    // highest priority. Returns the index of that rule, or -1 if no rule
+    // matches a non-empty prefix.
+    int match(const char * begin, const char * end, size_t & length) const;
+
+    size_t stateCount() const { return _acceptRule.size(); }
+
+private:
+    static const int32_t DEAD_STATE = -1;
+
+    std::vector<std::string> _regexes;
+
+    std::vector<uint8_t> _byteClasses;   // Input byte -> equivalence class
+    int _numClasses = 0;
+    std::vector<int32_t> _transitions;   // [state * _numClasses + class] -> state
+    std::vector<int32_t> _acceptRule;    // Highest-priority rule accepted in each state
+};
+
+#endif // !DFA_H
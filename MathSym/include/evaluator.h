@@ -0,0 +1,63 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include "grammar.h"
+#include "parser.h"
+#include "prepared_expression.h"
+#include "result.h"
+#include "result_cache.h"
+#include "tokenizer.h"
+
+#include <string>
+#include <vector>
+
+//
+// Evaluates lines through the tokenizer and the parser, looking up and
+// storing the results in a result cache if one is given. It owns the scratch
+// memory of the whole pipeline, so each thread needs its own Evaluator, while
+// the tokenizer, the grammar, and the cache are shared.
+//
+class Evaluator {
+public:
+    Evaluator(const Tokenizer & tokenizer, const Grammar & grammar, ResultCache * cache = NULL)
+        : _tokenizer(tokenizer), _parser(grammar), _cache(cache) {}
+
+    // The result stays valid until the next call
+    const Result & evaluate(const std::string & line) { return evaluate(line.data(), line.data() + line.size()); }
+
+    // Evaluates the line [begin, end), which is only read, so that it can be
+    // in a larger buffer such as a mapped file
+    const Result & evaluate(const char * begin, const char * end);
+
+    // Compiles the line into prepared, to be evaluated later with its
+    // placeholders bound. A syntax error is returned in the result, which
+    // stays valid until the next call; the result cache is not used.
+    const Result & prepare(const std::string & line, PreparedExpression & prepared);
+
+    // Whether the answers to equations also list their complex solutions. A
+    // result cache must only be shared by evaluators with the same setting.
+    void setComplexSolutions(bool complexSolutions) { _parser.setComplexSolutions(complexSolutions); }
+
+    // Whether lines are evaluated with exact rational arithmetic. The same
+    // goes for the result cache.
+    void setExact(bool exact) { _parser.setExact(exact); }
+
+    const Parser & parser() const { return _parser; }
+
+    // Latencies and sizes of the stages of the lines evaluated so far, from
+    // the tokenizer to the solver
+    const StageStats & stats() const { return _parser.stats(); }
+    void resetStats() { _parser.stats().reset(); }
+
+private:
+    const Tokenizer & _tokenizer;
+    Parser _parser;
+    ResultCache * _cache;
+
+    // Kept across lines to reuse their memory
+    std::vector<Token> _tokens;
+    std::string _key;
+    Result _result;
+};
+
+#endif // !EVALUATOR_H
@@ -0,0 +1,112 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include "token.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+//
+// The LL(1) grammar of the language: its symbols and productions, the parsing
+// table, and the semantic annotations of the terminals. It is built once, by
+// init() or by loading the grammar cache, and never modified afterwards, so
+// a single Grammar can be shared by the parsers of any number of threads.
+//
+class Grammar {
+    friend class GrammarCache;
+    friend class Parser;
+
+public:
+    // Initializes the grammar. The terminal symbols are numbered by the token
+    // kinds of the tokenizer, given as the names of the token types
+    bool init(const std::vector<std::string> & tokenKinds, const std::string & configFile,
+        const std::string & semanticsFile = "");
+
+    // Algorithm used by the parsers to build the AST: the LL(1) table, or the
+    // operator precedence table of the semantics config, which needs far
+    // fewer steps per token. It is chosen once, before any parser is created.
+    enum Engine {
+        LL1,
+        OPERATOR_PRECEDENCE
+    };
+
+    // Returns false if the semantics config has no operator precedence table
+    bool setEngine(Engine engine);
+    Engine engine() const { return _engine; }
+    bool hasPrecedenceTable() const;
+
+private:
+    struct Symbol {
+        enum SymbolType {
+            TERMINAL, NONTERMINAL, EPSILON, EOFL,
+            ACTION   // Only on the parse stack: build action of production id
+        };
+
+        SymbolType type;
+        int id;   // Index into _terminals or _nonterminals
+    };
+
+    struct Production {
+        int lhsSymbol;
+        std::vector<Symbol> rhsSymbols;
+    };
+
+    // Element of the FIRST, FOLLOW, and FIRST+ sets standing for epsilon
+    static const int EPSILON_ID = -1;
+    typedef std::unordered_set<int> SymbolSet;
+
+    // Also gives the line of each production in the file, for errors
+    bool _readConfigFile(const std::string & configFile, std::vector<int> & productionLines);
+
+    bool _readSemanticsFile(const std::string & configFile);
+
+    void _computeFIRST(std::vector<SymbolSet> & FIRST);
+    void _computeFOLLOW(const std::vector<SymbolSet> & FIRST, std::vector<SymbolSet> & FOLLOW);
+    void _computeFIRST_PLUS(const std::vector<SymbolSet> & FIRST,
+        const std::vector<SymbolSet> & FOLLOW, std::vector<SymbolSet> & FIRST_PLUS);
+
+    void _constructLL1Table(const std::vector<SymbolSet> & FIRST_PLUS);
+    void _findOperatorTerminals();
+
+    int _findTerminal(const std::string & name) const;
+    std::string _symbolName(const Symbol & symbol) const;
+
+
+    std::vector<std::string> _terminals;      // Indexed by token kind
+    std::vector<std::string> _nonterminals;
+    std::vector<Production> _productions;
+    int _startSymbol = 0;
+
+    // Production to expand for [nonterminal * _terminals.size() + terminal],
+    // or -1 for a syntax error
+    std::vector<int> _ll1Table;
+
+    static const std::unordered_set<std::string> _binaryOperators;
+    std::vector<uint8_t> _binaryTerminals;    // Indexed by terminal
+    std::vector<int> _unaryOperators;         // Index of the unary operator in each production, or -1
+    std::vector<uint8_t> _unusedTerminals;    // Indexed by terminal
+    std::vector<uint8_t> _operatorTerminals;  // Binary or unary operators, indexed by terminal
+
+    // Index of the symbol of each production after which its operator is
+    // applied to the operands built so far, or -1 (see semantics_config.txt)
+    std::vector<int> _buildActions;
+
+    // Operator precedence table, indexed by terminal (see semantics_config.txt).
+    // A precedence of 0 means the terminal is not such an operator.
+    enum Associativity {
+        LEFT,
+        RIGHT,
+        NONASSOCIATIVE
+    };
+    std::vector<int> _infixPrecedence;
+    std::vector<int> _infixAssociativity;
+    std::vector<int> _prefixPrecedence;
+    std::vector<int> _groupClosers;      // Closing terminal of each opening terminal, or -1
+    std::vector<int> _groupPrecedence;   // Lowest precedence of an operator inside the group
+
+    Engine _engine = LL1;
+};
+
+#endif // !GRAMMAR_H
@@ -0,0 +1,35 @@
+#ifndef GRAMMAR_CACHE_H
+#define GRAMMAR_CACHE_H
+
+#include "grammar.h"
+#include "tokenizer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// On-disk binary image of the initialized tokenizer and grammar tables. The
+// image is keyed by a hash of the config files it was built from, so that a
+// stale image is detected and rebuilt whenever any of the config files
+// changes. Loading maps the file and copies each table in one block, without
+// reading the config files, computing the FIRST/FOLLOW sets, or compiling the
+// tokenizer DFA.
+//
+class GrammarCache {
+public:
+    // Returns a hash of the contents of the given files, or 0 if any of them
+    // cannot be read
+    static uint64_t hashFiles(const std::vector<std::string> & fileNames);
+
+    static bool load(const std::string & cacheFile, uint64_t configHash,
+        Tokenizer & tokenizer, Grammar & grammar);
+
+    static bool save(const std::string & cacheFile, uint64_t configHash,
+        const Tokenizer & tokenizer, const Grammar & grammar);
+
+private:
+    static const uint32_t VERSION = 4;
+};
+
+#endif // !GRAMMAR_CACHE_H
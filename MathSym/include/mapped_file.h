@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+//
+// Read-only memory mapping of a whole file
+//
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    // Maps the file, which must be a regular file: pipes and devices have no
+    // size to map
+    bool open(const std::string & fileName);
+    void close();
+
+    // Hints that the file is read once from start to end, so that the system
+    // reads further ahead and can drop the pages already read
+    void adviseSequential() const;
+
+    const char * data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    const char * _data = NULL;
+    size_t _size = 0;
+
+#ifdef _WIN32
+    void * _fileHandle = NULL;
+    void * _mappingHandle = NULL;
+#else
+    int _fd = -1;
+#endif
+};
+
+#endif // !MAPPED_FILE_H
@@ -1,114 +1,247 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include "arena.h"
+#include "grammar.h"
+#include "polynomial.h"
+#include "prepared_expression.h"
+#include "rational_polynomial.h"
+#include "result.h"
+#include "semantics.h"
+#include "stage_stats.h"
 #include "token.h"
 
-#include <stdexcept>
+#include <cstdint>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
+//
+// Parser and evaluator of one line at a time. It holds the scratch memory of
+// a parse, while the tables come from a Grammar shared with other parsers, so
+// each thread evaluating lines needs its own Parser and nothing else.
+//
 class Parser {
+    struct ASTNode;
+
 public:
-    Parser() : _astNodePool(AST_NODE_POOL_SIZE) {}
+    //
+    // AST of a line built in an arena of the caller instead of the parser's
+    // own, so that it outlives the next parse and can be handed to another
+    // Parser, on another thread, to be evaluated. The tokens, the line and the
+    // arena must stay unchanged until then.
+    //
+    class Tree {
+        friend class Parser;
+
+        ASTNode * _root = NULL;
+        const char * _line = NULL;
+        size_t _lineLength = 0;
+        size_t _numTokens = 0;
+    };
 
-    bool init(const std::string & configFile, const std::string & semanticsFile = "");
+    explicit Parser(const Grammar & grammar) : _grammar(&grammar) {}
 
-    bool parse(std::vector<Token> & tokens, const std::string & line);
+    // Parses and evaluates the tokens of the line [begin, end), which is only
+    // read. The answer or the error is set in result; false is returned on an
+    // error.
+    bool parse(const std::vector<Token> & tokens, const char * begin, const char * end, Result & result) {
+        return parseTree(tokens, begin, end, result) && evaluateTree(result);
+    }
+    bool parse(const std::vector<Token> & tokens, const std::string & line, Result & result) {
+        return parse(tokens, line.data(), line.data() + line.size(), result);
+    }
 
-private:
-    struct Symbol {
-        enum SymbolType {
-            TERMINAL, NONTERMINAL, EPSILON, EOFL
-        };
+    // The two stages of parse(), which can be timed separately. parseTree()
+    // builds the AST, or sets a syntax error in result and returns false.
+    // evaluateTree() then evaluates it, once, while the tokens and the line
+    // are still unchanged; its stages are timed from the end of parseTree().
+    bool parseTree(const std::vector<Token> & tokens, const char * begin, const char * end, Result & result);
+    bool parseTree(const std::vector<Token> & tokens, const std::string & line, Result & result) {
+        return parseTree(tokens, line.data(), line.data() + line.size(), result);
+    }
+    bool evaluateTree(Result & result);
+
+    // The same stages for a tree built in the given arena, which is not
+    // reset, so that the trees of many lines can be built one after the
+    // other. Each tree is evaluated once, by any Parser of the same grammar
+    // and settings; its stages are then timed from the start of
+    // evaluateTree().
+    bool parseTree(const std::vector<Token> & tokens, const char * begin, const char * end, Arena & arena,
+        Tree & tree, Result & result);
+    bool evaluateTree(const Tree & tree, Result & result);
+
+    // Parses the tokens of the given line into a program that can be
+    // evaluated many times with different placeholder values. A syntax error
+    // is set in result and false is returned.
+    bool prepare(const std::vector<Token> & tokens, const std::string & line, PreparedExpression & prepared,
+        Result & result);
+
+    // Whether the answers to equations also list their complex solutions
+    void setComplexSolutions(bool complexSolutions) { _complexSolutions = complexSolutions; }
+
+    // Whether lines are evaluated exactly, with rational coefficients, instead
+    // of with doubles. Numbers are then not folded while parsing, so that they
+    // keep their decimal digits. Prepared expressions always use doubles.
+    void setExact(bool exact) { _exact = exact; }
+
+    // Largest number of bytes taken by the tree of a single parse so far
+    size_t astMemoryHighWaterMark() const { return _astArena.highWaterMark(); }
+
+    // Number of times the value of a repeated subexpression was reused
+    // instead of evaluated again, over all the parses since the stats were
+    // last reset
+    size_t skippedEvaluations() const { return (size_t)_stats.skippedEvaluations(); }
+
+    // Latencies and sizes of the stages of the parses so far. The Evaluator
+    // adds those of the tokenizer.
+    const StageStats & stats() const { return _stats; }
+    StageStats & stats() { return _stats; }
 
-        SymbolType type;
-        std::string name;
-    };
+private:
+    typedef Grammar::Symbol Symbol;
 
-    struct Production {
-        std::string lhsSymbol;
-        std::vector<Symbol> rhsSymbols;
-    };
+    // Lines with fewer tokens are evaluated as trees, without looking for
+    // repeated subexpressions
+    static const size_t MIN_SHARING_TOKENS = 32;
 
     struct ASTNode {
         enum ASTNodeType {
-            EMPTY,
             BINARY_OPERATOR,
             UNARY_LEFT_OPERATOR,
-            OPERAND
+            OPERAND,
+            CONSTANT   // Numeric subexpression folded into its value, with no token
         };
 
-        ASTNode * parent = NULL;
-        std::vector<ASTNode *> children;
-        ASTNodeType type = ASTNodeType::EMPTY;
-        Token * token = NULL;
-    };
+        // Array of child pointers in the arena, one per operand
+        struct ChildList {
+            ASTNode ** items = NULL;
+            size_t count = 0;
 
-    struct Monomial {
-        double coefficient;
-        int exponent;
-    };
-
-    struct _EvalException : std::runtime_error {
-        _EvalException(const std::string & msg) : std::runtime_error(msg) {}
-    };
-
-    bool _readConfigFile(const std::string & configFile,
-        std::unordered_set<std::string> & nonterminals);
-
-    bool _readSemanticsFile(const std::string & configFile);
-
-    void _computeFIRST(const std::unordered_set<std::string> & nonterminals,
-        std::unordered_map<std::string, std::unordered_set<std::string>> & FIRST);
-    void _computeFOLLOW(const std::unordered_set<std::string> & nonterminals,
-        const std::unordered_map<std::string, std::unordered_set<std::string>> & FIRST,
-        std::unordered_map<std::string, std::unordered_set<std::string>> & FOLLOW);
-    void _computeFIRST_PLUS(
-        const std::unordered_map<std::string, std::unordered_set<std::string>> & FIRST,
-        std::unordered_map<std::string, std::unordered_set<std::string>> & FOLLOW,
-        std::vector<std::unordered_set<std::string>> & FIRST_PLUS);
-
-    void _constructLL1Table(const std::vector<std::unordered_set<std::string>> & FIRST_PLUS);
-
-    ASTNode * _parseAndCreateParseTree(std::vector<Token> & tokens, const std::string & line);
-    ASTNode * _convertParseTreeToAST(ASTNode * astTree);
-
-    void _evalASTTree(ASTNode * astTree);
+            ASTNode ** begin() const { return items; }
+            ASTNode ** end() const { return items + count; }
+            size_t size() const { return count; }
+            ASTNode *& operator[](size_t i) const { return items[i]; }
+        };
 
-    void _pruneParseTree(ASTNode * root);
-    bool _moveUpOperators(ASTNode * root);
+        ChildList children;
+        ASTNodeType type = ASTNodeType::OPERAND;
+        const Token * token = NULL;
+        double value = 0;   // CONSTANT
 
-    void _printASTTree(ASTNode * root, int depth);
+        // Set by _hashConsASTTree: structural hash, number of parents sharing
+        // the node, and index of its value in _sharedValues once evaluated
+        uint64_t hash = 0;
+        int uses = 0;
+        int sharedValue = -1;
+    };
 
-    std::vector<Monomial> _evalASTNode(ASTNode * node);
+    ASTNode * _buildAST(const std::vector<Token> & tokens, const char * begin, const char * end, Arena & arena,
+        Result & result);
+    bool _evaluateAST(ASTNode * astTree, size_t numTokens, Result & result);
+    bool _parseLL1(const std::vector<Token> & tokens, Result & result);
+    bool _parseByPrecedence(const std::vector<Token> & tokens, Result & result);
+    bool _parseExpression(Result & result);
+    bool _syntaxError(Result & result) const;
+    void _pushOperand(const Token * token);
+    bool _applyBuildAction(int productionIndex);
+    bool _applyOperator(ASTNode::ASTNodeType type);
+    bool _foldConstants(char op, ASTNode::ASTNodeType type, double lhs, double rhs, double & value) const;
+    bool _isEquation(const ASTNode * astTree) const {
+        return astTree->type != ASTNode::CONSTANT && _line[astTree->token->offset] == '=';
+    }
 
-    std::vector<Monomial> & _addPolynomial(std::vector<Monomial> & lhs, const std::vector<Monomial> & rhs);
-    std::vector<Monomial> & _subtractPolynomial(std::vector<Monomial> & lhs, const std::vector<Monomial> & rhs);
-    std::vector<Monomial> _multiplyPolynomials(const std::vector<Monomial> & lhs, const std::vector<Monomial> & rhs);
-    std::vector<Monomial> _dividePolynomials(const std::vector<Monomial> & lhs, const std::vector<Monomial> & rhs);
+    void _evalASTTree(ASTNode * astTree, Result & result);
+    template <typename Value>
+    void _evalASTTree(ASTNode * astTree, Result & result, std::vector<Value> & valueStack,
+        std::vector<Value> & sharedValues);
 
+    ASTNode * _hashConsASTTree(ASTNode * root);
+    ASTNode * _hashConsASTNode(ASTNode * node);
+    bool _sameASTNode(const ASTNode * lhs, const ASTNode * rhs) const;
 
-    std::vector<Production> _productions;
-    std::string _startSymbol;
-    std::unordered_map<std::string, std::unordered_map<std::string, int>> _ll1Table;
+    void _printASTTree(ASTNode * root);
 
-    static const std::unordered_set<std::string> _binaryOperators;
-    std::unordered_map<int, int> _unaryOperators;
-    std::unordered_set<std::string> _unusedTerminals;
+    template <typename Value>
+    Value _evalASTNode(ASTNode * root, std::vector<Value> & valueStack, std::vector<Value> & sharedValues);
+    void _evalLeaf(const ASTNode * node, Polynomial & value) const;
+    void _evalLeaf(const ASTNode * node, RationalPolynomial & value) const;
+    template <typename Value>
+    void _evalOperator(const ASTNode * node, std::vector<Value> & valueStack);
+    void _compileASTNode(ASTNode * root, PreparedExpression & prepared);
+    void _compileNode(const ASTNode * node, PreparedExpression & prepared);
+    double _tokenNumber(const Token & token) const;
 
+    const Grammar * _grammar;
+    bool _complexSolutions = false;
+    bool _exact = false;
 
     inline ASTNode * _getASTNode() {
-        if (_astNodePoolEnd == _astNodePool.size())
-            return new ASTNode();
-        _astNodePool[_astNodePoolEnd].children = std::vector<ASTNode *>();
-        return &_astNodePool[_astNodePoolEnd++];
+        _numASTNodes++;
+        return _arena->create<ASTNode>();
     }
 
-    static const int AST_NODE_POOL_SIZE = 500;
-    std::vector<ASTNode> _astNodePool;
-    size_t _astNodePoolEnd = 0;
+    const char * _line = NULL;   // Text of the tokens being parsed
+    size_t _lineLength = 0;
+
+    // Tree of the last parseTree(), and the number of its tokens
+    ASTNode * _astTree = NULL;
+    size_t _numTokens = 0;
+
+    // Tokens of the operator precedence engine and the next one to parse
+    const std::vector<Token> * _tokens = NULL;
+    size_t _nextToken = 0;
+
+    // Subexpression being parsed by the operator precedence engine, with what
+    // is left to do once its last operand is parsed
+    struct PrecedenceFrame {
+        enum Continuation {
+            TOP,      // The whole expression
+            PREFIX,   // Apply the prefix operator
+            GROUP,    // Match the closing token of the group
+            INFIX     // Apply the infix operator
+        };
+
+        Continuation continuation;
+        int minPrecedence;   // Of the infix operators in the subexpression
+        int maxPrecedence;
+        int closer;          // GROUP: token kind of the closing token
+        int parentMaxPrecedence;   // INFIX: bound on the operators that follow it
+    };
+    std::vector<PrecedenceFrame> _precedenceStack;
+
+    // Nodes of the AST of the current parse and their child arrays, released
+    // when the next parse starts, and the arena of the parse in progress,
+    // which is another one for a Tree
+    Arena _astArena;
+    Arena * _arena = NULL;
+
+    // Scratch stacks of the parser, kept to reuse their memory across parses:
+    // the symbols left to parse, the operands built so far, and the tokens
+    // of the operators waiting for their build action
+    std::vector<Symbol> _parseStack;
+    std::vector<ASTNode *> _astStack;
+    std::vector<const Token *> _operatorStack;
+
+    // Nodes left to visit by the post-order traversals of the AST, each with
+    // whether its children were visited, and the values of the operands
+    // evaluated so far, in either mode. The traversals use these instead of
+    // recursion, so that the depth of the tree is only bounded by memory.
+    struct TraversalFrame {
+        ASTNode * node;
+        bool childrenDone;
+    };
+    std::vector<TraversalFrame> _traversalStack;
+    std::vector<Polynomial> _valueStack;
+    std::vector<RationalPolynomial> _exactValueStack;
+
+    // Open-addressing table of the distinct subtrees of the current parse,
+    // and the values of the subtrees used more than once
+    std::vector<ASTNode *> _consTable;
+    std::vector<Polynomial> _sharedValues;
+    std::vector<RationalPolynomial> _exactSharedValues;
+
+    StageStats _stats;
+    size_t _numASTNodes = 0;    // Nodes of the current parse
 };
 
 #endif // !PARSER_H
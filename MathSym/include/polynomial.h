@@ -0,0 +1,75 @@
+#ifndef POLYNOMIAL_H
+#define POLYNOMIAL_H
+
+#include <cstddef>
+#include <vector>
+
+//
+// Polynomial in x with real coefficients and non-negative exponents. It is
+// stored densely, as an array of coefficients indexed by exponent, when the
+// degree is small or most of the coefficients are nonzero, and otherwise
+// sparsely, as the list of nonzero terms. The representation is chosen again
+// after every operation, so that e.g. x^100000 + 1 never takes more than two
+// terms, while the sum of dense polynomials is a plain loop over arrays.
+//
+class Polynomial {
+public:
+    struct Term {
+        double coefficient;
+        int exponent;
+    };
+
+    Polynomial() {}
+
+    static Polynomial constant(double coefficient);
+    static Polynomial monomial(double coefficient, int exponent);
+
+    // Polynomial of the given nonzero terms, by ascending exponent
+    static Polynomial fromTerms(std::vector<Term> terms);
+
+    bool isZero() const { return _dense ? _coefficients.empty() : _terms.empty(); }
+
+    // Degree of the polynomial, or -1 for the zero polynomial
+    int degree() const;
+
+    double coefficient(int exponent) const;
+
+    // Nonzero terms by descending exponent
+    std::vector<Term> terms() const;
+
+    bool isDense() const { return _dense; }
+
+    // Number of coefficients stored: all of them up to the degree when dense,
+    // the nonzero ones when sparse
+    size_t size() const { return _dense ? _coefficients.size() : _terms.size(); }
+
+    Polynomial & add(const Polynomial & rhs) { return _addScaled(rhs, 1); }
+    Polynomial & subtract(const Polynomial & rhs) { return _addScaled(rhs, -1); }
+    Polynomial & scale(double factor);
+
+    static Polynomial multiply(const Polynomial & lhs, const Polynomial & rhs);
+
+    // base^exponent by repeated squaring, in O(log exponent) products; base^0
+    // is 1. The degree of the result must fit in an int.
+    static Polynomial power(const Polynomial & base, unsigned exponent);
+
+private:
+    // Below this degree, polynomials are always stored densely
+    static const int DENSE_MAX_SPARSE_DEGREE = 64;
+    // Above it, they are stored densely if at least 1 in DENSE_MIN_FILL of
+    // their coefficients is nonzero
+    static const int DENSE_MIN_FILL = 4;
+
+    Polynomial & _addScaled(const Polynomial & rhs, double factor);
+
+    void _toDense();
+    void _toSparse();
+    void _trim();
+    void _chooseRepresentation();
+
+    bool _dense = true;
+    std::vector<double> _coefficients;   // Dense: indexed by exponent, no trailing zeros
+    std::vector<Term> _terms;            // Sparse: nonzero terms by ascending exponent
+};
+
+#endif // !POLYNOMIAL_H
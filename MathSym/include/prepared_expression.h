@@ -0,0 +1,98 @@
+#ifndef PREPARED_EXPRESSION_H
+#define PREPARED_EXPRESSION_H
+
+#include "polynomial.h"
+#include "result.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// Expression or equation that is tokenized and parsed once, and evaluated any
+// number of times with different values of its placeholders, written as
+// $name in the text. The AST is compiled into a postfix program over
+// polynomials, so an evaluation only runs the arithmetic and never touches
+// the tokenizer or the parser. The same program also evaluates the
+// expression numerically at an array of values of x. Created by
+// Evaluator::prepare(); a prepared expression keeps its own bindings and
+// scratch memory, so each thread needs its own copy.
+//
+class PreparedExpression {
+    friend class Parser;
+
+public:
+    // Names of the placeholders, including the $, in order of first use
+    const std::vector<std::string> & parameters() const { return _parameters; }
+
+    // Index of the placeholder with the given name (with or without the $),
+    // or -1 if there is none
+    int parameterIndex(const std::string & name) const;
+
+    // Returns false if there is no placeholder with the given name
+    bool bind(const std::string & name, double value);
+    void bind(size_t index, double value) {
+        _values[index] = value;
+        _bound[index] = 1;
+    }
+    void unbindAll() { _bound.assign(_bound.size(), 0); }
+
+    bool isEquation() const { return _equation; }
+
+    // Evaluates with the current bindings. The result stays valid until the
+    // next call.
+    const Result & evaluate();
+
+    enum NumericMethod {
+        AUTOMATIC,   // The cheaper of the two below
+        HORNER,      // Expand into a polynomial, then Horner's rule at each x
+        PROGRAM      // Run the program on blocks of x values
+    };
+
+    // Writes the value of the expression at xs[i] to values[i], for i < count,
+    // with the current bindings; for an equation, the value of the left-hand
+    // side minus the right-hand side. The expression is expanded once first,
+    // so a division by zero or by a polynomial is reported in the result as
+    // in evaluate(), and values is left unchanged.
+    const Result & evaluateAt(const double * xs, size_t count, double * values,
+        NumericMethod method = AUTOMATIC);
+
+private:
+    struct Instruction {
+        enum Opcode {
+            CONSTANT, VARIABLE, PARAMETER, ADD, SUBTRACT, MULTIPLY, DIVIDE, POWER, NEGATE
+        };
+
+        Opcode opcode;
+        double constant;   // CONSTANT
+        int parameter;     // PARAMETER: index into _parameters
+    };
+
+    // Values of x evaluated together by PROGRAM, sized so that the blocks
+    // of a few stack levels stay in the L1 cache
+    static const size_t BLOCK_SIZE = 256;
+
+    void _clear();
+    int _addParameter(const std::string & name);
+
+    bool _checkBindings();
+    Polynomial & _expand();
+    void _runOnBlock(const double * xs, size_t count, double * values);
+
+    std::vector<Instruction> _program;
+    bool _complexSolutions = false;   // As set on the parser that prepared it
+    bool _equation = false;   // The program leaves both sides of an equation
+
+    std::vector<std::string> _parameters;
+    std::vector<double> _values;
+    std::vector<uint8_t> _bound;
+
+    // Kept across evaluations to reuse their memory
+    std::vector<Polynomial> _stack;
+    std::vector<double> _coefficients;
+    std::vector<double> _blocks;
+    Result _result;
+};
+
+#endif // !PREPARED_EXPRESSION_H
@@ -0,0 +1,97 @@
+#ifndef RATIONAL_H
+#define RATIONAL_H
+
+#include "big_integer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+//
+// Exact fraction, always in lowest terms with a positive denominator. While
+// the numerator and the denominator fit in 64 bits they are stored inline,
+// and the operations are a few integer instructions with overflow checks and
+// no allocation. A result that overflows is promoted to a pair of
+// BigIntegers on the heap, and goes back inline once it fits again.
+//
+class Rational {
+public:
+    Rational(int64_t value = 0) : _numerator(value) {
+        if (value == INT64_MIN)
+            _setBig(BigInteger(value), BigInteger(1));
+    }
+
+    // numerator / denominator, which must not be 0
+    Rational(const BigInteger & numerator, const BigInteger & denominator) { _setBig(numerator, denominator); }
+
+    Rational(const Rational & other) { *this = other; }
+    Rational(Rational && other) = default;
+    Rational & operator=(const Rational & other);
+    Rational & operator=(Rational && other) = default;
+
+    // Value of a decimal number such as 12 or 0.25, made of digits and at most
+    // one point. Returns false if the text is not such a number.
+    static bool parse(const char * text, size_t length, Rational & value);
+
+    bool isZero() const { return !_big && _numerator == 0; }
+    bool isInteger() const { return _big ? _big->denominator.isOne() : _denominator == 1; }
+    int sign() const;
+
+    // Whether the numerator and denominator are stored inline
+    bool isSmall() const { return !_big; }
+
+    BigInteger numerator() const { return _big ? _big->numerator : BigInteger(_numerator); }
+    BigInteger denominator() const { return _big ? _big->denominator : BigInteger(_denominator); }
+
+    // Closest double, or about it once promoted
+    double toDouble() const;
+
+    // Bits of the magnitude of the numerator plus those of the denominator,
+    // which the time of the arithmetic on the value grows with
+    int bitLength() const;
+
+    // "7/12", or just the numerator for an integer
+    std::string toString() const;
+
+    Rational operator-() const;
+    Rational & operator+=(const Rational & rhs);
+    Rational & operator-=(const Rational & rhs) { return *this += -rhs; }
+    Rational & operator*=(const Rational & rhs);
+    Rational & operator/=(const Rational & rhs);   // rhs must not be 0
+
+    friend Rational operator+(Rational lhs, const Rational & rhs) { return lhs += rhs; }
+    friend Rational operator-(Rational lhs, const Rational & rhs) { return lhs -= rhs; }
+    friend Rational operator*(const Rational & lhs, const Rational & rhs);
+    friend Rational operator/(Rational lhs, const Rational & rhs) { return lhs /= rhs; }
+    friend bool operator==(const Rational & lhs, const Rational & rhs);
+    friend bool operator!=(const Rational & lhs, const Rational & rhs) { return !(lhs == rhs); }
+
+    // base^exponent by repeated squaring; base must not be 0 if exponent < 0
+    static Rational power(const Rational & base, int64_t exponent);
+
+    // Whether the value is the square of a rational, in which case its
+    // non-negative square root is set in root
+    bool sqrt(Rational & root) const;
+
+private:
+    struct Big {
+        BigInteger numerator;
+        BigInteger denominator;
+    };
+
+    void _setBig(BigInteger numerator, BigInteger denominator);
+    void _setInteger(BigInteger value);
+
+    // The numerator of an integer, without copying it once promoted
+    const BigInteger & _integer(BigInteger & scratch) const {
+        return _big ? _big->numerator : (scratch = BigInteger(_numerator));
+    }
+    Big _toBig() const { return { numerator(), denominator() }; }
+
+    int64_t _numerator = 0;
+    int64_t _denominator = 1;
+    std::unique_ptr<Big> _big;   // Only once promoted, when the inline fields are unused
+};
+
+#endif // !RATIONAL_H
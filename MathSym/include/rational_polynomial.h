@@ -0,0 +1,58 @@
+#ifndef RATIONAL_POLYNOMIAL_H
+#define RATIONAL_POLYNOMIAL_H
+
+#include "polynomial.h"
+#include "rational.h"
+
+#include <cstddef>
+#include <vector>
+
+//
+// Polynomial in x with exact rational coefficients, for the exact mode of the
+// Parser. It has the operations of Polynomial, on the list of its nonzero
+// terms only: exact coefficients are not worth a dense array and FFTs.
+//
+class RationalPolynomial {
+public:
+    struct Term {
+        Rational coefficient;
+        int exponent;
+    };
+
+    RationalPolynomial() {}
+
+    static RationalPolynomial constant(const Rational & coefficient);
+    static RationalPolynomial monomial(const Rational & coefficient, int exponent);
+
+    bool isZero() const { return _terms.empty(); }
+
+    // Degree of the polynomial, or -1 for the zero polynomial
+    int degree() const { return _terms.empty() ? -1 : _terms.back().exponent; }
+
+    Rational coefficient(int exponent) const;
+
+    // Nonzero terms by ascending exponent
+    const std::vector<Term> & terms() const { return _terms; }
+
+    size_t size() const { return _terms.size(); }
+
+    RationalPolynomial & add(const RationalPolynomial & rhs) { return _addScaled(rhs, 1); }
+    RationalPolynomial & subtract(const RationalPolynomial & rhs) { return _addScaled(rhs, -1); }
+    RationalPolynomial & scale(const Rational & factor);
+
+    static RationalPolynomial multiply(const RationalPolynomial & lhs, const RationalPolynomial & rhs);
+
+    // base^exponent by repeated squaring; base^0 is 1. The degree of the
+    // result must fit in an int.
+    static RationalPolynomial power(const RationalPolynomial & base, unsigned exponent);
+
+    // The polynomial with its coefficients rounded to doubles
+    Polynomial toPolynomial() const;
+
+private:
+    RationalPolynomial & _addScaled(const RationalPolynomial & rhs, int factor);
+
+    std::vector<Term> _terms;   // Nonzero terms by ascending exponent
+};
+
+#endif // !RATIONAL_POLYNOMIAL_H
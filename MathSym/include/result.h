@@ -0,0 +1,33 @@
+#ifndef RESULT_H
+#define RESULT_H
+
+#include <cstddef>
+#include <string>
+
+//
+// Outcome of evaluating one line of input: the formatted answer, or an error
+// message along with the column of the input it refers to, if any. Keeping
+// the outcome as a value lets the interactive prompt and the batch mode
+// report it each in their own format.
+//
+struct Result {
+    static const size_t NO_COLUMN = (size_t)-1;
+
+    bool ok = true;
+    std::string text;                // E.g. "ans = x + 1", or the error message
+    size_t errorColumn = NO_COLUMN;  // Byte offset into the line of a syntax error
+
+    void clear() {
+        ok = true;
+        text.clear();
+        errorColumn = NO_COLUMN;
+    }
+
+    void setError(const std::string & message, size_t column = NO_COLUMN) {
+        ok = false;
+        text = message;
+        errorColumn = column;
+    }
+};
+
+#endif // !RESULT_H
@@ -0,0 +1,73 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "result.h"
+#include "token.h"
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Bounded cache of the results of evaluated lines, evicting the least
+// recently used entry when full. Lines are keyed by their token stream, i.e.
+// the kind and text of each token, so lines differing only in whitespace
+// share an entry. The cache is split into shards with a lock each, so that
+// it can be shared by the threads of the batch mode.
+//
+class ResultCache {
+public:
+    // Holds up to capacity results; a capacity of 0 disables the cache
+    explicit ResultCache(size_t capacity);
+
+    bool enabled() const { return _capacity != 0; }
+    size_t capacity() const { return _capacity; }
+
+    // Builds the key of the tokens of a line
+    static void makeKey(const std::vector<Token> & tokens, const char * line, std::string & key);
+
+    // Looks up the result of the tokens with the given key. The column of a
+    // syntax error is translated to the whitespace of the given line.
+    bool lookup(const std::string & key, const std::vector<Token> & tokens, size_t lineLength,
+        Result & result);
+    void insert(const std::string & key, const std::vector<Token> & tokens, const Result & result);
+
+    void clear();
+
+    size_t size() const;
+    size_t hits() const { return _hits; }
+    size_t misses() const { return _misses; }
+
+private:
+    static const size_t NUM_SHARDS = 16;
+
+    struct Entry {
+        std::string key;
+        Result result;
+        size_t errorToken;   // Index of the token a syntax error points at
+    };
+
+    // Most recently used entries first
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+        size_t capacity = 0;
+    };
+
+    Shard & _shard(const std::string & key) {
+        return _shards[std::hash<std::string>()(key) % NUM_SHARDS];
+    }
+
+    size_t _capacity;
+    std::unique_ptr<Shard[]> _shards;
+    std::atomic<size_t> _hits;
+    std::atomic<size_t> _misses;
+};
+
+#endif // !RESULT_CACHE_H
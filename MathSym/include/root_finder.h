@@ -0,0 +1,55 @@
+#ifndef ROOT_FINDER_H
+#define ROOT_FINDER_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+//
+// Numerical roots of polynomials of any degree, by the Aberth-Ehrlich method:
+// all the roots are refined simultaneously, each by a Newton step corrected
+// for the roots approximated so far, which converges cubically from starting
+// points spread on circles whose radii come from the Newton polygon of the
+// coefficients. Every iteration takes O(n^2) operations, and their number is
+// bounded, so the time depends only on the degree. Roots of a large modulus
+// are evaluated with the reversed polynomial in 1/x, so that no power of the
+// root overflows.
+//
+class RootFinder {
+public:
+    struct Root {
+        std::complex<double> value;
+        int multiplicity;
+        bool real;   // The imaginary part is 0 within the accuracy of the root
+    };
+
+    // Degree above which the roots are not searched, as the time is quadratic
+    static const int MAX_DEGREE = 1000;
+
+    // Finds the roots of the polynomial with the given coefficients, indexed
+    // by exponent, whose last one must be nonzero. Roots that cannot be told
+    // apart at the precision of the coefficients are returned once, with
+    // their multiplicity, so that the multiplicities add up to the degree.
+    // The roots are sorted by ascending real part, then by descending
+    // imaginary part, so that a conjugate pair is listed as a + bi, a - bi.
+    static void findRoots(const std::vector<double> & coefficients, std::vector<Root> & roots);
+
+private:
+    static const int MAX_ITERATIONS = 100;
+    static const int POLISHING_STEPS = 3;
+
+    // Largest distance between approximations of the same root, relative to
+    // their modulus, which allows multiplicities up to about 6
+    static const double CLUSTER_TOLERANCE;
+
+    // Newton correction p(z) / p'(z) at z, and the radius of a disk around z
+    // that holds a root, including the rounding errors of the evaluation.
+    // Returns false if z is a root within the rounding errors.
+    static bool _newtonCorrection(const std::vector<double> & coefficients, std::complex<double> z,
+        std::complex<double> & correction, double & radius);
+
+    static void _initialApproximations(const std::vector<double> & coefficients,
+        std::vector<std::complex<double>> & approximations);
+};
+
+#endif // !ROOT_FINDER_H
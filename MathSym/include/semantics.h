@@ -0,0 +1,105 @@
+#ifndef SEMANTICS_H
+#define SEMANTICS_H
+
+#include "polynomial.h"
+#include "rational.h"
+#include "rational_polynomial.h"
+#include "result.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+//
+// Operations of the language on evaluated operands, and the answers to
+// expressions and equations. Shared by the evaluation of parse trees and of
+// prepared expressions.
+//
+class Semantics {
+public:
+    struct EvalError : std::runtime_error {
+        EvalError(const std::string & msg) : std::runtime_error(msg) {}
+    };
+
+    // Largest degree of a product or power of polynomials, which keeps the
+    // exponents within an int
+    static const int MAX_POWER_DEGREE = 1000000;
+
+    // Largest number of terms a product or power of polynomials with more
+    // than one term could have, i.e. its degree + 1. Their coefficients
+    // overflow to infinity long before that, and the products of those take
+    // the schoolbook method, whose time grows with the square of the number
+    // of terms: 10000 take about 30 ms, so that one line cannot stall the
+    // others of a server.
+    static const int MAX_POWER_TERMS = 10000;
+
+    // Largest exponent of an exact power of a number, whose digits grow with
+    // the exponent
+    static const int MAX_EXACT_EXPONENT = 100000;
+
+    // Largest estimated size, in bits, of all the coefficients of an exact
+    // power or product of polynomials: its number of terms times the bits of
+    // the largest one, both of which grow with the exponent of a power, and
+    // times 40 for fractions, which take a gcd after each product. The time
+    // grows faster than the square of it: (x+3)^999 is about the largest
+    // power allowed, and takes 0.2 s, and (x+1)^999*(x+1)^999 about the
+    // largest product, and takes 0.7 s.
+    static const double MAX_EXACT_POWER_BITS;
+
+    // Throws EvalError for a product whose degree is above MAX_POWER_DEGREE,
+    // or MAX_POWER_TERMS - 1 unless an operand is a single term
+    static Polynomial multiply(const Polynomial & lhs, const Polynomial & rhs);
+
+    // Throws EvalError for a division by 0 or by a non-constant polynomial
+    static Polynomial divide(const Polynomial & lhs, const Polynomial & rhs);
+
+    // Power of a constant with pow(), or of a polynomial by repeated
+    // squaring. Throws EvalError for a non-constant exponent, a power of 0
+    // with a negative exponent, a fractional power of a negative number, or a
+    // power of a polynomial whose exponent is not a non-negative integer, or
+    // whose degree is above MAX_POWER_DEGREE, or MAX_POWER_TERMS - 1 unless
+    // the polynomial is a single term.
+    static Polynomial power(const Polynomial & lhs, const Polynomial & rhs);
+
+    // Whether base^exponent of constants has a real value, with the rules of
+    // power()
+    static bool hasRealPower(double base, double exponent) {
+        return !(base == 0 && exponent < 0) && !(base < 0 && exponent != std::floor(exponent));
+    }
+
+    // The same in exact mode. A power of a number must have an integer
+    // exponent of at most MAX_EXACT_EXPONENT in magnitude, and a power of a
+    // polynomial, like a product of polynomials with more than one term, an
+    // estimated size of at most MAX_EXACT_POWER_BITS.
+    static RationalPolynomial multiply(const RationalPolynomial & lhs, const RationalPolynomial & rhs);
+    static RationalPolynomial divide(const RationalPolynomial & lhs, const RationalPolynomial & rhs);
+    static RationalPolynomial power(const RationalPolynomial & lhs, const RationalPolynomial & rhs);
+
+    // Sets the value of an expression as the answer in result
+    static void setValue(const Polynomial & value, Result & result);
+
+    // The same with exact coefficients, written as fractions, e.g. 1/3 or
+    // (1/3)x^2 before x
+    static void setValue(const RationalPolynomial & value, Result & result);
+
+    // Solves the equation lhs = 0 and sets the distinct real solutions as the
+    // answer in result, followed by the complex ones if asked for. Equations
+    // of degree > 2 are solved numerically, up to RootFinder::MAX_DEGREE.
+    static void setSolutions(const Polynomial & lhs, Result & result, bool complexSolutions = false);
+
+    // The same in exact mode: the solutions of linear equations, and those of
+    // quadratic equations that are rational, are exact fractions. The others
+    // are irrational, and are found as above from the coefficients rounded to
+    // doubles.
+    static void setSolutions(const RationalPolynomial & lhs, Result & result, bool complexSolutions = false);
+
+    // Appends the number formatted as by the default ostream formatting
+    static void appendNumber(std::string & text, double value);
+
+private:
+    static void _appendComplex(std::string & text, double real, double imag);
+    static void _appendExponent(std::string & text, int exponent);
+    static void _appendCoefficient(std::string & text, const Rational & coefficient, int exponent);
+};
+
+#endif // !SEMANTICS_H
@@ -0,0 +1,114 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "evaluator.h"
+#include "grammar.h"
+#include "result_cache.h"
+#include "tokenizer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+struct ServerStats {
+    size_t connections = 0;   // Accepted
+    size_t requests = 0;
+    size_t errors = 0;        // Requests answered with an error
+    double seconds = 0;
+};
+
+//
+// Long-running server of the evaluator, for clients that would otherwise pay
+// for a process and the loading of the grammar per request. It listens on a
+// Unix domain socket, or on a TCP port of localhost, and serves any number of
+// connections from a single thread with epoll, through one Evaluator over the
+// shared grammar and result cache.
+//
+// Each request is a line, and each response the output line of
+// BatchEvaluator::formatResult for it, without the line break, numbered from
+// 1 on each connection. Both are framed by their length in bytes, as 4 bytes
+// in network order. Clients can pipeline requests: those in the input of a
+// connection are all answered, in order, without waiting for the responses
+// to be read, up to OUTPUT_HIGH_WATER bytes of unread responses. Past that,
+// a connection is read until it has INPUT_HIGH_WATER bytes of unanswered
+// requests, so a client that never reads its responses holds a bounded
+// amount of memory. The bound also limits how much one connection is read
+// before the others are served.
+//
+// epoll is only on Linux; elsewhere listen() fails.
+//
+class Server {
+public:
+    // Requests are lines, so anything longer is a broken client
+    static const uint32_t MAX_REQUEST_SIZE = 64 * 1024;
+
+    // A connection with this many bytes of requests to answer is not read
+    // until they are answered. It holds at least one request of
+    // MAX_REQUEST_SIZE.
+    static const size_t INPUT_HIGH_WATER = 256 * 1024;
+
+    // A connection with this many bytes of responses to write is not read
+    // until they are written
+    static const size_t OUTPUT_HIGH_WATER = 256 * 1024;
+
+    Server(const Tokenizer & tokenizer, const Grammar & grammar, ResultCache * cache = NULL)
+        : _evaluator(tokenizer, grammar, cache) {}
+    ~Server();
+
+    Server(const Server &) = delete;
+    Server & operator=(const Server &) = delete;
+
+    void setComplexSolutions(bool complexSolutions) { _evaluator.setComplexSolutions(complexSolutions); }
+    void setExact(bool exact) { _evaluator.setExact(exact); }
+
+    // Listens on localhost:PORT, or on PORT alone, over TCP, and otherwise on
+    // the Unix domain socket of that path, which is replaced if it exists and
+    // removed by the destructor. Prints the error and returns false if it
+    // cannot.
+    bool listen(const std::string & address);
+
+    // Serves the clients until stop() is called
+    ServerStats run();
+
+    // Makes run() return. It can be called from any thread, and from a
+    // signal handler.
+    void stop();
+
+    const Evaluator & evaluator() const { return _evaluator; }
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;        // Bytes read, of which the first inputStart are answered
+        size_t inputStart = 0;
+        std::string output;       // Responses, of which the first outputStart are written
+        size_t outputStart = 0;
+        size_t requests = 0;
+        uint32_t events = 0;      // Registered with epoll
+        bool peerClosed = false;
+    };
+
+    void _accept(ServerStats & stats);
+    bool _serve(Connection & connection, uint32_t events, ServerStats & stats);
+    bool _read(Connection & connection);
+    bool _answer(Connection & connection, ServerStats & stats);
+    bool _write(Connection & connection);
+    void _close(int fd);
+
+    Evaluator _evaluator;
+    std::unordered_map<int, std::unique_ptr<Connection>> _connections;
+
+    int _listenFd = -1;
+    int _epollFd = -1;
+    int _stopFd = -1;          // eventfd written by stop()
+    bool _tcp = false;
+    std::string _socketPath;   // Unix domain socket to remove
+
+    // Kept across requests to reuse their memory
+    std::string _line;
+    std::string _response;
+};
+
+#endif // !SERVER_H
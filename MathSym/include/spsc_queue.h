@@ -0,0 +1,105 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+//
+// Bounded lock-free queue between one producer thread and one consumer
+// thread. It is a ring of slots with a write index, only stored by the
+// producer, and a read index, only stored by the consumer, each on its own
+// cache line. Each side keeps a copy of the other's index and only reads the
+// shared one again when the copy says the ring is full or empty, so that a
+// busy queue costs about one cache miss per batch of items instead of per
+// item.
+//
+// push() and pop() wait while the queue is full or empty, which is the
+// backpressure between the stages of a pipeline: they spin, then yield, then
+// sleep for short periods, so that a stage waiting for a slow input uses
+// little CPU.
+//
+template <typename T>
+class SpscQueue {
+public:
+    // The capacity is rounded up to a power of 2
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        _slots.resize(size);
+        _mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue & operator=(const SpscQueue &) = delete;
+
+    size_t capacity() const { return _slots.size(); }
+
+    // Producer: moves the value in, unless the queue is full
+    bool tryPush(T & value) {
+        size_t write = _write.load(std::memory_order_relaxed);
+        if (write - _cachedRead == _slots.size()) {
+            _cachedRead = _read.load(std::memory_order_acquire);
+            if (write - _cachedRead == _slots.size())
+                return false;
+        }
+        _slots[write & _mask] = std::move(value);
+        _write.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: moves the oldest value out, unless the queue is empty
+    bool tryPop(T & value) {
+        size_t read = _read.load(std::memory_order_relaxed);
+        if (read == _cachedWrite) {
+            _cachedWrite = _write.load(std::memory_order_acquire);
+            if (read == _cachedWrite)
+                return false;
+        }
+        value = std::move(_slots[read & _mask]);
+        _read.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T value) {
+        for (unsigned attempts = 0; !tryPush(value); attempts++)
+            _backOff(attempts);
+    }
+
+    T pop() {
+        T value;
+        for (unsigned attempts = 0; !tryPop(value); attempts++)
+            _backOff(attempts);
+        return value;
+    }
+
+private:
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    static void _backOff(unsigned attempts) {
+        if (attempts < 64)
+            return;
+        if (attempts < 1024)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    std::vector<T> _slots;
+    size_t _mask = 0;
+
+    // Producer side: the index of the next slot to write, and its copy of the
+    // read index
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _write{ 0 };
+    size_t _cachedRead = 0;
+
+    // Consumer side, likewise
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _read{ 0 };
+    size_t _cachedWrite = 0;
+};
+
+#endif // !SPSC_QUEUE_H
@@ -0,0 +1,117 @@
+#ifndef STAGE_STATS_H
+#define STAGE_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+//
+// Counters of the stages of the evaluation of lines: the number of calls and
+// a histogram of the latency of each stage, with the sizes of what they
+// build. They are always on. Stages that follow each other are timed as laps,
+// so that each costs one read of the clock and a few additions. They are not
+// synchronized, so each Evaluator keeps its own, in its Parser.
+//
+class StageStats {
+public:
+    enum Stage {
+        TOKENIZE,
+        PARSE,      // Tokens into the AST
+        SHARE,      // AST into a DAG of the repeated subexpressions, on long lines
+        EVALUATE,   // AST into a polynomial, and the answer to an expression
+        SOLVE,      // Roots of the polynomial of an equation
+        NUM_STAGES
+    };
+
+    // Latencies fall in the bucket of their highest bit: bucket b holds the
+    // ones in [2^(b-1), 2^b) ns, and the last one everything slower
+    static const int NUM_BUCKETS = 40;
+
+    struct StageCounters {
+        uint64_t calls = 0;
+        uint64_t totalNs = 0;
+        uint64_t maxNs = 0;
+        uint64_t histogram[NUM_BUCKETS] = {};
+    };
+
+    // Clock of the latencies, in ns
+    static uint64_t now() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Starts timing a sequence of stages
+    void start() { _lapStartNs = now(); }
+
+    // Counts a call of the stage that ran since the last start() or lap()
+    void lap(Stage stage) {
+        uint64_t end = now();
+        _record(stage, end - _lapStartNs);
+        _lapStartNs = end;
+    }
+
+    void recordASTNodes(size_t numNodes) {
+        _astNodes += numNodes;
+        if (numNodes > _maxASTNodes)
+            _maxASTNodes = numNodes;
+    }
+
+    // The arena of the AST ran out of memory and allocated a new chunk
+    void recordArenaOverflows(size_t numChunks) { _arenaOverflows += numChunks; }
+
+    // The value of a repeated subexpression was reused instead of evaluated
+    // again
+    void recordSkippedEvaluation() { _skippedEvaluations++; }
+
+    // Number of coefficients or terms of an intermediate polynomial
+    void recordPolynomialSize(size_t size) {
+        if (size > _maxPolynomialSize)
+            _maxPolynomialSize = size;
+    }
+
+    const StageCounters & stage(Stage stage) const { return _stages[stage]; }
+    uint64_t astNodes() const { return _astNodes; }
+    size_t maxASTNodes() const { return _maxASTNodes; }
+    uint64_t arenaOverflows() const { return _arenaOverflows; }
+    uint64_t skippedEvaluations() const { return _skippedEvaluations; }
+    size_t maxPolynomialSize() const { return _maxPolynomialSize; }
+
+    static const char * stageName(Stage stage);
+
+    // Upper bound of the latency of the given fraction of the calls of the
+    // stage, from its histogram
+    uint64_t percentileNs(Stage stage, double fraction) const;
+
+    void reset() {
+        uint64_t lapStartNs = _lapStartNs;
+        *this = StageStats();
+        _lapStartNs = lapStartNs;
+    }
+
+    // Table of the stages, followed by their histograms and the sizes
+    void print(std::ostream & out) const;
+
+private:
+    void _record(Stage stage, uint64_t ns) {
+        StageCounters & counters = _stages[stage];
+        counters.calls++;
+        counters.totalNs += ns;
+        if (ns > counters.maxNs)
+            counters.maxNs = ns;
+        int bucket = 0;
+        while (bucket < NUM_BUCKETS - 1 && (ns >> bucket) != 0)
+            bucket++;
+        counters.histogram[bucket]++;
+    }
+
+    StageCounters _stages[NUM_STAGES];
+    uint64_t _lapStartNs = 0;
+    uint64_t _astNodes = 0;
+    size_t _maxASTNodes = 0;
+    uint64_t _arenaOverflows = 0;
+    uint64_t _skippedEvaluations = 0;
+    size_t _maxPolynomialSize = 0;
+};
+
+#endif // !STAGE_STATS_H
@@ -0,0 +1,57 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// Fixed set of worker threads with one task queue each. Tasks are spread
+// over the queues round-robin; a worker takes tasks from the front of its own
+// queue, and when that is empty it steals from the back of the others, so
+// that no worker sits idle while another one has a backlog. Each task is
+// given the index of the worker running it, to pick per-thread state.
+//
+class WorkStealingPool {
+public:
+    typedef std::function<void(size_t worker)> Task;
+
+    // Starts the given number of workers, or one per hardware thread if 0
+    explicit WorkStealingPool(size_t numThreads = 0);
+    // Runs the remaining tasks and joins the workers
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool & operator=(const WorkStealingPool &) = delete;
+
+    size_t size() const { return _threads.size(); }
+
+    void submit(Task task);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void _work(size_t worker);
+    bool _takeTask(size_t worker, Task & task);
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _nextQueue;
+
+    // Number of tasks queued but not yet taken, for the workers to sleep on
+    std::mutex _mutex;
+    std::condition_variable _taskAvailable;
+    size_t _queuedTasks = 0;
+    bool _stopping = false;
+};
+
+#endif // !THREAD_POOL_H
@@ -1,11 +1,18 @@
 #ifndef TOKEN_H
+#define TOKEN_H
 
-#include <string>
+#include <cstdint>
 
+// Token kind of the end of the input. The remaining kinds are the token types
+// of the tokenizer config file, numbered from 1 in order of appearance.
+const int TOKEN_EOF = 0;
+
+// A token refers to its text in the input line by position, so that it never
+// has to copy it
 struct Token {
-    std::string type;
-    std::string value;
+    int kind;
+    uint32_t offset;
+    uint32_t length;
 };
 
 #endif // !TOKEN_H
-#pragma once
@@ -1,24 +1,35 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
+#include "dfa.h"
+#include "result.h"
 #include "token.h"
 
-#include <regex>
 #include <string>
 #include <vector>
 
 class Tokenizer {
+    friend class GrammarCache;
+
 public:
     bool init(const std::string & configFile);
-    bool tokenize(std::string & line, std::vector<Token> & tokens);
+    // Splits the line [begin, end) into tokens, skipping whitespace between
+    // them. The tokens refer to the line by offset from begin. On an invalid
+    // character, the error is set in result and false is returned.
+    bool tokenize(const char * begin, const char * end, std::vector<Token> & tokens, Result & result) const;
+    bool tokenize(const std::string & line, std::vector<Token> & tokens, Result & result) const {
+        return tokenize(line.data(), line.data() + line.size(), tokens, result);
+    }
 
-private:
-    struct Rule {
-        std::string type;
-        std::regex regex;
-    };
+    // Names of the token types, indexed by token kind (see token.h)
+    const std::vector<std::string> & tokenKinds() const { return _kindNames; }
 
-    std::vector<Rule> _rules;
+private:
+    // Token kind of each rule, in the order of the config file. All the rule
+    // regular expressions are compiled together into _dfa.
+    std::vector<int> _ruleKinds;
+    std::vector<std::string> _kindNames = { "EOF" };
+    DFA _dfa;
 };
 
 #endif // !TOKENIZER_H
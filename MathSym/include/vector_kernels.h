@@ -0,0 +1,40 @@
+#ifndef VECTOR_KERNELS_H
+#define VECTOR_KERNELS_H
+
+#include <cstddef>
+
+//
+// Arithmetic over arrays of doubles, used to evaluate an expression at many
+// values of x, and the scan of text for line breaks of the batch mode. The
+// kernels use AVX or SSE2 when the compiler targets them (/arch:AVX or -mavx;
+// SSE2 is always available on x64) and plain loops otherwise. The Release
+// configurations of the projects target AVX. The output array may be the
+// same as an input array, but must not overlap it otherwise.
+//
+class VectorKernels {
+public:
+    // out[i] = sum of coefficients[k] * xs[i]^k, evaluated in Horner form
+    static void horner(const double * coefficients, size_t numCoefficients,
+        const double * xs, size_t count, double * out);
+
+    static void fill(double value, size_t count, double * out);
+    static void add(const double * a, const double * b, size_t count, double * out);
+    static void subtract(const double * a, const double * b, size_t count, double * out);
+    static void multiply(const double * a, const double * b, size_t count, double * out);
+    static void divide(const double * a, const double * b, size_t count, double * out);
+    static void negate(const double * a, size_t count, double * out);
+
+    // out[i] = a[i]^b[i] with pow(), which has no vector instruction
+    static void power(const double * a, const double * b, size_t count, double * out);
+
+    // Stores in breaks the positions of the first '\n' characters of
+    // [begin, end), up to maxCount of them, and returns their number. The
+    // text is compared 16 bytes at a time, so that short lines cost a few
+    // instructions each rather than a call to memchr() each.
+    static size_t findLineBreaks(const char * begin, const char * end, const char ** breaks, size_t maxCount);
+
+    // Instruction set the kernels were compiled for: "AVX", "SSE2", or "scalar"
+    static const char * instructionSet();
+};
+
+#endif // !VECTOR_KERNELS_H
@@ -0,0 +1,333 @@
+#include "batch.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+#include "vector_kernels.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+
+const size_t BatchEvaluator::OUTPUT_BLOCK_SIZE;
+const size_t BatchEvaluator::CHUNK_LINES;
+const size_t BatchEvaluator::CHUNKS_IN_FLIGHT_PER_THREAD;
+const size_t BatchEvaluator::PIPELINE_CHUNKS;
+
+
+BatchStats BatchEvaluator::run(istream & in, ostream & out) {
+    return _run([this, &in](Chunk & chunk, BatchStats & stats) { return _readChunk(in, chunk, stats); }, out);
+}
+
+
+BatchStats BatchEvaluator::run(const char * begin, const char * end, ostream & out) {
+    const char * next = begin;
+    return _run([this, &next, end](Chunk & chunk, BatchStats & stats) {
+        return _splitChunk(next, end, chunk, stats);
+    }, out);
+}
+
+
+BatchStats BatchEvaluator::_run(const ChunkReader & readChunk, ostream & out) {
+    BatchStats stats;
+    auto start = chrono::steady_clock::now();
+
+    string output;
+    output.reserve(OUTPUT_BLOCK_SIZE + CHUNK_LINES * 64);
+    auto writeChunk = [&](const Chunk & chunk) {
+        output += chunk.output;
+        stats.errors += chunk.errors;
+        if (output.size() >= OUTPUT_BLOCK_SIZE) {
+            out.write(output.data(), output.size());
+            output.clear();
+        }
+    };
+
+    if (_pipelined) {
+        stats.threads = 5;
+        _runPipeline(readChunk, stats, writeChunk);
+
+    } else if (_numThreads == 1) {
+        stats.threads = 1;
+        Evaluator evaluator(_tokenizer, _grammar, _cache);
+        evaluator.setComplexSolutions(_complexSolutions);
+        evaluator.setExact(_exact);
+        Chunk chunk;
+        while (readChunk(chunk, stats) != 0) {
+            _evaluateChunk(chunk, evaluator);
+            writeChunk(chunk);
+        }
+        stats.skippedEvaluations = evaluator.parser().skippedEvaluations();
+
+    } else {
+        // The state used by the tasks outlives the pool, whose destructor
+        // joins the workers
+        vector<unique_ptr<Evaluator>> evaluators;
+        mutex doneMutex;
+        condition_variable chunkDone;
+        WorkStealingPool pool(_numThreads);
+        for (size_t i = 0; i < pool.size(); i++) {
+            evaluators.emplace_back(new Evaluator(_tokenizer, _grammar, _cache));
+            evaluators.back()->setComplexSolutions(_complexSolutions);
+            evaluators.back()->setExact(_exact);
+        }
+        stats.threads = pool.size();
+
+        deque<shared_ptr<Chunk>> inFlight;
+        const size_t maxInFlight = CHUNKS_IN_FLIGHT_PER_THREAD * pool.size();
+        bool inputLeft = true;
+        while (true) {
+            while (inputLeft && inFlight.size() < maxInFlight) {
+                auto chunk = make_shared<Chunk>();
+                if (readChunk(*chunk, stats) == 0) {
+                    inputLeft = false;
+                    break;
+                }
+
+                inFlight.push_back(chunk);
+                pool.submit([this, chunk, &evaluators, &doneMutex, &chunkDone](size_t worker) {
+                    _evaluateChunk(*chunk, *evaluators[worker]);
+                    {
+                        lock_guard<mutex> lock(doneMutex);
+                        chunk->done = true;
+                    }
+                    chunkDone.notify_all();
+                });
+            }
+            if (inFlight.empty())
+                break;
+
+            // Write out the oldest chunk, keeping the input order
+            shared_ptr<Chunk> chunk = inFlight.front();
+            inFlight.pop_front();
+            {
+                unique_lock<mutex> lock(doneMutex);
+                chunkDone.wait(lock, [&chunk] { return chunk->done; });
+            }
+            writeChunk(*chunk);
+        }
+
+        // Every chunk is done, so the workers no longer touch their evaluators
+        for (const auto & evaluator : evaluators)
+            stats.skippedEvaluations += evaluator->parser().skippedEvaluations();
+    }
+
+    out.write(output.data(), output.size());
+    out.flush();
+
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+
+void BatchEvaluator::formatResult(string & text, size_t lineNumber, const Result & result) {
+    text += to_string(lineNumber);
+    if (result.ok) {
+        text += "\tok\t";
+    } else {
+        text += "\terror\t";
+        text += (result.errorColumn != Result::NO_COLUMN) ? to_string(result.errorColumn + 1) : "-";
+        text += '\t';
+    }
+    text += result.text;
+    text += '\n';
+}
+
+
+// Reads up to CHUNK_LINES lines into the chunk, returning their number
+size_t BatchEvaluator::_readChunk(istream & in, Chunk & chunk, BatchStats & stats) const {
+    chunk.firstLine = stats.lines + 1;
+    chunk.numLines = 0;
+    if (chunk.lines.size() < CHUNK_LINES) {
+        chunk.lines.resize(CHUNK_LINES);
+        chunk.texts.resize(CHUNK_LINES);
+    }
+
+    while (chunk.numLines < CHUNK_LINES && getline(in, chunk.texts[chunk.numLines])) {
+        string & line = chunk.texts[chunk.numLines];
+        stats.bytes += line.size() + 1;
+
+        // Accept files with Windows line breaks on any platform
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        chunk.lines[chunk.numLines++] = { line.data(), line.data() + line.size() };
+    }
+    stats.lines += chunk.numLines;
+    return chunk.numLines;
+}
+
+
+// Splits up to CHUNK_LINES lines off the text [next, end) into the chunk,
+// moving next past them, and returns their number
+size_t BatchEvaluator::_splitChunk(const char *& next, const char * end, Chunk & chunk, BatchStats & stats) const {
+    chunk.firstLine = stats.lines + 1;
+    chunk.numLines = 0;
+    if (chunk.lines.size() < CHUNK_LINES)
+        chunk.lines.resize(CHUNK_LINES);
+
+    const char * start = next;
+    const char * breaks[CHUNK_LINES];
+    size_t numBreaks = VectorKernels::findLineBreaks(next, end, breaks, CHUNK_LINES);
+    for (size_t i = 0; i < numBreaks; i++) {
+        chunk.lines[chunk.numLines++] = { next, breaks[i] };
+        next = breaks[i] + 1;
+    }
+
+    // The last line need not end with a line break
+    if (numBreaks < CHUNK_LINES && next != end) {
+        chunk.lines[chunk.numLines++] = { next, end };
+        next = end;
+    }
+
+    for (size_t i = 0; i < chunk.numLines; i++) {
+        LineView & line = chunk.lines[i];
+        if (line.end != line.begin && line.end[-1] == '\r')
+            line.end--;
+    }
+    stats.bytes += next - start;
+    stats.lines += chunk.numLines;
+    return chunk.numLines;
+}
+
+
+void BatchEvaluator::_evaluateChunk(Chunk & chunk, Evaluator & evaluator) const {
+    chunk.output.clear();
+    chunk.errors = 0;
+    for (size_t i = 0; i < chunk.numLines; i++) {
+        const Result & result = evaluator.evaluate(chunk.lines[i].begin, chunk.lines[i].end);
+        if (!result.ok)
+            chunk.errors++;
+
+        formatResult(chunk.output, chunk.firstLine + i, result);
+    }
+}
+
+
+//
+// Runs the pipelined mode, writing the chunks from the calling thread. Every
+// queue carries the chunks in input order, followed by NULL at the end of the
+// input, and written chunks go back to the reading stage. The reading stage
+// adds to the line and byte counts of the stats, and the caller to the
+// others.
+//
+void BatchEvaluator::_runPipeline(const ChunkReader & readChunk, BatchStats & stats,
+    const function<void(const Chunk &)> & writeChunk) const {
+
+    vector<unique_ptr<StagedChunk>> chunks;
+    SpscQueue<StagedChunk *> freeChunks(PIPELINE_CHUNKS), tokenizeQueue(PIPELINE_CHUNKS),
+        parseQueue(PIPELINE_CHUNKS), evaluateQueue(PIPELINE_CHUNKS), writeQueue(PIPELINE_CHUNKS);
+    for (size_t i = 0; i < PIPELINE_CHUNKS; i++) {
+        chunks.emplace_back(new StagedChunk());
+        freeChunks.push(chunks.back().get());
+    }
+
+    // A parser per stage: the evaluating one only evaluates the trees built
+    // by the other
+    Parser parser(_grammar), evaluator(_grammar);
+    parser.setComplexSolutions(_complexSolutions);
+    parser.setExact(_exact);
+    evaluator.setComplexSolutions(_complexSolutions);
+    evaluator.setExact(_exact);
+
+    thread reading([&]() {
+        while (true) {
+            StagedChunk * chunk = freeChunks.pop();
+            if (readChunk(*chunk, stats) == 0)
+                break;
+            tokenizeQueue.push(chunk);
+        }
+        tokenizeQueue.push(NULL);
+    });
+    thread tokenizing([&]() {
+        while (StagedChunk * chunk = tokenizeQueue.pop()) {
+            _tokenizeChunk(*chunk);
+            parseQueue.push(chunk);
+        }
+        parseQueue.push(NULL);
+    });
+    thread parsing([&]() {
+        while (StagedChunk * chunk = parseQueue.pop()) {
+            _parseChunk(*chunk, parser);
+            evaluateQueue.push(chunk);
+        }
+        evaluateQueue.push(NULL);
+    });
+    thread evaluating([&]() {
+        while (StagedChunk * chunk = evaluateQueue.pop()) {
+            _evaluateTrees(*chunk, evaluator);
+            writeQueue.push(chunk);
+        }
+        writeQueue.push(NULL);
+    });
+
+    while (StagedChunk * chunk = writeQueue.pop()) {
+        writeChunk(*chunk);
+        freeChunks.push(chunk);
+    }
+
+    reading.join();
+    tokenizing.join();
+    parsing.join();
+    evaluating.join();
+    stats.skippedEvaluations = evaluator.skippedEvaluations();
+}
+
+
+void BatchEvaluator::_tokenizeChunk(StagedChunk & chunk) const {
+    if (chunk.staged.size() < chunk.numLines)
+        chunk.staged.resize(chunk.numLines);
+
+    for (size_t i = 0; i < chunk.numLines; i++) {
+        StagedChunk::Line & line = chunk.staged[i];
+        line.tokens.clear();
+        line.result.clear();
+        bool tokenized = _tokenizer.tokenize(chunk.lines[i].begin, chunk.lines[i].end, line.tokens, line.result);
+        line.state = tokenized ? StagedChunk::PARSED : StagedChunk::TOKEN_ERROR;
+    }
+}
+
+
+// Looks up the lines in the cache, and builds the trees of the others
+void BatchEvaluator::_parseChunk(StagedChunk & chunk, Parser & parser) const {
+    chunk.astArena.reset();
+    for (size_t i = 0; i < chunk.numLines; i++) {
+        StagedChunk::Line & line = chunk.staged[i];
+        if (line.state == StagedChunk::TOKEN_ERROR)
+            continue;
+
+        const LineView & text = chunk.lines[i];
+        if (_cache && _cache->enabled()) {
+            ResultCache::makeKey(line.tokens, text.begin, line.key);
+            if (_cache->lookup(line.key, line.tokens, text.end - text.begin, line.result)) {
+                line.state = StagedChunk::CACHED;
+                continue;
+            }
+        }
+
+        if (!parser.parseTree(line.tokens, text.begin, text.end, chunk.astArena, line.tree, line.result))
+            line.state = StagedChunk::SYNTAX_ERROR;
+    }
+}
+
+
+// Evaluates the trees of the chunk and formats its output
+void BatchEvaluator::_evaluateTrees(StagedChunk & chunk, Parser & parser) const {
+    chunk.output.clear();
+    chunk.errors = 0;
+    for (size_t i = 0; i < chunk.numLines; i++) {
+        StagedChunk::Line & line = chunk.staged[i];
+        if (line.state == StagedChunk::PARSED)
+            parser.evaluateTree(line.tree, line.result);
+        if ((line.state == StagedChunk::PARSED || line.state == StagedChunk::SYNTAX_ERROR)
+            && _cache && _cache->enabled())
+            _cache->insert(line.key, line.tokens, line.result);
+
+        if (!line.result.ok)
+            chunk.errors++;
+        formatResult(chunk.output, chunk.firstLine + i, line.result);
+    }
+}
@@ -0,0 +1,322 @@
+#include "big_integer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+BigInteger::BigInteger(int64_t value) {
+    _negative = value < 0;
+    // The magnitude of INT64_MIN only fits unsigned
+    uint64_t magnitude = _negative ? 0 - (uint64_t)value : (uint64_t)value;
+    while (magnitude != 0) {
+        _digits.push_back((uint32_t)magnitude);
+        magnitude >>= 32;
+    }
+}
+
+
+bool BigInteger::toInt64(int64_t & value) const {
+    if (_digits.size() > 2)
+        return false;
+    uint64_t magnitude = 0;
+    for (size_t i = _digits.size(); i > 0; i--)
+        magnitude = (magnitude << 32) | _digits[i - 1];
+    if (magnitude > (uint64_t)INT64_MAX)
+        return false;
+    value = _negative ? -(int64_t)magnitude : (int64_t)magnitude;
+    return true;
+}
+
+
+double BigInteger::frexp(int & exponent) const {
+    // The top 3 digits hold more bits than a double
+    size_t first = _digits.size() > 3 ? _digits.size() - 3 : 0;
+    double top = 0;
+    for (size_t i = _digits.size(); i > first; i--)
+        top = top * 4294967296.0 + _digits[i - 1];
+    double mantissa = std::frexp(top, &exponent);
+    exponent += 32 * (int)first;
+    return _negative ? -mantissa : mantissa;
+}
+
+
+string BigInteger::toString() const {
+    if (_digits.empty())
+        return "0";
+
+    // Split off 9 decimal digits at a time, from the least significant
+    const uint32_t CHUNK = 1000000000;
+    Digits magnitude = _digits;
+    vector<uint32_t> chunks;
+    while (!magnitude.empty()) {
+        uint64_t remainder = 0;
+        for (size_t i = magnitude.size(); i > 0; i--) {
+            uint64_t current = (remainder << 32) | magnitude[i - 1];
+            magnitude[i - 1] = (uint32_t)(current / CHUNK);
+            remainder = current % CHUNK;
+        }
+        _trim(magnitude);
+        chunks.push_back((uint32_t)remainder);
+    }
+
+    string text = _negative ? "-" : "";
+    text += to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i > 0; i--) {
+        string chunk = to_string(chunks[i - 1]);
+        text.append(9 - chunk.size(), '0');
+        text += chunk;
+    }
+    return text;
+}
+
+
+BigInteger BigInteger::operator-() const {
+    BigInteger result = *this;
+    result._negative = !_negative && !_digits.empty();
+    return result;
+}
+
+
+BigInteger BigInteger::abs() const {
+    BigInteger result = *this;
+    result._negative = false;
+    return result;
+}
+
+
+BigInteger operator+(const BigInteger & lhs, const BigInteger & rhs) {
+    if (lhs._negative == rhs._negative)
+        return BigInteger::_signed(BigInteger::_addMagnitudes(lhs._digits, rhs._digits), lhs._negative);
+    // Opposite signs: the larger magnitude gives the sign
+    if (BigInteger::_compareMagnitudes(lhs._digits, rhs._digits) >= 0)
+        return BigInteger::_signed(BigInteger::_subtractMagnitudes(lhs._digits, rhs._digits), lhs._negative);
+    return BigInteger::_signed(BigInteger::_subtractMagnitudes(rhs._digits, lhs._digits), rhs._negative);
+}
+
+
+BigInteger operator-(const BigInteger & lhs, const BigInteger & rhs) {
+    return lhs + (-rhs);
+}
+
+
+BigInteger operator*(const BigInteger & lhs, const BigInteger & rhs) {
+    if (lhs.isZero() || rhs.isZero())
+        return BigInteger();
+
+    // Schoolbook product, a row of the lhs digits per rhs digit
+    BigInteger::Digits product(lhs._digits.size() + rhs._digits.size(), 0);
+    for (size_t j = 0; j < rhs._digits.size(); j++) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < lhs._digits.size(); i++) {
+            uint64_t t = (uint64_t)lhs._digits[i] * rhs._digits[j] + product[i + j] + carry;
+            product[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        product[j + lhs._digits.size()] = (uint32_t)carry;
+    }
+    return BigInteger::_signed(move(product), lhs._negative != rhs._negative);
+}
+
+
+void BigInteger::divide(const BigInteger & lhs, const BigInteger & rhs, BigInteger & quotient,
+    BigInteger & remainder) {
+    Digits q, r;
+    _divideMagnitudes(lhs._digits, rhs._digits, q, r);
+    quotient = _signed(move(q), lhs._negative != rhs._negative);
+    remainder = _signed(move(r), lhs._negative);
+}
+
+
+BigInteger operator/(const BigInteger & lhs, const BigInteger & rhs) {
+    BigInteger quotient, remainder;
+    BigInteger::divide(lhs, rhs, quotient, remainder);
+    return quotient;
+}
+
+
+BigInteger BigInteger::gcd(BigInteger lhs, BigInteger rhs) {
+    // Euclid's algorithm
+    lhs._negative = rhs._negative = false;
+    BigInteger quotient, remainder;
+    while (!rhs.isZero()) {
+        divide(lhs, rhs, quotient, remainder);
+        lhs = move(rhs);
+        rhs = move(remainder);
+    }
+    return lhs;
+}
+
+
+BigInteger BigInteger::sqrt() const {
+    if (_digits.empty())
+        return BigInteger();
+
+    // Newton's iteration from above, starting at a power of 2 not below the
+    // root, decreases until it reaches the root
+    int exponent;
+    frexp(exponent);
+    Digits start((exponent + 1) / 2 / 32 + 1, 0);
+    start.back() = (uint32_t)1 << ((exponent + 1) / 2 % 32);
+    BigInteger root = _signed(move(start), false);
+    const BigInteger two = 2;
+    while (true) {
+        BigInteger next = (root + *this / root) / two;
+        if (compare(next, root) >= 0)
+            return root;
+        root = move(next);
+    }
+}
+
+
+int BigInteger::compare(const BigInteger & lhs, const BigInteger & rhs) {
+    if (lhs._negative != rhs._negative)
+        return lhs._negative ? -1 : 1;
+    int magnitudes = _compareMagnitudes(lhs._digits, rhs._digits);
+    return lhs._negative ? -magnitudes : magnitudes;
+}
+
+
+int BigInteger::_compareMagnitudes(const Digits & lhs, const Digits & rhs) {
+    if (lhs.size() != rhs.size())
+        return lhs.size() < rhs.size() ? -1 : 1;
+    for (size_t i = lhs.size(); i > 0; i--)
+        if (lhs[i - 1] != rhs[i - 1])
+            return lhs[i - 1] < rhs[i - 1] ? -1 : 1;
+    return 0;
+}
+
+
+BigInteger::Digits BigInteger::_addMagnitudes(const Digits & lhs, const Digits & rhs) {
+    const Digits & longer = lhs.size() >= rhs.size() ? lhs : rhs;
+    const Digits & shorter = lhs.size() >= rhs.size() ? rhs : lhs;
+    Digits sum(longer.size() + 1, 0);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); i++) {
+        uint64_t t = (uint64_t)longer[i] + (i < shorter.size() ? shorter[i] : 0) + carry;
+        sum[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    sum.back() = (uint32_t)carry;
+    _trim(sum);
+    return sum;
+}
+
+
+BigInteger::Digits BigInteger::_subtractMagnitudes(const Digits & lhs, const Digits & rhs) {
+    Digits difference(lhs.size(), 0);
+    int64_t borrow = 0;
+    for (size_t i = 0; i < lhs.size(); i++) {
+        int64_t t = (int64_t)lhs[i] - (i < rhs.size() ? rhs[i] : 0) - borrow;
+        difference[i] = (uint32_t)t;
+        borrow = t < 0 ? 1 : 0;
+    }
+    _trim(difference);
+    return difference;
+}
+
+
+//
+// Long division of the magnitudes, by Knuth's algorithm D (The Art of
+// Computer Programming, vol. 2, 4.3.1): each digit of the quotient is
+// estimated from the top digits, after shifting both operands so that the
+// top bit of the divisor is set, which makes the estimate at most 2 too high.
+//
+void BigInteger::_divideMagnitudes(const Digits & lhs, const Digits & rhs, Digits & quotient, Digits & remainder) {
+    if (_compareMagnitudes(lhs, rhs) < 0) {
+        quotient.clear();
+        remainder = lhs;
+        return;
+    }
+
+    size_t n = rhs.size();
+    if (n == 1) {
+        // Short division by a single digit
+        uint64_t r = 0;
+        quotient.assign(lhs.size(), 0);
+        for (size_t i = lhs.size(); i > 0; i--) {
+            uint64_t current = (r << 32) | lhs[i - 1];
+            quotient[i - 1] = (uint32_t)(current / rhs[0]);
+            r = current % rhs[0];
+        }
+        _trim(quotient);
+        remainder.clear();
+        if (r != 0)
+            remainder.push_back((uint32_t)r);
+        return;
+    }
+
+    int shift = 0;
+    while ((rhs.back() << shift & 0x80000000u) == 0)
+        shift++;
+    Digits v(n), u(lhs.size() + 1);
+    for (size_t i = n; i > 0; i--)
+        v[i - 1] = (rhs[i - 1] << shift) | (shift && i > 1 ? rhs[i - 2] >> (32 - shift) : 0);
+    u[lhs.size()] = shift ? lhs.back() >> (32 - shift) : 0;
+    for (size_t i = lhs.size(); i > 0; i--)
+        u[i - 1] = (lhs[i - 1] << shift) | (shift && i > 1 ? lhs[i - 2] >> (32 - shift) : 0);
+
+    const uint64_t BASE = (uint64_t)1 << 32;
+    size_t m = lhs.size() - n;
+    quotient.assign(m + 1, 0);
+    for (size_t j = m + 1; j > 0; j--) {
+        size_t k = j - 1;
+        uint64_t top = ((uint64_t)u[k + n] << 32) | u[k + n - 1];
+        uint64_t qhat = top / v[n - 1], rhat = top % v[n - 1];
+        while (qhat >= BASE || qhat * v[n - 2] > ((rhat << 32) | u[k + n - 2])) {
+            qhat--;
+            rhat += v[n - 1];
+            if (rhat >= BASE)
+                break;
+        }
+
+        // Subtract qhat * v from the digits of u at k
+        uint64_t carry = 0;
+        int64_t borrow = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t p = qhat * v[i] + carry;
+            carry = p >> 32;
+            int64_t t = (int64_t)u[i + k] - borrow - (int64_t)(p & 0xffffffffu);
+            u[i + k] = (uint32_t)t;
+            borrow = t < 0 ? 1 : 0;
+        }
+        int64_t t = (int64_t)u[k + n] - borrow - (int64_t)carry;
+        u[k + n] = (uint32_t)t;
+
+        if (t < 0) {
+            // The estimate was 1 too high: add v back
+            qhat--;
+            carry = 0;
+            for (size_t i = 0; i < n; i++) {
+                uint64_t sum = (uint64_t)u[i + k] + v[i] + carry;
+                u[i + k] = (uint32_t)sum;
+                carry = sum >> 32;
+            }
+            u[k + n] = (uint32_t)(u[k + n] + carry);
+        }
+        quotient[k] = (uint32_t)qhat;
+    }
+    _trim(quotient);
+
+    // The remainder is what is left of u, shifted back
+    remainder.assign(n, 0);
+    for (size_t i = 0; i < n; i++)
+        remainder[i] = (u[i] >> shift) | (shift ? u[i + 1] << (32 - shift) : 0);
+    _trim(remainder);
+}
+
+
+void BigInteger::_trim(Digits & digits) {
+    while (!digits.empty() && digits.back() == 0)
+        digits.pop_back();
+}
+
+
+BigInteger BigInteger::_signed(Digits digits, bool negative) {
+    BigInteger result;
+    _trim(digits);
+    result._digits = move(digits);
+    result._negative = negative && !result._digits.empty();
+    return result;
+}
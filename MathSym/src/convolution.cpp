@@ -0,0 +1,238 @@
+#include "convolution.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <complex>
+
+using namespace std;
+
+
+const size_t Convolution::KARATSUBA_MIN_SIZE;
+const size_t Convolution::KARATSUBA_BASE_SIZE;
+const size_t Convolution::FFT_MIN_SIZE;
+const double Convolution::EXACT_INTEGER_LIMIT = 9007199254740992.0;   // 2^53
+
+
+namespace {
+
+typedef complex<double> Complex;
+
+const double PI = 3.14159265358979323846;
+
+// In-place iterative radix-2 FFT of a power-of-two length array, with
+// roots[k] = exp(-2 pi i k / n) for k < n / 2. The inverse is unscaled.
+void transform(vector<Complex> & x, const vector<Complex> & roots, bool inverse) {
+    size_t n = x.size();
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            swap(x[i], x[j]);
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len / 2;
+        size_t step = n / len;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t j = 0; j < half; j++) {
+                Complex w = inverse ? conj(roots[j * step]) : roots[j * step];
+                Complex u = x[i + j];
+                Complex v = x[i + j + half] * w;
+                x[i + j] = u + v;
+                x[i + j + half] = u - v;
+            }
+        }
+    }
+}
+
+bool allIntegers(const double * values, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        if (values[i] != floor(values[i]))
+            return false;
+    return true;
+}
+
+double sumOfMagnitudes(const double * values, size_t n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += fabs(values[i]);
+    return sum;
+}
+
+double norm2(const double * values, size_t n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += values[i] * values[i];
+    return sqrt(sum);
+}
+
+// Upper bound on the rounding error of an FFT product
+double fftErrorBound(const double * a, size_t na, const double * b, size_t nb, size_t n) {
+    return 8 * DBL_EPSILON * log2((double)n) * norm2(a, na) * norm2(b, nb);
+}
+
+}
+
+
+vector<double> Convolution::multiply(const vector<double> & lhs, const vector<double> & rhs,
+    Algorithm algorithm) {
+
+    vector<double> result(lhs.size() + rhs.size() - 1, 0);
+    if (algorithm == AUTOMATIC)
+        algorithm = choose(lhs, rhs);
+
+    switch (algorithm) {
+    case KARATSUBA:
+        _karatsuba(lhs.data(), lhs.size(), rhs.data(), rhs.size(), result.data());
+        break;
+    case FFT:
+        _fft(lhs.data(), lhs.size(), rhs.data(), rhs.size(), result.data());
+        break;
+    default:
+        _schoolbook(lhs.data(), lhs.size(), rhs.data(), rhs.size(), result.data());
+        break;
+    }
+    return result;
+}
+
+
+Convolution::Algorithm Convolution::choose(const vector<double> & lhs, const vector<double> & rhs) {
+    size_t smaller = min(lhs.size(), rhs.size());
+    if (smaller < KARATSUBA_MIN_SIZE || !allIntegers(lhs.data(), lhs.size())
+        || !allIntegers(rhs.data(), rhs.size()))
+        return SCHOOLBOOK;
+
+    // Every intermediate value is bounded by the product of the sums of the
+    // magnitudes of the coefficients
+    double bound = sumOfMagnitudes(lhs.data(), lhs.size()) * sumOfMagnitudes(rhs.data(), rhs.size());
+    if (bound >= EXACT_INTEGER_LIMIT)
+        return SCHOOLBOOK;
+
+    if (smaller < FFT_MIN_SIZE)
+        return KARATSUBA;
+
+    size_t n = 1;
+    while (n < lhs.size() + rhs.size() - 1)
+        n <<= 1;
+    if (fftErrorBound(lhs.data(), lhs.size(), rhs.data(), rhs.size(), n) >= 0.25)
+        return KARATSUBA;
+    return FFT;
+}
+
+
+//
+// c += a * b
+//
+void Convolution::_schoolbook(const double * a, size_t na, const double * b, size_t nb, double * c) {
+    for (size_t i = 0; i < na; i++) {
+        double ai = a[i];
+        if (ai == 0)
+            continue;
+        double * dst = c + i;
+        for (size_t j = 0; j < nb; j++)
+            dst[j] += ai * b[j];
+    }
+}
+
+
+//
+// c += a * b. With a = a0 + x^k a1 and b = b0 + x^k b1, the product is
+// a0 b0 + x^k ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) + x^2k a1 b1, which takes
+// three half-size products instead of four.
+//
+void Convolution::_karatsuba(const double * a, size_t na, const double * b, size_t nb, double * c) {
+    if (na < nb) {
+        swap(a, b);
+        swap(na, nb);
+    }
+    if (nb < KARATSUBA_BASE_SIZE) {
+        _schoolbook(a, na, b, nb, c);
+        return;
+    }
+
+    // Unbalanced operands: multiply b by slices of a of its own size
+    if (na >= 2 * nb) {
+        for (size_t offset = 0; offset < na; offset += nb)
+            _karatsuba(a + offset, min(nb, na - offset), b, nb, c + offset);
+        return;
+    }
+
+    // Here nb > na / 2 >= k, so both operands have a nonempty high part,
+    // although that of b may be shorter than its low part
+    size_t k = na / 2;
+    size_t na1 = na - k, nb1 = nb - k;
+    size_t nsb = max(k, nb1);
+
+    vector<double> z0(2 * k - 1, 0), z2(na1 + nb1 - 1, 0);
+    _karatsuba(a, k, b, k, z0.data());
+    _karatsuba(a + k, na1, b + k, nb1, z2.data());
+
+    vector<double> sa(a + k, a + na), sb(b + k, b + nb);
+    sb.resize(nsb, 0);
+    for (size_t i = 0; i < k; i++) {
+        sa[i] += a[i];
+        sb[i] += b[i];
+    }
+    vector<double> z1(na1 + nsb - 1, 0);
+    _karatsuba(sa.data(), na1, sb.data(), nsb, z1.data());
+
+    for (size_t i = 0; i < z0.size(); i++) {
+        c[i] += z0[i];
+        z1[i] -= z0[i];
+    }
+    for (size_t i = 0; i < z2.size(); i++) {
+        c[2 * k + i] += z2[i];
+        z1[i] -= z2[i];
+    }
+    for (size_t i = 0; i < z1.size(); i++)
+        c[k + i] += z1[i];
+}
+
+
+//
+// c += a * b, computed as the inverse FFT of the pointwise product of the
+// transforms. Both real operands are transformed at once, as the real and
+// imaginary parts of one complex array.
+//
+void Convolution::_fft(const double * a, size_t na, const double * b, size_t nb, double * c) {
+    size_t nc = na + nb - 1;
+    size_t n = 1;
+    while (n < nc)
+        n <<= 1;
+
+    vector<Complex> roots(n / 2);
+    for (size_t k = 0; k < n / 2; k++)
+        roots[k] = polar(1.0, -2 * PI * k / n);
+
+    vector<Complex> x(n);
+    for (size_t i = 0; i < na; i++)
+        x[i].real(a[i]);
+    for (size_t i = 0; i < nb; i++)
+        x[i].imag(b[i]);
+    transform(x, roots, false);
+
+    // With X = A + iB, A[k] = (X[k] + conj(X[-k])) / 2 and
+    // B[k] = (X[k] - conj(X[-k])) / 2i
+    vector<Complex> product(n);
+    for (size_t k = 0; k < n; k++) {
+        Complex xk = x[k];
+        Complex xnk = conj(x[(n - k) & (n - 1)]);
+        Complex ak = (xk + xnk) * 0.5;
+        Complex bk = (xk - xnk) * Complex(0, -0.5);
+        product[k] = ak * bk;
+    }
+    transform(product, roots, true);
+
+    // With integer operands, rounding recovers the exact product as long as
+    // the error is below one half
+    double errorBound = fftErrorBound(a, na, b, nb, n);
+    bool roundToIntegers = errorBound < 0.25
+        && allIntegers(a, na) && allIntegers(b, nb);
+    for (size_t i = 0; i < nc; i++) {
+        double value = product[i].real() / n;
+        c[i] += roundToIntegers ? round(value) : value;
+    }
+}
@@ -0,0 +1,484 @@
+#include "dfa.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <map>
+#include <memory>
+
+using namespace std;
+
+
+namespace {
+
+typedef bitset<256> CharSet;
+
+struct RegexNode {
+    enum RegexNodeType {
+        CHARSET, CONCAT, ALTERNATION, REPEAT
+    };
+
+    RegexNodeType type;
+    CharSet chars;
+    vector<unique_ptr<RegexNode>> children;
+    int minRepeat = 0;
+    int maxRepeat = 0;   // -1 for unbounded
+};
+
+struct NFAState {
+    vector<pair<CharSet, int>> edges;
+    vector<int> epsilonEdges;
+    int acceptRule = -1;
+};
+
+const int MAX_BOUNDED_REPEAT = 1000;
+
+//
+// Recursive-descent parser for the supported regular expression syntax:
+// literals, escapes (\d \w \s and their negations, \t \n \r \f \v \xHH, and
+// escaped metacharacters), bracketed classes with ranges and negation, '.',
+// groups, alternation, and the quantifiers * + ? {m} {m,} {m,n}
+//
+class RegexParser {
+public:
+    typedef unique_ptr<RegexNode> NodePtr;
+
+    RegexParser(const string & regex) : _regex(regex) {}
+
+    NodePtr parse() {
+        NodePtr node = _parseAlternation();
+        if (_pos != _regex.size())
+            _fail("unmatched ')'");
+        return node;
+    }
+
+private:
+    NodePtr _parseAlternation() {
+        NodePtr lhs = _parseConcatenation();
+        if (_pos == _regex.size() || _regex[_pos] != '|')
+            return lhs;
+
+        NodePtr node = _newNode(RegexNode::ALTERNATION);
+        node->children.push_back(move(lhs));
+        while (_pos < _regex.size() && _regex[_pos] == '|') {
+            _pos++;
+            node->children.push_back(_parseConcatenation());
+        }
+        return node;
+    }
+
+    NodePtr _parseConcatenation() {
+        NodePtr node = _newNode(RegexNode::CONCAT);
+        while (_pos < _regex.size() && _regex[_pos] != '|' && _regex[_pos] != ')')
+            node->children.push_back(_parseRepeat());
+        return node;
+    }
+
+    NodePtr _parseRepeat() {
+        NodePtr node = _parseAtom();
+        while (_pos < _regex.size()) {
+            int minRepeat, maxRepeat;
+            char c = _regex[_pos];
+            if (c == '*') {
+                minRepeat = 0; maxRepeat = -1;
+                _pos++;
+            } else if (c == '+') {
+                minRepeat = 1; maxRepeat = -1;
+                _pos++;
+            } else if (c == '?') {
+                minRepeat = 0; maxRepeat = 1;
+                _pos++;
+            } else if (c == '{') {
+                _pos++;
+                minRepeat = maxRepeat = _parseNumber();
+                if (_pos < _regex.size() && _regex[_pos] == ',') {
+                    _pos++;
+                    maxRepeat = (_pos < _regex.size() && _regex[_pos] == '}') ? -1 : _parseNumber();
+                }
+                if (_pos == _regex.size() || _regex[_pos] != '}')
+                    _fail("malformed repetition");
+                _pos++;
+                if ((maxRepeat != -1 && maxRepeat < minRepeat) || minRepeat > MAX_BOUNDED_REPEAT
+                    || maxRepeat > MAX_BOUNDED_REPEAT)
+                    _fail("invalid repetition bounds");
+            } else {
+                break;
+            }
+
+            // Lazy quantifiers make no difference for a longest-match automaton
+            if (_pos < _regex.size() && _regex[_pos] == '?')
+                _pos++;
+
+            NodePtr repeat = _newNode(RegexNode::REPEAT);
+            repeat->minRepeat = minRepeat;
+            repeat->maxRepeat = maxRepeat;
+            repeat->children.push_back(move(node));
+            node = move(repeat);
+        }
+        return node;
+    }
+
+    NodePtr _parseAtom() {
+        char c = _regex[_pos++];
+        switch (c) {
+            case '(':
+                {
+                    if (_regex.compare(_pos, 2, "?:") == 0)
+                        _pos += 2;
+                    NodePtr node = _parseAlternation();
+                    if (_pos == _regex.size() || _regex[_pos] != ')')
+                        _fail("missing ')'");
+                    _pos++;
+                    return node;
+                }
+            case '[':
+                return _charSetNode(_parseBracket());
+            case '.':
+                {
+                    CharSet chars;
+                    chars.set();
+                    chars.reset('\n');
+                    chars.reset('\r');
+                    return _charSetNode(chars);
+                }
+            case '\\':
+                return _charSetNode(_parseEscape());
+            case '*': case '+': case '?': case '{':
+                _fail("nothing to repeat");
+            case '^': case '$':
+                _fail("anchors are not supported");
+        }
+
+        CharSet chars;
+        chars.set((unsigned char)c);
+        return _charSetNode(chars);
+    }
+
+    CharSet _parseBracket() {
+        CharSet chars;
+        bool negate = false;
+        if (_pos < _regex.size() && _regex[_pos] == '^') {
+            negate = true;
+            _pos++;
+        }
+
+        while (true) {
+            if (_pos == _regex.size())
+                _fail("missing ']'");
+            if (_regex[_pos] == ']') {
+                _pos++;
+                break;
+            }
+
+            CharSet first = _parseBracketAtom();
+            if (first.count() == 1 && _pos + 1 < _regex.size() && _regex[_pos] == '-'
+                && _regex[_pos + 1] != ']') {
+                _pos++;
+                CharSet last = _parseBracketAtom();
+                if (last.count() != 1)
+                    _fail("invalid range in character class");
+
+                int lo = 0, hi = 0;
+                while (!first.test(lo)) lo++;
+                while (!last.test(hi)) hi++;
+                if (lo > hi)
+                    _fail("invalid range in character class");
+                for (int i = lo; i <= hi; i++)
+                    chars.set(i);
+            } else {
+                chars |= first;
+            }
+        }
+
+        return negate ? ~chars : chars;
+    }
+
+    CharSet _parseBracketAtom() {
+        char c = _regex[_pos++];
+        if (c == '\\')
+            return _parseEscape();
+
+        CharSet chars;
+        chars.set((unsigned char)c);
+        return chars;
+    }
+
+    CharSet _parseEscape() {
+        if (_pos == _regex.size())
+            _fail("trailing '\\'");
+
+        CharSet chars;
+        char c = _regex[_pos++];
+        switch (c) {
+            case 'd': case 'D':
+                for (int i = '0'; i <= '9'; i++) chars.set(i);
+                break;
+            case 'w': case 'W':
+                for (int i = 0; i < 256; i++)
+                    if (isalnum(i) || i == '_') chars.set(i);
+                break;
+            case 's': case 'S':
+                for (int i = 0; i < 256; i++)
+                    if (isspace(i)) chars.set(i);
+                break;
+            case 't': chars.set('\t'); break;
+            case 'n': chars.set('\n'); break;
+            case 'r': chars.set('\r'); break;
+            case 'f': chars.set('\f'); break;
+            case 'v': chars.set('\v'); break;
+            case 'x':
+                {
+                    if (_pos + 2 > _regex.size() || !isxdigit(_regex[_pos]) || !isxdigit(_regex[_pos + 1]))
+                        _fail("malformed \\x escape");
+                    chars.set(stoi(_regex.substr(_pos, 2), nullptr, 16));
+                    _pos += 2;
+                }
+                break;
+            default:
+                chars.set((unsigned char)c);
+        }
+
+        return (c == 'D' || c == 'W' || c == 'S') ? ~chars : chars;
+    }
+
+    int _parseNumber() {
+        size_t start = _pos;
+        while (_pos < _regex.size() && isdigit(_regex[_pos]))
+            _pos++;
+        if (start == _pos || _pos - start > 4)
+            _fail("malformed repetition");
+        return atoi(_regex.substr(start, _pos - start).c_str());
+    }
+
+    static NodePtr _newNode(RegexNode::RegexNodeType type) {
+        NodePtr node(new RegexNode());
+        node->type = type;
+        return node;
+    }
+
+    static NodePtr _charSetNode(const CharSet & chars) {
+        NodePtr node = _newNode(RegexNode::CHARSET);
+        node->chars = chars;
+        return node;
+    }
+
+    [[noreturn]] void _fail(const string & reason) {
+        throw DFA::SyntaxError(reason + " at position " + to_string(_pos));
+    }
+
+    const string & _regex;
+    size_t _pos = 0;
+};
+
+
+//
+// Thompson construction of an NFA fragment for a regular expression node.
+// Returns the pair of (start, end) states of the fragment.
+//
+pair<int, int> buildNFA(const RegexNode & node, vector<NFAState> & nfa) {
+    auto newState = [&nfa]() {
+        nfa.push_back(NFAState());
+        return (int)nfa.size() - 1;
+    };
+
+    int start = newState();
+    int end = start;
+    switch (node.type) {
+        case RegexNode::CHARSET:
+            end = newState();
+            nfa[start].edges.push_back({ node.chars, end });
+            break;
+
+        case RegexNode::CONCAT:
+            for (const auto & child : node.children) {
+                auto fragment = buildNFA(*child, nfa);
+                nfa[end].epsilonEdges.push_back(fragment.first);
+                end = fragment.second;
+            }
+            break;
+
+        case RegexNode::ALTERNATION:
+            end = newState();
+            for (const auto & child : node.children) {
+                auto fragment = buildNFA(*child, nfa);
+                nfa[start].epsilonEdges.push_back(fragment.first);
+                nfa[fragment.second].epsilonEdges.push_back(end);
+            }
+            break;
+
+        case RegexNode::REPEAT:
+            {
+                const auto & child = *node.children[0];
+                for (int i = 0; i < node.minRepeat; i++) {
+                    auto fragment = buildNFA(child, nfa);
+                    nfa[end].epsilonEdges.push_back(fragment.first);
+                    end = fragment.second;
+                }
+
+                if (node.maxRepeat == -1) {
+                    // Kleene star on one more copy of the child
+                    auto fragment = buildNFA(child, nfa);
+                    int loopEnd = newState();
+                    nfa[end].epsilonEdges.push_back(fragment.first);
+                    nfa[end].epsilonEdges.push_back(loopEnd);
+                    nfa[fragment.second].epsilonEdges.push_back(fragment.first);
+                    nfa[fragment.second].epsilonEdges.push_back(loopEnd);
+                    end = loopEnd;
+                } else {
+                    // Chain of optional copies, each of which may skip to the end
+                    int optionalEnd = newState();
+                    for (int i = node.minRepeat; i < node.maxRepeat; i++) {
+                        auto fragment = buildNFA(child, nfa);
+                        nfa[end].epsilonEdges.push_back(fragment.first);
+                        nfa[end].epsilonEdges.push_back(optionalEnd);
+                        end = fragment.second;
+                    }
+                    nfa[end].epsilonEdges.push_back(optionalEnd);
+                    end = optionalEnd;
+                }
+            }
+            break;
+    }
+
+    return { start, end };
+}
+
+
+void epsilonClosure(const vector<NFAState> & nfa, vector<int> & states) {
+    vector<bool> visited(nfa.size(), false);
+    vector<int> stack = states;
+    for (int s : states)
+        visited[s] = true;
+
+    while (!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+        for (int t : nfa[s].epsilonEdges) {
+            if (!visited[t]) {
+                visited[t] = true;
+                states.push_back(t);
+                stack.push_back(t);
+            }
+        }
+    }
+
+    sort(states.begin(), states.end());
+}
+
+}
+
+
+const int32_t DFA::DEAD_STATE;
+
+
+void DFA::addRule(const string & regex) {
+    // Validate the syntax eagerly so that errors can be reported per rule
+    RegexParser(regex).parse();
+    _regexes.push_back(regex);
+}
+
+//
+// Merges the NFAs of all the rules under a common start state, and converts
+// the result into a DFA by subset construction. The input bytes are first
+// partitioned into equivalence classes that no rule can tell apart, which
+// keeps the transition table small.
+//
+void DFA::compile() {
+    vector<NFAState> nfa(1);
+    for (size_t i = 0; i < _regexes.size(); i++) {
+        auto regexTree = RegexParser(_regexes[i]).parse();
+        auto fragment = buildNFA(*regexTree, nfa);
+        nfa[0].epsilonEdges.push_back(fragment.first);
+        nfa[fragment.second].acceptRule = (int)i;
+    }
+
+    // Byte equivalence classes: two bytes are equivalent if every edge of
+    // the NFA either accepts both or rejects both
+    vector<const CharSet *> edgeSets;
+    for (const auto & state : nfa)
+        for (const auto & edge : state.edges)
+            edgeSets.push_back(&edge.first);
+
+    _byteClasses.assign(256, 0);
+    map<vector<bool>, int> signatures;
+    for (int c = 0; c < 256; c++) {
+        vector<bool> signature(edgeSets.size());
+        for (size_t i = 0; i < edgeSets.size(); i++)
+            signature[i] = edgeSets[i]->test(c);
+        auto it = signatures.insert({ signature, (int)signatures.size() }).first;
+        _byteClasses[c] = (uint8_t)it->second;
+    }
+    _numClasses = (int)signatures.size();
+
+    vector<int> classRepresentative(_numClasses);
+    for (int c = 255; c >= 0; c--)
+        classRepresentative[_byteClasses[c]] = c;
+
+    // Subset construction
+    _transitions.clear();
+    _acceptRule.clear();
+
+    map<vector<int>, int> dfaStates;
+    vector<vector<int>> worklist;
+
+    vector<int> startSet = { 0 };
+    epsilonClosure(nfa, startSet);
+    dfaStates[startSet] = 0;
+    worklist.push_back(startSet);
+
+    for (size_t current = 0; current < worklist.size(); current++) {
+        const vector<int> nfaStates = worklist[current];
+
+        int acceptRule = -1;
+        for (int s : nfaStates)
+            if (nfa[s].acceptRule != -1 && (acceptRule == -1 || nfa[s].acceptRule < acceptRule))
+                acceptRule = nfa[s].acceptRule;
+        _acceptRule.push_back(acceptRule);
+        _transitions.resize(_transitions.size() + _numClasses, DEAD_STATE);
+
+        for (int cls = 0; cls < _numClasses; cls++) {
+            vector<int> next;
+            for (int s : nfaStates)
+                for (const auto & edge : nfa[s].edges)
+                    if (edge.first.test(classRepresentative[cls]))
+                        next.push_back(edge.second);
+            if (next.empty())
+                continue;
+
+            sort(next.begin(), next.end());
+            next.erase(unique(next.begin(), next.end()), next.end());
+            epsilonClosure(nfa, next);
+
+            auto it = dfaStates.find(next);
+            if (it == dfaStates.end()) {
+                it = dfaStates.insert({ next, (int)worklist.size() }).first;
+                worklist.push_back(next);
+            }
+            _transitions[current * _numClasses + cls] = it->second;
+        }
+    }
+}
+
+
+int DFA::match(const char * begin, const char * end, size_t & length) const {
+    int bestRule = -1;
+    size_t bestLength = 0;
+
+    int32_t state = 0;
+    for (const char * p = begin; p != end; ) {
+        state = _transitions[state * _numClasses + _byteClasses[(unsigned char)*p++]];
+        if (state == DEAD_STATE)
+            break;
+
+        // Keep the rule of highest priority seen so far, extended to its
+        // longest match
+        int rule = _acceptRule[state];
+        if (rule != -1 && (bestRule == -1 || rule <= bestRule)) {
+            bestRule = rule;
+            bestLength = p - begin;
+        }
+    }
+
+    length = bestLength;
+    return bestRule;
+}
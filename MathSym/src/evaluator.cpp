@@ -0,0 +1,38 @@
+#include "evaluator.h"
+
+using namespace std;
+
+
+const Result & Evaluator::evaluate(const char * begin, const char * end) {
+    _tokens.clear();
+    _result.clear();
+    _parser.stats().start();
+    bool tokenized = _tokenizer.tokenize(begin, end, _tokens, _result);
+    _parser.stats().lap(StageStats::TOKENIZE);
+    if (!tokenized)
+        return _result;
+
+    if (_cache && _cache->enabled()) {
+        ResultCache::makeKey(_tokens, begin, _key);
+        if (_cache->lookup(_key, _tokens, end - begin, _result))
+            return _result;
+    }
+
+    _parser.parse(_tokens, begin, end, _result);
+
+    if (_cache && _cache->enabled())
+        _cache->insert(_key, _tokens, _result);
+    return _result;
+}
+
+
+const Result & Evaluator::prepare(const string & line, PreparedExpression & prepared) {
+    _tokens.clear();
+    _result.clear();
+    _parser.stats().start();
+    bool tokenized = _tokenizer.tokenize(line, _tokens, _result);
+    _parser.stats().lap(StageStats::TOKENIZE);
+    if (tokenized)
+        _parser.prepare(_tokens, line, prepared, _result);
+    return _result;
+}
@@ -0,0 +1,501 @@
+#include "grammar.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <regex>
+
+//#define LOG_DEBUG
+
+using namespace std;
+
+
+const unordered_set<string> Grammar::_binaryOperators = { "+", "-", "*", "/", "^", "=" };
+
+const int Grammar::EPSILON_ID;
+
+
+bool Grammar::init(const vector<string> & tokenKinds, const string & configFile,
+    const string & semanticsFile) {
+
+    _terminals = tokenKinds;
+    vector<int> productionLines;
+    if (!_readConfigFile(configFile, productionLines))
+        return false;
+
+    vector<SymbolSet> FIRST;
+    _computeFIRST(FIRST);
+
+    vector<SymbolSet> FOLLOW;
+    _computeFOLLOW(FIRST, FOLLOW);
+
+    vector<SymbolSet> FIRST_PLUS(_productions.size());
+    _computeFIRST_PLUS(FIRST, FOLLOW, FIRST_PLUS);
+
+    _constructLL1Table(FIRST_PLUS);
+
+    _binaryTerminals.assign(_terminals.size(), 0);
+    for (size_t i = 0; i < _terminals.size(); i++)
+        _binaryTerminals[i] = (_binaryOperators.find(_terminals[i]) != _binaryOperators.end());
+
+    _unaryOperators.assign(_productions.size(), -1);
+    _unusedTerminals.assign(_terminals.size(), 0);
+    _buildActions.assign(_productions.size(), -1);
+    _infixPrecedence.assign(_terminals.size(), 0);
+    _infixAssociativity.assign(_terminals.size(), LEFT);
+    _prefixPrecedence.assign(_terminals.size(), 0);
+    _groupClosers.assign(_terminals.size(), -1);
+    _groupPrecedence.assign(_terminals.size(), 0);
+    if (semanticsFile != "" && !_readSemanticsFile(semanticsFile))
+        return false;
+
+    _findOperatorTerminals();
+
+    // Without a build action, the operator of a production would never be
+    // applied, and every line using it would fail to build its AST
+    for (size_t i = 0; i < _productions.size(); i++) {
+        if (_buildActions[i] != -1)
+            continue;
+        for (const auto & symbol : _productions[i].rhsSymbols) {
+            if (symbol.type == Symbol::TERMINAL && _operatorTerminals[symbol.id]) {
+                cerr << "Error: The production on line " << productionLines[i] << " in file "
+                    << configFile << " has the operator " << _terminals[symbol.id]
+                    << " but no build action in the semantics config file" << endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+bool Grammar::setEngine(Engine engine) {
+    if (engine == OPERATOR_PRECEDENCE && !hasPrecedenceTable()) {
+        cerr << "Error: The semantics config file has no operator precedence table" << endl;
+        return false;
+    }
+
+    _engine = engine;
+    return true;
+}
+
+
+bool Grammar::hasPrecedenceTable() const {
+    return any_of(_infixPrecedence.begin(), _infixPrecedence.end(), [](int precedence) { return precedence != 0; });
+}
+
+
+bool Grammar::_readConfigFile(const std::string & configFile, vector<int> & productionLines) {
+
+    ifstream ifs(configFile);
+    if (ifs.fail()) {
+        cerr << "Error: Failed to open tokenizer config file " << configFile << endl;
+        return false;
+    }
+
+    vector<pair<string, vector<string>>> productions;
+    int lineCount = 0;
+    while (ifs) {
+        string line;
+        getline(ifs, line);
+        lineCount++;
+
+        // Make sure the line is non-empty and non-comment
+        auto itFirstChar = find_if(line.begin(), line.end(), [](char c) {return !isspace(c); });
+        if (itFirstChar == line.end() || *itFirstChar == '#')
+            continue;
+
+        auto delimPos = line.find("->");
+        if (delimPos == string::npos || delimPos == 0) {
+            cerr << "Error: Malformed line " << lineCount << " in file "
+                << configFile << endl;
+            return false;
+        }
+
+        // Read the symbol on the left-hand side of the production (always nonterminal)
+        string lhsSymbol = line.substr(0, delimPos);
+        auto lineEnd = remove_if(lhsSymbol.begin(), lhsSymbol.end(), [](char c) {return isspace(c) != 0; });
+        lhsSymbol.erase(lineEnd, lhsSymbol.end());
+
+        // The first production by default contains the start symbol
+        if (find(_nonterminals.begin(), _nonterminals.end(), lhsSymbol) == _nonterminals.end())
+            _nonterminals.push_back(lhsSymbol);
+
+        // Read all the symbols on the right-hand side of the production
+        vector<string> rhsSymbols;
+        regex rhsRegex("[^ \\t\\n]+");
+        for (auto it = sregex_iterator(line.begin() + delimPos + 2, line.end(), rhsRegex);
+            it != sregex_iterator(); ++it)
+            rhsSymbols.push_back(it->str());
+
+        if (rhsSymbols.size() == 0) {
+            cerr << "Error: Malformed line " << lineCount << " in file "
+                << configFile << endl;
+            return false;
+        }
+
+        productions.push_back({ lhsSymbol, rhsSymbols });
+        productionLines.push_back(lineCount);
+    }
+
+    // Number the symbols of all productions. The nonterminals are the symbols
+    // on the left-hand side of some production; all the others are terminals
+    for (const auto & production : productions) {
+        int lhsSymbol = (int)(find(_nonterminals.begin(), _nonterminals.end(), production.first)
+            - _nonterminals.begin());
+
+        vector<Symbol> rhsSymbols;
+        for (const auto & name : production.second) {
+            auto itNonterminal = find(_nonterminals.begin(), _nonterminals.end(), name);
+            if (name == "^e$") {
+                rhsSymbols.push_back(Symbol{ Symbol::EPSILON, EPSILON_ID });
+            } else if (itNonterminal != _nonterminals.end()) {
+                rhsSymbols.push_back(Symbol{ Symbol::NONTERMINAL,
+                    (int)(itNonterminal - _nonterminals.begin()) });
+            } else {
+                int terminal = _findTerminal(name);
+                if (terminal == -1) {
+                    // Never produced by the tokenizer, but still a valid terminal
+                    terminal = (int)_terminals.size();
+                    _terminals.push_back(name);
+                }
+                rhsSymbols.push_back(Symbol{ Symbol::TERMINAL, terminal });
+            }
+        }
+
+        _productions.push_back({ lhsSymbol, rhsSymbols });
+    }
+    _startSymbol = 0;
+
+#ifdef LOG_DEBUG
+    cout << "Productions" << endl;
+    cout << "-----------" << endl;
+    for (const auto & production : _productions) {
+        cout << _nonterminals[production.lhsSymbol] << " -> ";
+        for (const auto & s : production.rhsSymbols)
+            cout << '(' << s.type << ',' << _symbolName(s) << ") ";
+        cout << endl;
+    }
+    cout << endl;
+#endif // LOG_DEBUG
+
+    return true;
+}
+
+bool Grammar::_readSemanticsFile(const std::string & configFile) {
+
+    static const int SEMANTICS_UNARY_LEFT_OPERATOR = 0;
+    static const int SEMANTICS_UNUSED_TERMINAL = 1;
+    static const int SEMANTICS_BUILD_ACTION = 2;
+    static const int SEMANTICS_INFIX_OPERATOR = 3;
+    static const int SEMANTICS_PREFIX_OPERATOR = 4;
+    static const int SEMANTICS_GROUP = 5;
+
+    ifstream ifs(configFile);
+    if (ifs.fail()) {
+        cerr << "Error: Failed to open semantics config file " << configFile << endl;
+        return false;
+    }
+
+    int lineCount = 0;
+    while (ifs) {
+        string line;
+        getline(ifs, line);
+        lineCount++;
+
+        // Make sure the line is non-empty and non-comment
+        auto itFirstChar = find_if(line.begin(), line.end(), [](char c) {return !isspace(c); });
+        if (itFirstChar == line.end() || *itFirstChar == '#')
+            continue;
+
+        // Tokenize the line, split by whitespace
+        regex regex("[^ \\t\\n]+");
+        auto it = sregex_iterator(line.begin(), line.end(), regex);
+        if (it == sregex_iterator())
+            continue;
+
+        const auto & match = *it;
+        int type = atoi(match.str().c_str());
+        switch (type) {
+            case SEMANTICS_UNARY_LEFT_OPERATOR:
+            case SEMANTICS_BUILD_ACTION:
+                {
+                    vector<int> args;
+                    for (++it; it != sregex_iterator(); ++it) {
+                        const auto & match = *it;
+                        args.push_back(atoi(match.str().c_str()));
+                    }
+                    // Both give a production and the index of a symbol in it
+                    if (args.size() != 2 || args[0] < 0 || args[0] >= (int)_productions.size()
+                        || args[1] < 0 || args[1] >= (int)_productions[args[0]].rhsSymbols.size()) {
+                        cerr << "Error: Malformed line " << lineCount << " in file "
+                            << configFile << endl;
+                        return false;
+                    }
+                    if (type == SEMANTICS_UNARY_LEFT_OPERATOR)
+                        _unaryOperators[args[0]] = args[1];
+                    else
+                        _buildActions[args[0]] = args[1];
+                }
+                break;
+
+            case SEMANTICS_UNUSED_TERMINAL:
+                {
+                    int terminal = _findTerminal((*(++it)).str());
+                    if (terminal != -1)
+                        _unusedTerminals[terminal] = 1;
+                }
+                break;
+
+            case SEMANTICS_INFIX_OPERATOR:
+            case SEMANTICS_PREFIX_OPERATOR:
+            case SEMANTICS_GROUP:
+                {
+                    vector<string> args;
+                    for (++it; it != sregex_iterator(); ++it)
+                        args.push_back((*it).str());
+
+                    // The operator or opening terminal, then the closing
+                    // terminal of a group, the precedence, and the
+                    // associativity of an infix operator
+                    size_t numArgs = (type == SEMANTICS_PREFIX_OPERATOR) ? 2 : 3;
+                    int terminal = (args.size() == numArgs) ? _findTerminal(args[0]) : -1;
+                    int closer = (type == SEMANTICS_GROUP && terminal != -1) ? _findTerminal(args[1]) : -1;
+                    int precedence = (terminal != -1) ? atoi(args[type == SEMANTICS_GROUP ? 2 : 1].c_str()) : 0;
+                    const string & associativity = args.back();
+                    if (terminal == -1 || precedence <= 0 || (type == SEMANTICS_GROUP && closer == -1)
+                        || (type == SEMANTICS_INFIX_OPERATOR
+                            && associativity != "L" && associativity != "R" && associativity != "N")) {
+                        cerr << "Error: Malformed line " << lineCount << " in file "
+                            << configFile << endl;
+                        return false;
+                    }
+
+                    if (type == SEMANTICS_INFIX_OPERATOR) {
+                        _infixPrecedence[terminal] = precedence;
+                        _infixAssociativity[terminal] = (associativity == "L") ? LEFT
+                            : (associativity == "R") ? RIGHT : NONASSOCIATIVE;
+                    } else if (type == SEMANTICS_PREFIX_OPERATOR) {
+                        _prefixPrecedence[terminal] = precedence;
+                    } else {
+                        _groupClosers[terminal] = closer;
+                        _groupPrecedence[terminal] = precedence;
+                    }
+                }
+                break;
+        }
+    }
+
+    return true;
+}
+
+//
+// Computes the set FIRST(A) for each nonterminal symbol A, i.e. the set of
+// terminal symbols that can appear as the first symbol in some sequence
+// derived from A. The special epsilon symbol is denoted by EPSILON_ID;
+//
+void Grammar::_computeFIRST(vector<SymbolSet> & FIRST) {
+
+    FIRST.assign(_nonterminals.size(), SymbolSet());
+
+    bool setsChanged = true;
+    while (setsChanged) {
+        setsChanged = false;
+        for (const auto & production : _productions) {
+            SymbolSet rhs;
+            for (const auto & symbol : production.rhsSymbols) {
+
+                rhs.erase(EPSILON_ID);
+                if (symbol.type == Symbol::EPSILON) {
+                    rhs.insert(EPSILON_ID);
+                } else if (symbol.type == Symbol::TERMINAL) {
+                    rhs.insert(symbol.id);
+                    break;
+                } else if (symbol.type == Symbol::NONTERMINAL) {
+                    for (int terminal : FIRST[symbol.id])
+                        rhs.insert(terminal);
+                    if (rhs.find(EPSILON_ID) == rhs.end())
+                        break;
+                }
+            }
+
+            // FIRST(A) = FIRST(A) U rhs
+            auto & FIRSTSet = FIRST[production.lhsSymbol];
+            for (int terminal : rhs) {
+                if (FIRSTSet.insert(terminal).second)
+                    setsChanged = true;
+            }
+        }
+    }
+
+#ifdef LOG_DEBUG
+    cout << "FIRST sets" << endl;
+    cout << "----------" << endl;
+    for (size_t i = 0; i < FIRST.size(); i++) {
+        cout << _nonterminals[i] << " : ";
+        for (int terminal : FIRST[i])
+            cout << (terminal != EPSILON_ID ? _terminals[terminal] : "^e$") << " ";
+        cout << endl;
+    }
+    cout << endl;
+#endif // LOG_DEBUG
+}
+
+//
+// Computes the set FOLLOW(A) set for each nonterminal symbol A, i.e. the set
+// of terminal symbols that can appear to the immediate right of a sequence
+// derived from A. The special EOF symbol is denoted by TOKEN_EOF;
+//
+void Grammar::_computeFOLLOW(const vector<SymbolSet> & FIRST, vector<SymbolSet> & FOLLOW) {
+
+    FOLLOW.assign(_nonterminals.size(), SymbolSet());
+    FOLLOW[_startSymbol].insert(TOKEN_EOF);
+
+    bool setsChanged = true;
+    while (setsChanged) {
+        setsChanged = false;
+        for (const auto & production : _productions) {
+            SymbolSet trailer = FOLLOW[production.lhsSymbol];
+            for (size_t i = production.rhsSymbols.size(); i > 0; i--) {
+
+                const auto & symbol = production.rhsSymbols[i - 1];
+                if (symbol.type != Symbol::NONTERMINAL) {
+                    trailer.clear();
+                    trailer.insert(symbol.id);
+                } else {
+                    // FOLLOW(A) = FOLLOW(A) U trailer
+                    auto & FOLLOWSet = FOLLOW[symbol.id];
+                    for (int terminal : trailer) {
+                        if (FOLLOWSet.insert(terminal).second)
+                            setsChanged = true;
+                    }
+
+                    const auto & FIRSTSet = FIRST[symbol.id];
+                    if (FIRSTSet.find(EPSILON_ID) != FIRSTSet.end()) {
+                        // trailer = trailer U (FIRST(A) - epsilon)
+                        for (int terminal : FIRSTSet)
+                            trailer.insert(terminal);
+                        trailer.erase(EPSILON_ID);
+                    } else {
+                        trailer = FIRSTSet;
+                    }
+                }
+            }
+        }
+    }
+
+#ifdef LOG_DEBUG
+    cout << "FOLLOW sets" << endl;
+    cout << "-----------" << endl;
+    for (size_t i = 0; i < FOLLOW.size(); i++) {
+        cout << _nonterminals[i] << " : ";
+        for (int terminal : FOLLOW[i])
+            cout << _terminals[terminal] << " ";
+        cout << endl;
+    }
+    cout << endl;
+#endif // LOG_DEBUG
+}
+
+//
+// Computes the set FIRST+ for each production, defined as:
+//
+//     FIRST+(A -> b) = FIRST(b)              , if epsilon not in FIRST(b)
+//                      FIRST(b) U FOLLOW(A)  , otherwise
+//
+void Grammar::_computeFIRST_PLUS(const vector<SymbolSet> & FIRST,
+    const vector<SymbolSet> & FOLLOW, vector<SymbolSet> & FIRST_PLUS) {
+
+    for (size_t i = 0; i < _productions.size(); i++) {
+        const auto & production = _productions[i];
+        auto & FIRSTPSet = FIRST_PLUS[i];
+
+        // FIRST+(A -> b) = FIRST(b)
+        for (const auto & symbol : production.rhsSymbols) {
+            FIRSTPSet.erase(EPSILON_ID);
+            if (symbol.type == Symbol::EPSILON) {
+                FIRSTPSet.insert(EPSILON_ID);
+            } else if (symbol.type == Symbol::TERMINAL) {
+                FIRSTPSet.insert(symbol.id);
+                break;
+            } else if (symbol.type == Symbol::NONTERMINAL) {
+                for (int terminal : FIRST[symbol.id])
+                    FIRSTPSet.insert(terminal);
+                if (FIRSTPSet.find(EPSILON_ID) == FIRSTPSet.end())
+                    break;
+            }
+        }
+
+        if (FIRSTPSet.find(EPSILON_ID) != FIRSTPSet.end()) {
+            // FIRST+(A -> b) = FIRST+(A -> b) U FOLLOW(A)
+            for (int terminal : FOLLOW[production.lhsSymbol])
+                FIRSTPSet.insert(terminal);
+        }
+    }
+
+#ifdef LOG_DEBUG
+    cout << "FIRST+ sets" << endl;
+    cout << "-----------" << endl;
+    for (size_t i = 0; i < FIRST_PLUS.size(); i++) {
+        cout << i << " : ";
+        for (int terminal : FIRST_PLUS[i])
+            cout << (terminal != EPSILON_ID ? _terminals[terminal] : "^e$") << " ";
+        cout << endl;
+    }
+    cout << endl;
+#endif // LOG_DEBUG
+}
+
+void Grammar::_constructLL1Table(const vector<SymbolSet> & FIRST_PLUS) {
+    size_t numTerminals = _terminals.size();
+    _ll1Table.assign(_nonterminals.size() * numTerminals, -1);
+    for (size_t i = 0; i < _productions.size(); i++) {
+        int lhsSymbol = _productions[i].lhsSymbol;
+        for (int terminal : FIRST_PLUS[i])
+            if (terminal != EPSILON_ID)
+                _ll1Table[lhsSymbol * numTerminals + terminal] = (int)i;
+    }
+
+#ifdef LOG_DEBUG
+    cout << "LL(1) Table" << endl;
+    cout << "-----------" << endl;
+    for (size_t i = 0; i < _nonterminals.size(); i++) {
+        cout << _nonterminals[i] << " : ";
+        for (size_t j = 0; j < numTerminals; j++)
+            if (_ll1Table[i * numTerminals + j] != -1)
+                cout << '(' << _terminals[j] << ',' << _ll1Table[i * numTerminals + j] << ')';
+        cout << endl;
+    }
+    cout << endl;
+#endif // LOG_DEBUG
+}
+
+
+void Grammar::_findOperatorTerminals() {
+    _operatorTerminals = _binaryTerminals;
+    for (size_t i = 0; i < _productions.size(); i++) {
+        if (_unaryOperators[i] != -1)
+            _operatorTerminals[_productions[i].rhsSymbols[_unaryOperators[i]].id] = 1;
+    }
+}
+
+
+int Grammar::_findTerminal(const string & name) const {
+    // Token kind 0 is the end of input, which has no name in the grammar
+    for (size_t i = TOKEN_EOF + 1; i < _terminals.size(); i++)
+        if (_terminals[i] == name)
+            return (int)i;
+    return -1;
+}
+
+
+string Grammar::_symbolName(const Symbol & symbol) const {
+    switch (symbol.type) {
+        case Symbol::TERMINAL: return _terminals[symbol.id];
+        case Symbol::NONTERMINAL: return _nonterminals[symbol.id];
+        case Symbol::EPSILON: return "^e$";
+        default: return "EOF";
+    }
+}
+
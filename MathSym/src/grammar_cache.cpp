@@ -0,0 +1,340 @@
+#include "grammar_cache.h"
+#include "mapped_file.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+
+static_assert(sizeof(int) == sizeof(int32_t), "Cache tables are stored as 32-bit integers");
+
+namespace {
+
+const char CACHE_MAGIC[8] = { 'M', 'S', 'Y', 'M', 'G', 'R', 'M', 0 };
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t configHash;
+    uint64_t payloadSize;
+    uint64_t payloadHash;
+};
+
+// 64-bit FNV-1a
+uint64_t hashBytes(const char * data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+//
+// Serializes tables as a sequence of arrays, each one an element count
+// followed by the raw elements, padded to 8 bytes
+//
+class CacheWriter {
+public:
+    template<typename T>
+    void writeValue(const T & value) {
+        _append(&value, sizeof(T));
+    }
+
+    template<typename T>
+    void writeArray(const vector<T> & values) {
+        writeValue((uint64_t)values.size());
+        if (!values.empty())
+            _append(values.data(), values.size() * sizeof(T));
+    }
+
+    // Strings are stored as an array of end offsets, followed by one array
+    // with all their characters
+    void writeStrings(const vector<string> & strings) {
+        vector<uint32_t> ends;
+        string chars;
+        for (const auto & s : strings) {
+            chars += s;
+            ends.push_back((uint32_t)chars.size());
+        }
+        writeArray(ends);
+        writeArray(vector<char>(chars.begin(), chars.end()));
+    }
+
+    const string & buffer() const { return _buffer; }
+
+private:
+    void _append(const void * data, size_t size) {
+        _buffer.append((const char *)data, size);
+        _buffer.append((8 - _buffer.size() % 8) % 8, '\0');
+    }
+
+    string _buffer;
+};
+
+class CacheReader {
+public:
+    CacheReader(const char * data, size_t size) : _pos(data), _end(data + size) {}
+
+    template<typename T>
+    bool readValue(T & value) {
+        if ((size_t)(_end - _pos) < sizeof(T))
+            return false;
+        memcpy(&value, _pos, sizeof(T));
+        _advance(sizeof(T));
+        return true;
+    }
+
+    template<typename T>
+    bool readArray(vector<T> & values) {
+        uint64_t count;
+        if (!readValue(count) || count > (uint64_t)(_end - _pos) / sizeof(T))
+            return false;
+        values.resize((size_t)count);
+        if (count != 0) {
+            memcpy(values.data(), _pos, (size_t)count * sizeof(T));
+            _advance((size_t)count * sizeof(T));
+        }
+        return true;
+    }
+
+    bool readStrings(vector<string> & strings) {
+        vector<uint32_t> ends;
+        vector<char> chars;
+        if (!readArray(ends) || !readArray(chars))
+            return false;
+
+        strings.clear();
+        uint32_t begin = 0;
+        for (uint32_t end : ends) {
+            if (end < begin || end > chars.size())
+                return false;
+            strings.push_back(string(chars.data() + begin, end - begin));
+            begin = end;
+        }
+        return true;
+    }
+
+    bool atEnd() const { return _pos == _end; }
+
+private:
+    void _advance(size_t size) {
+        size_t padded = size + (8 - size % 8) % 8;
+        _pos += min(padded, (size_t)(_end - _pos));
+    }
+
+    const char * _pos;
+    const char * _end;
+};
+
+}
+
+
+const uint32_t GrammarCache::VERSION;
+
+
+uint64_t GrammarCache::hashFiles(const vector<string> & fileNames) {
+    uint64_t hash = hashBytes(NULL, 0);
+    for (const auto & fileName : fileNames) {
+        ifstream ifs(fileName, ios::binary);
+        if (ifs.fail())
+            return 0;
+
+        stringstream contents;
+        contents << ifs.rdbuf();
+        const string data = contents.str();
+
+        // Hash the size as well, so that content moving between files counts
+        uint64_t size = data.size();
+        hash = hashBytes((const char *)&size, sizeof(size), hash);
+        hash = hashBytes(data.data(), data.size(), hash);
+    }
+    return hash;
+}
+
+
+bool GrammarCache::load(const string & cacheFile, uint64_t configHash,
+    Tokenizer & tokenizer, Grammar & grammar) {
+
+    if (configHash == 0)
+        return false;
+
+    MappedFile file;
+    if (!file.open(cacheFile) || file.size() < sizeof(CacheHeader))
+        return false;
+
+    CacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    const char * payload = file.data() + sizeof(header);
+    if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        || header.version != VERSION
+        || header.byteOrder != BYTE_ORDER_MARK
+        || header.configHash != configHash
+        || header.payloadSize != file.size() - sizeof(header)
+        || header.payloadHash != hashBytes(payload, (size_t)header.payloadSize))
+        return false;
+
+    CacheReader reader(payload, (size_t)header.payloadSize);
+
+    // Tokenizer
+    DFA & dfa = tokenizer._dfa;
+    int32_t numClasses = 0;
+    bool ok = reader.readStrings(tokenizer._kindNames)
+        && reader.readArray(tokenizer._ruleKinds)
+        && reader.readArray(dfa._byteClasses)
+        && reader.readValue(numClasses)
+        && reader.readArray(dfa._transitions)
+        && reader.readArray(dfa._acceptRule);
+    dfa._numClasses = numClasses;
+
+    // Grammar
+    vector<int> productionLhs, productionEnds, rhsTypes, rhsIds;
+    ok = ok && reader.readStrings(grammar._terminals)
+        && reader.readStrings(grammar._nonterminals)
+        && reader.readValue(grammar._startSymbol)
+        && reader.readArray(productionLhs)
+        && reader.readArray(productionEnds)
+        && reader.readArray(rhsTypes)
+        && reader.readArray(rhsIds)
+        && reader.readArray(grammar._ll1Table)
+        && reader.readArray(grammar._binaryTerminals)
+        && reader.readArray(grammar._unaryOperators)
+        && reader.readArray(grammar._unusedTerminals)
+        && reader.readArray(grammar._operatorTerminals)
+        && reader.readArray(grammar._buildActions)
+        && reader.readArray(grammar._infixPrecedence)
+        && reader.readArray(grammar._infixAssociativity)
+        && reader.readArray(grammar._prefixPrecedence)
+        && reader.readArray(grammar._groupClosers)
+        && reader.readArray(grammar._groupPrecedence)
+        && reader.atEnd();
+    if (!ok)
+        return false;
+
+    // The payload hash guards against corruption; these only guard against
+    // an image written by an incompatible build
+    size_t numStates = dfa._acceptRule.size();
+    size_t numTerminals = grammar._terminals.size();
+    size_t numProductions = productionLhs.size();
+    if (dfa._byteClasses.size() != 256 || numStates == 0
+        || dfa._transitions.size() != numStates * (size_t)numClasses
+        || productionEnds.size() != numProductions || rhsTypes.size() != rhsIds.size()
+        || grammar._ll1Table.size() != grammar._nonterminals.size() * numTerminals
+        || grammar._binaryTerminals.size() != numTerminals
+        || grammar._unusedTerminals.size() != numTerminals
+        || grammar._operatorTerminals.size() != numTerminals
+        || grammar._infixPrecedence.size() != numTerminals
+        || grammar._infixAssociativity.size() != numTerminals
+        || grammar._prefixPrecedence.size() != numTerminals
+        || grammar._groupClosers.size() != numTerminals
+        || grammar._groupPrecedence.size() != numTerminals
+        || grammar._buildActions.size() != numProductions
+        || grammar._unaryOperators.size() != numProductions)
+        return false;
+
+    grammar._productions.clear();
+    grammar._productions.reserve(numProductions);
+    int begin = 0;
+    for (size_t i = 0; i < numProductions; i++) {
+        if (productionEnds[i] < begin || productionEnds[i] > (int)rhsIds.size())
+            return false;
+
+        Grammar::Production production = { productionLhs[i], vector<Grammar::Symbol>() };
+        for (int j = begin; j < productionEnds[i]; j++)
+            production.rhsSymbols.push_back({ (Grammar::Symbol::SymbolType)rhsTypes[j], rhsIds[j] });
+        grammar._productions.push_back(production);
+        begin = productionEnds[i];
+    }
+
+    return true;
+}
+
+
+bool GrammarCache::save(const string & cacheFile, uint64_t configHash,
+    const Tokenizer & tokenizer, const Grammar & grammar) {
+
+    if (configHash == 0)
+        return false;
+
+    CacheWriter writer;
+
+    // Tokenizer
+    const DFA & dfa = tokenizer._dfa;
+    writer.writeStrings(tokenizer._kindNames);
+    writer.writeArray(tokenizer._ruleKinds);
+    writer.writeArray(dfa._byteClasses);
+    writer.writeValue((int32_t)dfa._numClasses);
+    writer.writeArray(dfa._transitions);
+    writer.writeArray(dfa._acceptRule);
+
+    // Grammar
+    vector<int> productionLhs, productionEnds, rhsTypes, rhsIds;
+    for (const auto & production : grammar._productions) {
+        productionLhs.push_back(production.lhsSymbol);
+        for (const auto & symbol : production.rhsSymbols) {
+            rhsTypes.push_back(symbol.type);
+            rhsIds.push_back(symbol.id);
+        }
+        productionEnds.push_back((int)rhsIds.size());
+    }
+    writer.writeStrings(grammar._terminals);
+    writer.writeStrings(grammar._nonterminals);
+    writer.writeValue(grammar._startSymbol);
+    writer.writeArray(productionLhs);
+    writer.writeArray(productionEnds);
+    writer.writeArray(rhsTypes);
+    writer.writeArray(rhsIds);
+    writer.writeArray(grammar._ll1Table);
+    writer.writeArray(grammar._binaryTerminals);
+    writer.writeArray(grammar._unaryOperators);
+    writer.writeArray(grammar._unusedTerminals);
+    writer.writeArray(grammar._operatorTerminals);
+    writer.writeArray(grammar._buildActions);
+    writer.writeArray(grammar._infixPrecedence);
+    writer.writeArray(grammar._infixAssociativity);
+    writer.writeArray(grammar._prefixPrecedence);
+    writer.writeArray(grammar._groupClosers);
+    writer.writeArray(grammar._groupPrecedence);
+
+    const string & payload = writer.buffer();
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.configHash = configHash;
+    header.payloadSize = payload.size();
+    header.payloadHash = hashBytes(payload.data(), payload.size());
+
+    // Write to a temporary file first and rename it, so that concurrently
+    // starting processes never map a partially written image
+    string tempFile = cacheFile + "." + to_string(
+        chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        ofstream ofs(tempFile, ios::binary);
+        if (ofs.fail())
+            return false;
+        ofs.write((const char *)&header, sizeof(header));
+        ofs.write(payload.data(), payload.size());
+        if (ofs.fail()) {
+            ofs.close();
+            remove(tempFile.c_str());
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    remove(cacheFile.c_str());
+#endif
+    if (rename(tempFile.c_str(), cacheFile.c_str()) != 0) {
+        remove(tempFile.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -1,6 +1,15 @@
+#include "batch.h"
+#include "evaluator.h"
+#include "grammar.h"
+#include "grammar_cache.h"
+#include "mapped_file.h"
+#include "result_cache.h"
+#include "server.h"
 #include "tokenizer.h"
-#include "parser.h"
 
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <string>
 
@@ -9,32 +18,245 @@ using namespace std;
 const string TOKENIZER_CONFIG = "tokenizer_config.txt";
 const string PARSER_CONFIG = "parser_config.txt";
 const string SEMANTICS_CONFIG = "semantics_config.txt";
+const string GRAMMAR_CACHE = "grammar_cache.bin";
 
 
-int main()
+const size_t DEFAULT_CACHE_SIZE = 10000;
+
+const char * USAGE =
+    "Usage: MathSym [options]                  - interactive prompt\n"
+    "       MathSym --batch [options] [input]  - evaluates every line of the input file\n"
+    "                                            (default: standard input)\n"
+    "       MathSym --server ADDRESS [options] - serves lines on the Unix domain socket\n"
+    "                                            ADDRESS, or on localhost:PORT over TCP\n"
+    "\n"
+    "Options:\n"
+    "    -o, --output FILE      batch output file (default: standard output)\n"
+    "    -j, --threads N        batch threads (default: one per core)\n"
+    "    -p, --pipeline         batch with a thread per stage instead: reading, tokenizing,\n"
+    "                           parsing, evaluating and writing, in input order\n"
+    "    -c, --cache-size N     results kept for repeated lines (default: 10000, 0: off)\n"
+    "    -i, --complex          also print the complex solutions of equations\n"
+    "    -r, --rational         exact rational arithmetic, with answers as fractions\n"
+    "    -e, --engine NAME      parsing engine: precedence (the operator precedence table\n"
+    "                           of the semantics config) or ll1 (default: precedence if\n"
+    "                           the semantics config has the table, otherwise ll1)\n";
+
+struct Options {
+    bool batch = false;
+    string serverAddress;
+    string inputFile = "-";
+    string outputFile = "-";
+    size_t numThreads = 0;
+    bool pipelined = false;
+    size_t cacheSize = DEFAULT_CACHE_SIZE;
+    string engine;
+    bool complexSolutions = false;
+    bool exact = false;
+};
+
+
+bool parseOptions(int argc, char * argv[], Options & options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--batch" || arg == "-b") {
+            options.batch = true;
+        } else if ((arg == "--server" || arg == "-s") && i + 1 < argc) {
+            options.serverAddress = argv[++i];
+        } else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
+            options.outputFile = argv[++i];
+        } else if ((arg == "--threads" || arg == "-j") && i + 1 < argc) {
+            options.numThreads = strtoul(argv[++i], NULL, 10);
+        } else if (arg == "--pipeline" || arg == "-p") {
+            options.pipelined = true;
+        } else if ((arg == "--cache-size" || arg == "-c") && i + 1 < argc) {
+            options.cacheSize = strtoul(argv[++i], NULL, 10);
+        } else if (arg == "--complex" || arg == "-i") {
+            options.complexSolutions = true;
+        } else if (arg == "--rational" || arg == "-r") {
+            options.exact = true;
+        } else if ((arg == "--engine" || arg == "-e") && i + 1 < argc
+            && (string(argv[i + 1]) == "precedence" || string(argv[i + 1]) == "ll1")) {
+            options.engine = argv[++i];
+        } else if ((arg.empty() || arg[0] != '-' || arg == "-") && options.inputFile == "-") {
+            options.inputFile = arg;
+        } else {
+            return false;
+        }
+    }
+
+    // The input and output files only apply to the batch mode
+    return options.batch || (options.inputFile == "-" && options.outputFile == "-");
+}
+
+
+// Prints the result of a line at the interactive prompt
+void printResult(const string & line, const Result & result) {
+    if (result.ok) {
+        cout << result.text << endl;
+    } else if (result.errorColumn != Result::NO_COLUMN) {
+        // Point at the error under the line
+        cerr << line << endl;
+        for (size_t i = 0; i < result.errorColumn; i++)  cerr << (line[i] == '\t' ? '\t' : ' ');
+        cerr << '|' << endl << "Error: " << result.text << endl << endl;
+    } else {
+        cerr << "Error: " << result.text << endl;
+    }
+}
+
+
+int runBatch(const Tokenizer & tokenizer, const Grammar & grammar, const Options & options,
+    ResultCache & cache) {
+    // The standard streams are only used through the C++ library from here on
+    ios::sync_with_stdio(false);
+
+    // Input files are mapped and evaluated in place, unless they cannot be,
+    // such as pipes, which are read as streams
+    MappedFile mappedInput;
+    bool mapped = (options.inputFile != "-") && mappedInput.open(options.inputFile);
+    if (mapped)
+        mappedInput.adviseSequential();
+
+    ifstream inputStream;
+    if (options.inputFile != "-" && !mapped) {
+        inputStream.open(options.inputFile, ios::binary);
+        if (inputStream.fail()) {
+            cerr << "Error: Failed to open input file " << options.inputFile << endl;
+            return 1;
+        }
+    }
+
+    ofstream outputStream;
+    if (options.outputFile != "-") {
+        outputStream.open(options.outputFile, ios::binary);
+        if (outputStream.fail()) {
+            cerr << "Error: Failed to open output file " << options.outputFile << endl;
+            return 1;
+        }
+    }
+
+    istream & in = (options.inputFile != "-") ? inputStream : cin;
+    ostream & out = (options.outputFile != "-") ? outputStream : cout;
+    BatchEvaluator batchEvaluator(tokenizer, grammar, options.numThreads, &cache);
+    batchEvaluator.setComplexSolutions(options.complexSolutions);
+    batchEvaluator.setExact(options.exact);
+    batchEvaluator.setPipelined(options.pipelined);
+    BatchStats stats = mapped
+        ? batchEvaluator.run(mappedInput.data(), mappedInput.data() + mappedInput.size(), out)
+        : batchEvaluator.run(in, out);
+    if (out.fail()) {
+        cerr << "Error: Failed to write the output" << endl;
+        return 1;
+    }
+
+    // Summary, kept off the standard output so that it does not mix with the results
+    cerr << "Processed " << stats.lines << " lines (" << stats.errors << " errors) in "
+        << stats.seconds << " s on " << stats.threads << " threads: "
+        << (stats.seconds > 0 ? stats.lines / stats.seconds : 0)
+        << " lines/s, " << (stats.seconds > 0 ? stats.bytes / stats.seconds / 1e6 : 0) << " MB/s" << endl;
+    if (cache.enabled())
+        cerr << "Result cache: " << cache.hits() << " hits, " << cache.misses() << " misses" << endl;
+    if (stats.skippedEvaluations != 0)
+        cerr << "Repeated subexpressions: " << stats.skippedEvaluations << " evaluations skipped" << endl;
+    return 0;
+}
+
+
+// The server stopped by SIGINT and SIGTERM
+Server * runningServer = NULL;
+
+void stopServer(int) {
+    runningServer->stop();
+}
+
+
+int runServer(const Tokenizer & tokenizer, const Grammar & grammar, const Options & options,
+    ResultCache & cache) {
+    Server server(tokenizer, grammar, &cache);
+    server.setComplexSolutions(options.complexSolutions);
+    server.setExact(options.exact);
+    if (!server.listen(options.serverAddress))
+        return 1;
+
+    runningServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    cerr << "Listening on " << options.serverAddress << endl;
+    ServerStats stats = server.run();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    runningServer = NULL;
+
+    cerr << "Served " << stats.requests << " requests (" << stats.errors << " errors) on "
+        << stats.connections << " connections in " << stats.seconds << " s" << endl;
+    if (cache.enabled())
+        cerr << "Result cache: " << cache.hits() << " hits, " << cache.misses() << " misses" << endl;
+    if (server.evaluator().parser().skippedEvaluations() != 0)
+        cerr << "Repeated subexpressions: " << server.evaluator().parser().skippedEvaluations()
+            << " evaluations skipped" << endl;
+    return 0;
+}
+
+
+int main(int argc, char * argv[])
 {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        cerr << USAGE;
+        return 1;
+    }
+
+    // Failures only give an exit status outside the interactive prompt
+    int failureStatus = (options.batch || !options.serverAddress.empty()) ? 1 : 0;
     Tokenizer tokenizer;
-    Parser parser;
+    Grammar grammar;
+
+    // Load the tables from the binary cache if it is up-to-date with the
+    // config files, otherwise build them and refresh the cache
+    uint64_t configHash = GrammarCache::hashFiles({ TOKENIZER_CONFIG, PARSER_CONFIG, SEMANTICS_CONFIG });
+    if (!GrammarCache::load(GRAMMAR_CACHE, configHash, tokenizer, grammar)) {
+        tokenizer = Tokenizer();
+        grammar = Grammar();
+
+        if (!tokenizer.init(TOKENIZER_CONFIG))
+            return failureStatus;
 
-    if (!tokenizer.init(TOKENIZER_CONFIG))
-        return 0;
+        if (!grammar.init(tokenizer.tokenKinds(), PARSER_CONFIG, SEMANTICS_CONFIG))
+            return failureStatus;
 
-    if (!parser.init(PARSER_CONFIG, SEMANTICS_CONFIG))
-        return 0;
-    
+        GrammarCache::save(GRAMMAR_CACHE, configHash, tokenizer, grammar);
+    }
+
+    bool precedence = options.engine.empty() ? grammar.hasPrecedenceTable() : (options.engine == "precedence");
+    if (!grammar.setEngine(precedence ? Grammar::OPERATOR_PRECEDENCE : Grammar::LL1))
+        return failureStatus;
+
+    ResultCache cache(options.cacheSize);
+    if (options.batch)
+        return runBatch(tokenizer, grammar, options, cache);
+    if (!options.serverAddress.empty())
+        return runServer(tokenizer, grammar, options, cache);
+
+    Evaluator evaluator(tokenizer, grammar, &cache);
+    evaluator.setComplexSolutions(options.complexSolutions);
+    evaluator.setExact(options.exact);
     while (true) {
         // Read a line from the standard input
         cout << ">> ";
         string line;
-        getline(cin, line);
-        if (line == "exit")
+        if (!getline(cin, line) || line == "exit")
             break;
 
-        vector<Token> tokens;
-        if (!tokenizer.tokenize(line, tokens))
+        // Commands of the prompt itself
+        if (line == ":stats") {
+            evaluator.stats().print(cout);
+            continue;
+        } else if (line == ":stats reset") {
+            evaluator.resetStats();
             continue;
+        }
 
-        parser.parse(tokens, line);
+        printResult(line, evaluator.evaluate(line));
     }
 
     return 0;
@@ -0,0 +1,114 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string & fileName) {
+    close();
+
+    _fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (_fileHandle == INVALID_HANDLE_VALUE) {
+        _fileHandle = NULL;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (GetFileType(_fileHandle) != FILE_TYPE_DISK || !GetFileSizeEx(_fileHandle, &fileSize)) {
+        close();
+        return false;
+    }
+    _size = (size_t)fileSize.QuadPart;
+    if (_size == 0)
+        return true;   // Empty files cannot be mapped, but are valid
+
+    _mappingHandle = CreateFileMappingA(_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (_mappingHandle == NULL) {
+        close();
+        return false;
+    }
+
+    _data = (const char *)MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (_data == NULL) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data)
+        UnmapViewOfFile(_data);
+    if (_mappingHandle)
+        CloseHandle(_mappingHandle);
+    if (_fileHandle)
+        CloseHandle(_fileHandle);
+
+    _data = NULL;
+    _size = 0;
+    _mappingHandle = NULL;
+    _fileHandle = NULL;
+}
+
+void MappedFile::adviseSequential() const {
+    // Windows has no such hint for a mapped view; it reads ahead on its own
+}
+
+#else
+
+bool MappedFile::open(const string & fileName) {
+    close();
+
+    _fd = ::open(fileName.c_str(), O_RDONLY);
+    if (_fd == -1)
+        return false;
+
+    struct stat st;
+    if (fstat(_fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        close();
+        return false;
+    }
+    _size = (size_t)st.st_size;
+    if (_size == 0)
+        return true;   // Empty files cannot be mapped, but are valid
+
+    void * data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (data == MAP_FAILED) {
+        close();
+        return false;
+    }
+    _data = (const char *)data;
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data)
+        munmap((void *)_data, _size);
+    if (_fd != -1)
+        ::close(_fd);
+
+    _data = NULL;
+    _size = 0;
+    _fd = -1;
+}
+
+void MappedFile::adviseSequential() const {
+    if (_data)
+        madvise((void *)_data, _size, MADV_SEQUENTIAL);
+}
+
+#endif
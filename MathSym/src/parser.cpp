@@ -1,835 +1,790 @@
 #include "parser.h"
 
 #include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <regex>
-#include <stack>
 
 //#define LOG_DEBUG
 
 using namespace std;
 
 
-const unordered_set<string> Parser::_binaryOperators = { "+", "-", "*", "/", "=" };
+const size_t Parser::MIN_SHARING_TOKENS;
 
 
-bool Parser::init(const string & configFile, const string & semanticsFile) {
-
-    unordered_set<string> nonterminals;
-    if (!_readConfigFile(configFile, nonterminals))
-        return false;
-
-    unordered_map<string, unordered_set<string>> FIRST;
-    _computeFIRST(nonterminals, FIRST);
-
-    unordered_map<string, unordered_set<string>> FOLLOW;
-    _computeFOLLOW(nonterminals, FIRST, FOLLOW);
-
-    vector<unordered_set<string>> FIRST_PLUS(_productions.size());
-    _computeFIRST_PLUS(FIRST, FOLLOW, FIRST_PLUS);
-
-    _constructLL1Table(FIRST_PLUS);
+bool Parser::parseTree(const vector<Token> & tokens, const char * begin, const char * end, Result & result) {
+    _astArena.reset();
+    _astTree = _buildAST(tokens, begin, end, _astArena, result);
+    _numTokens = tokens.size();
+    return _astTree != NULL;
+}
 
-    if (semanticsFile != "" && !_readSemanticsFile(semanticsFile))
-        return false;
 
-    return true;
+bool Parser::evaluateTree(Result & result) {
+    ASTNode * astTree = _astTree;
+    _astTree = NULL;
+    return _evaluateAST(astTree, _numTokens, result);
 }
 
 
-bool Parser::parse(vector<Token> & tokens, const string & line) {
-
-    ASTNode * astTree = _parseAndCreateParseTree(tokens, line);
-    if (!astTree)
-        return false;
+bool Parser::parseTree(const vector<Token> & tokens, const char * begin, const char * end, Arena & arena,
+    Tree & tree, Result & result) {
 
-    astTree = _convertParseTreeToAST(astTree);
+    tree._root = _buildAST(tokens, begin, end, arena, result);
+    tree._line = begin;
+    tree._lineLength = end - begin;
+    tree._numTokens = tokens.size();
+    return tree._root != NULL;
+}
 
-    _evalASTTree(astTree);
 
-    return true;
+bool Parser::evaluateTree(const Tree & tree, Result & result) {
+    _line = tree._line;
+    _lineLength = tree._lineLength;
+    _stats.start();
+    return _evaluateAST(tree._root, tree._numTokens, result);
 }
 
 
-bool Parser::_readConfigFile(const std::string & configFile,
-    std::unordered_set<std::string> & nonterminals) {
-
-    ifstream ifs(configFile);
-    if (ifs.fail()) {
-        cerr << "Error: Failed to open tokenizer config file " << configFile << endl;
+bool Parser::_evaluateAST(ASTNode * astTree, size_t numTokens, Result & result) {
+    if (!astTree) {
+        result.setError("No expression is parsed");
         return false;
     }
 
-    int lineCount = 0;
-    while (ifs) {
-        string line;
-        getline(ifs, line);
-        lineCount++;
-
-        // Make sure the line is non-empty and non-comment
-        auto itFirstChar = find_if(line.begin(), line.end(), [](char c) {return !isspace(c); });
-        if (itFirstChar == line.end() || *itFirstChar == '#')
-            continue;
-
-        auto delimPos = line.find("->");
-        if (delimPos == string::npos || delimPos == 0) {
-            cerr << "Error: Malformed line " << lineCount << " in file "
-                << configFile << endl;
-            return false;
-        }
-
-        // Read the symbol on the left-hand side of the production (always nonterminal)
-        string lhsSymbol = line.substr(0, delimPos);
-        auto lineEnd = remove_if(lhsSymbol.begin(), lhsSymbol.end(), isspace);
-        lhsSymbol.erase(lineEnd, lhsSymbol.end());
-
-        // The first production by default contains the start symbol
-        if (nonterminals.size() == 0)
-            _startSymbol = lhsSymbol;
-        nonterminals.insert(lhsSymbol);
-
-        // Read all the symbols on the right-hand side of the production
-        vector<Symbol> rhsSymbols;
-        regex rhsRegex("[^ \\t\\n]+");
-        for (auto it = sregex_iterator(line.begin() + delimPos + 2, line.end(), rhsRegex);
-            it != sregex_iterator(); ++it) {
-            const auto & match = *it;
-            rhsSymbols.push_back(Symbol{
-                (match.str() == "^e$" ? Symbol::EPSILON : Symbol::TERMINAL),
-                match.str()
-            });
-        }
-
-        if (rhsSymbols.size() == 0) {
-            cerr << "Error: Malformed line " << lineCount << " in file "
-                << configFile << endl;
-            return false;
-        }
-
-        _productions.push_back({ lhsSymbol, rhsSymbols });
+    // Repeated subexpressions are evaluated once, by turning the tree into a
+    // DAG that has a single node for each distinct subtree. There is at most
+    // one node per token, so the table stays at most half full. Short lines
+    // have little to share, and are not worth hashing.
+    _sharedValues.clear();
+    _exactSharedValues.clear();
+    if (numTokens >= MIN_SHARING_TOKENS) {
+        size_t tableSize = 16;
+        while (tableSize < 2 * numTokens)
+            tableSize *= 2;
+        _consTable.assign(tableSize, NULL);
+        astTree = _hashConsASTTree(astTree);
+        _stats.lap(StageStats::SHARE);
     }
 
-    // Go through all productions and mark all the nonterminal symbols
-    for (auto & production : _productions) {
-        for (auto & symbol : production.rhsSymbols) {
-            if (nonterminals.find(symbol.name) != nonterminals.end())
-                symbol.type = Symbol::NONTERMINAL;
-        }
-    }
-
-#ifdef LOG_DEBUG
-    cout << "Productions" << endl;
-    cout << "-----------" << endl;
-    for (const auto & production : _productions) {
-        cout << production.lhsSymbol << " -> ";
-        for (const auto & s : production.rhsSymbols)
-            cout << '(' << s.type << ',' << s.name << ") ";
-        cout << endl;
-    }
-    cout << endl;
-#endif LOG_DEBUG
+    _evalASTTree(astTree, result);
 
-    return true;
+    return result.ok;
 }
 
-bool Parser::_readSemanticsFile(const std::string & configFile) {
-
-    static const int SEMANTICS_UNARY_LEFT_OPERATOR = 0;
-    static const int SEMANTICS_UNUSED_TERMINAL = 1;
 
-    ifstream ifs(configFile);
-    if (ifs.fail()) {
-        cerr << "Error: Failed to open semantics config file " << configFile << endl;
-        return false;
-    }
+bool Parser::prepare(const vector<Token> & tokens, const string & line, PreparedExpression & prepared,
+    Result & result) {
 
-    int lineCount = 0;
-    while (ifs) {
-        string line;
-        getline(ifs, line);
-        lineCount++;
-
-        // Make sure the line is non-empty and non-comment
-        auto itFirstChar = find_if(line.begin(), line.end(), [](char c) {return !isspace(c); });
-        if (itFirstChar == line.end() || *itFirstChar == '#')
-            continue;
+    prepared._clear();
+    prepared._complexSolutions = _complexSolutions;
 
-        // Tokenize the line, split by whitespace
-        regex regex("[^ \\t\\n]+");
-        auto it = sregex_iterator(line.begin(), line.end(), regex);
-        if (it == sregex_iterator())
-            continue;
-
-        const auto & match = *it;
-        switch (atoi(match.str().c_str())) {
-            case SEMANTICS_UNARY_LEFT_OPERATOR:
-                {
-                    vector<int> args;
-                    for (++it; it != sregex_iterator(); ++it) {
-                        const auto & match = *it;
-                        args.push_back(atoi(match.str().c_str()));
-                    }
-                    _unaryOperators[args[0]] = args[1];
-                }
-                break;
+    _astArena.reset();
+    ASTNode * astTree = _buildAST(tokens, line.data(), line.data() + line.size(), _astArena, result);
+    if (!astTree)
+        return false;
 
-            case SEMANTICS_UNUSED_TERMINAL:
-                _unusedTerminals.insert((*(++it)).str());
-                break;
-        }
+    if (!_isEquation(astTree)) {
+        _compileASTNode(astTree, prepared);
+    } else {
+        // Both sides are left on the stack, to be subtracted after the program runs
+        prepared._equation = true;
+        _compileASTNode(astTree->children[0], prepared);
+        _compileASTNode(astTree->children[1], prepared);
     }
 
     return true;
 }
 
-//
-// Computes the set FIRST(A) for each nonterminal symbol A, i.e. the set of
-// terminal symbols that can appear as the first symbol in some sequence
-// derived from A. The special epsilon symbol is denoted by "^e$";
-//
-void Parser::_computeFIRST(const unordered_set<string> & nonterminals,
-    unordered_map<string, unordered_set<string>> & FIRST) {
-
-    for (const auto & nonterminal : nonterminals)
-        FIRST[nonterminal] = unordered_set<string>();
-
-    bool setsChanged = true;
-    while (setsChanged) {
-        setsChanged = false;
-        for (const auto & production : _productions) {
-            unordered_set<string> rhs;
-            for (const auto & symbol : production.rhsSymbols) {
-
-                rhs.erase("^e$");
-                if (symbol.type == Symbol::EPSILON) {
-                    rhs.insert(symbol.name);
-                } else if (symbol.type == Symbol::TERMINAL) {
-                    rhs.insert(symbol.name);
-                    break;
-                } else if (symbol.type == Symbol::NONTERMINAL) {
-                    for (const auto & symbol : FIRST[symbol.name])
-                        rhs.insert(symbol);
-                    if (rhs.find("^e$") == rhs.end())
-                        break;
-                }
-            }
-
-            // FIRST(A) = FIRST(A) U rhs
-            auto & FIRSTSet = FIRST[production.lhsSymbol];
-            for (const auto & symbol : rhs) {
-                if (FIRSTSet.find(symbol) == FIRSTSet.end())
-                    setsChanged = true;
-                FIRSTSet.insert(symbol);
-            }
-        }
-    }
-
-#ifdef LOG_DEBUG
-    cout << "FIRST sets" << endl;
-    cout << "----------" << endl;
-    for (const auto & entry : FIRST) {
-        cout << entry.first << " : ";
-        for (const auto & symbol : entry.second)
-            cout << symbol << " ";
-        cout << endl;
-    }
-    cout << endl;
-#endif LOG_DEBUG
-}
-
-//
-// Computes the set FOLLOW(A) set for each nonterminal symbol A, i.e. the set
-// of terminal symbols that can appear to the immediate right of a sequence
-// derived from A. The special EOF symbol is denoted by "^\0$";
-//
-void Parser::_computeFOLLOW(const unordered_set<string> & nonterminals,
-    const unordered_map<string, unordered_set<string>> & FIRST,
-    unordered_map<string, unordered_set<string>> & FOLLOW) {
-
-    for (const auto & nonterminal : nonterminals)
-        FOLLOW[nonterminal] = unordered_set<string>();
-    FOLLOW[_startSymbol].insert("^\0$");
-
-    bool setsChanged = true;
-    while (setsChanged) {
-        setsChanged = false;
-        for (const auto & production : _productions) {
-            unordered_set<string> trailer = FOLLOW[production.lhsSymbol];
-            for (int i = production.rhsSymbols.size(); i > 0; i--) {
-
-                const auto & symbol = production.rhsSymbols[i - 1];
-                if (symbol.type != Symbol::NONTERMINAL) {
-                    trailer.clear();
-                    trailer.insert(symbol.name);
-                } else {
-                    // FOLLOW(A) = FOLLOW(A) U trailer
-                    auto & FOLLOWSet = FOLLOW[symbol.name];
-                    for (const auto & tsymbol : trailer) {
-                        if (FOLLOWSet.find(tsymbol) == FOLLOWSet.end())
-                            setsChanged = true;
-                        FOLLOWSet.insert(tsymbol);
-                    }
-
-                    const auto & FIRSTSet = FIRST.find(symbol.name)->second;
-                    if (FIRSTSet.find("^e$") != FIRSTSet.end()) {
-                        // trailer = trailer U (FIRST(A) - epsilon)
-                        for (const auto & symbol : FIRSTSet)
-                            trailer.insert(symbol);
-                        trailer.erase("^e$");
-                    } else {
-                        trailer = FIRSTSet;
-                    }
-                }
-            }
-        }
-    }
-
-#ifdef LOG_DEBUG
-    cout << "FOLLOW sets" << endl;
-    cout << "-----------" << endl;
-    for (const auto & entry : FOLLOW) {
-        cout << entry.first << " : ";
-        for (const auto & symbol : entry.second)
-            cout << (symbol != "^\0$" ? symbol : "EOF") << " ";
-        cout << endl;
-    }
-    cout << endl;
-#endif LOG_DEBUG
-}
 
 //
-// Computes the set FIRST+ for each production, defined as:
+// Parses the tokens with the engine of the grammar into the AST, which is
+// built bottom-up on the AST stack: each operand is pushed as soon as it is
+// matched, and each operator replaces its operands by its node once they are
+// complete. Returns the root, or NULL on an error.
 //
-//     FIRST+(A -> b) = FIRST(b)              , if epsilon not in FIRST(b)
-//                      FIRST(b) U FOLLOW(A)  , otherwise
-//
-void Parser::_computeFIRST_PLUS(const unordered_map<string, unordered_set<string>> & FIRST,
-    unordered_map<string, unordered_set<string>> & FOLLOW,
-    vector<unordered_set<string>> & FIRST_PLUS) {
-
-    for (size_t i = 0; i < _productions.size(); i++) {
-        const auto & production = _productions[i];
-        auto & FIRSTPSet = FIRST_PLUS[i];
-
-        // FIRST+(A -> b) = FIRST(b)
-        for (const auto & symbol : production.rhsSymbols) {
-            FIRSTPSet.erase("^e$");
-            if (symbol.type == Symbol::EPSILON) {
-                FIRSTPSet.insert(symbol.name);
-            } else if (symbol.type == Symbol::TERMINAL) {
-                FIRSTPSet.insert(symbol.name);
-                break;
-            } else if (symbol.type == Symbol::NONTERMINAL) {
-                const auto & FIRSTSet = FIRST.find(symbol.name)->second;
-                for (const auto & symbol : FIRSTSet)
-                    FIRSTPSet.insert(symbol);
-                if (FIRSTPSet.find("^e$") == FIRSTPSet.end())
-                    break;
-            }
-        }
-
-        if (FIRSTPSet.find("^e$") != FIRSTPSet.end()) {
-            // FIRST+(A -> b) = FIRST+(A -> b) U FOLLOW(A)
-            for (const auto & symbol : FOLLOW[production.lhsSymbol])
-                FIRSTPSet.insert(symbol);
-        }
+Parser::ASTNode * Parser::_buildAST(const vector<Token> & tokens, const char * begin, const char * end,
+    Arena & arena, Result & result) {
+
+    _line = begin;
+    _lineLength = end - begin;
+
+    _stats.start();
+    _arena = &arena;
+    size_t arenaChunks = arena.numChunks();
+    _astStack.clear();
+    _operatorStack.clear();
+    _numASTNodes = 0;
+
+    bool ok = (_grammar->_engine == Grammar::OPERATOR_PRECEDENCE)
+        ? _parseByPrecedence(tokens, result) : _parseLL1(tokens, result);
+
+    _stats.lap(StageStats::PARSE);
+    _stats.recordASTNodes(_numASTNodes);
+    _stats.recordArenaOverflows(arena.numChunks() - arenaChunks);
+    if (!ok)
+        return NULL;
+
+    // A grammar whose build actions do not match its operators leaves
+    // operands or operators behind
+    if (_astStack.size() != 1 || !_operatorStack.empty()) {
+        result.setError("Invalid parse tree construction");
+        return NULL;
     }
 
 #ifdef LOG_DEBUG
-    cout << "FIRST+ sets" << endl;
-    cout << "-----------" << endl;
-    for (size_t i = 0; i < FIRST_PLUS.size(); i++) {
-        const auto & FIRSTPSet = FIRST_PLUS[i];
-        cout << i << " : ";
-        for (const auto & symbol : FIRSTPSet)
-            cout << (symbol != "^\0$" ? symbol : "EOF") << " ";
-        cout << endl;
-    }
+    cout << endl << "AST Tree" << endl;
+    cout << "--------" << endl;
+    _printASTTree(_astStack[0]);
     cout << endl;
-#endif LOG_DEBUG
-}
+#endif // LOG_DEBUG
 
-void Parser::_constructLL1Table(const vector<unordered_set<string>> & FIRST_PLUS) {
-    for (size_t i = 0; i < _productions.size(); i++) {
-        const auto & lhsSymbol = _productions[i].lhsSymbol;
-        if (_ll1Table.find(lhsSymbol) == _ll1Table.end())
-            _ll1Table[lhsSymbol] = unordered_map<string, int>();
-        for (const auto & symbol : FIRST_PLUS[i])
-            if (symbol != "^e$")
-                _ll1Table[lhsSymbol][symbol] = i;
-    }
-
-#ifdef LOG_DEBUG
-    cout << "LL(1) Table" << endl;
-    cout << "-----------" << endl;
-    for (const auto & nonterminalEntry : _ll1Table) {
-        cout << nonterminalEntry.first << " : ";
-        for (const auto & terminalEntry : nonterminalEntry.second)
-            cout << '(' << (terminalEntry.first != "^\0$" ? terminalEntry.first : "EOF")
-            << ',' << terminalEntry.second << ')';
-        cout << endl;
-    }
-    cout << endl;
-#endif LOG_DEBUG
+    return _astStack[0];
 }
 
 
-Parser::ASTNode * Parser::_parseAndCreateParseTree(vector<Token> & tokens, const string & line) {
-
-    tokens.push_back({ "^\0$", "^\0$" });
-    int nextInputToken = 0;
+//
+// Parses the tokens with the LL(1) table. The build action of a production
+// (see semantics_config.txt) applies its operator once its operands are on
+// the AST stack.
+//
+bool Parser::_parseLL1(const vector<Token> & tokens, Result & result) {
 
-    vector<Symbol> parseStack;
-    parseStack.reserve(tokens.size());
-    parseStack.push_back(Symbol{ Symbol::EOFL, "^\0$" });
-    parseStack.push_back(Symbol{ Symbol::NONTERMINAL, _startSymbol });
+    const Grammar & grammar = *_grammar;
+    size_t nextInputToken = 0;
 
-    _astNodePoolEnd = 0;
-    ASTNode * astTree = _getASTNode();
-    astTree->type = ASTNode::EMPTY;
-    std::stack<ASTNode*> astStack;
-    astStack.push(astTree);
+    auto & parseStack = _parseStack;
+    parseStack.clear();
+    parseStack.push_back(Symbol{ Symbol::EOFL, TOKEN_EOF });
+    parseStack.push_back(Symbol{ Symbol::NONTERMINAL, grammar._startSymbol });
 
-    size_t linePos = 0;
+    const size_t numTerminals = grammar._terminals.size();
     while (true) {
 
+        // Past the last token, the input continues with an implicit end of input
+        bool atEOF = (nextInputToken == tokens.size());
+        int nextKind = atEOF ? TOKEN_EOF : tokens[nextInputToken].kind;
+        size_t linePos = atEOF ? _lineLength : tokens[nextInputToken].offset;
+
 #ifdef LOG_DEBUG
         cout << "Parse stack: ";
         for (size_t i = parseStack.size(); i > 0; i--)
-            cout << '(' << parseStack[i - 1].type << ','
-            << (parseStack[i - 1].name != "^\0$" ? parseStack[i - 1].name : "EOF") << ") ";
-        cout << "    Next token: " << '(' << tokens[nextInputToken].type << ','
-            << (tokens[nextInputToken].value != "^\0$" ? tokens[nextInputToken].value : "EOF")
-            << ") " << endl;
-#endif LOG_DEBUG
+            cout << '(' << parseStack[i - 1].type << ',' << grammar._symbolName(parseStack[i - 1]) << ") ";
+        cout << "    Next token: " << '(' << grammar._terminals[nextKind] << ','
+            << (atEOF ? "" : string(_line + linePos, tokens[nextInputToken].length)) << ") " << endl;
+#endif // LOG_DEBUG
 
         Symbol stackTop = parseStack.back();
         if (stackTop.type == Symbol::EPSILON) {
             parseStack.pop_back();
 
+        } else if (stackTop.type == Symbol::ACTION) {
+            parseStack.pop_back();
+            if (!_applyBuildAction(stackTop.id)) {
+                result.setError("Invalid parse tree construction");
+                return false;
+            }
+
         } else if (stackTop.type == Symbol::EOFL) {
-            if (tokens[nextInputToken].value == "^\0$") {
+            if (nextKind == TOKEN_EOF) {
                 break;
             } else {
-                cerr << line << endl;
-                for (size_t i = 0; i < linePos; i++)  cerr << ' ';
-                cerr << '|' << endl << "Error: Wrong syntax" << endl << endl;
-                return NULL;
+                result.setError("Wrong syntax", linePos);
+                return false;
             }
 
         } else if (stackTop.type == Symbol::TERMINAL) {
-            if (stackTop.name == tokens[nextInputToken].type) {
+            if (stackTop.id == nextKind) {
                 parseStack.pop_back();
-                linePos += tokens[nextInputToken].value.size();
 
-                if (_unusedTerminals.find(stackTop.name) == _unusedTerminals.end()) {
-                    auto * astStackTop = astStack.top();
-                    astStackTop->token = &tokens[nextInputToken];
-                    astStack.pop();
+                const Token * token = &tokens[nextInputToken];
+                if (grammar._operatorTerminals[stackTop.id]) {
+                    _operatorStack.push_back(token);
+                } else if (!grammar._unusedTerminals[stackTop.id]) {
+                    _pushOperand(token);
                 }
                 nextInputToken++;
             } else {
-                cerr << line << endl;
-                for (size_t i = 0; i < linePos; i++)  cerr << ' ';
-                cerr << '|' << endl << "Error: Wrong syntax" << endl << endl;
-                return NULL;
+                result.setError("Wrong syntax", linePos);
+                return false;
             }
 
         } else {   // Top of stack is nonterminal
-            auto it = _ll1Table[stackTop.name].find(tokens[nextInputToken].type);
-            if (it == _ll1Table[stackTop.name].end()) {
-                cerr << line << endl;
-                for (size_t i = 0; i < linePos; i++)  cerr << ' ';
-                cerr << '|' << endl << "Error: Wrong syntax" << endl << endl;
-                return NULL;
+            int productionIndex = grammar._ll1Table[stackTop.id * numTerminals + nextKind];
+            if (productionIndex == -1) {
+                result.setError("Wrong syntax", linePos);
+                return false;
             } else {
+                // Push the right-hand side in reverse, with the build action
+                // right after the symbol it follows
                 parseStack.pop_back();
-                const auto & production = _productions[it->second];
-                for (int i = production.rhsSymbols.size(); i > 0; i--)
-                    parseStack.push_back(production.rhsSymbols[i - 1]);
-
-                // Parse tree construction
-                auto astStackTop = astStack.top();
-                astStack.pop();
-                for (size_t i = 0; i < production.rhsSymbols.size(); i++) {
-                    const auto & symbol = production.rhsSymbols[i];
-                    if (symbol.type == Symbol::EPSILON)
-                        continue;
-                    else if (symbol.type == Symbol::NONTERMINAL) {
-                        ASTNode * newAstNode = _getASTNode();
-                        newAstNode->type = ASTNode::EMPTY;
-                        astStackTop->children.push_back(newAstNode);
-                    } else if (symbol.type == Symbol::TERMINAL) {
-                        if (_unusedTerminals.find(symbol.name) != _unusedTerminals.end())
-                            continue;
-
-                        ASTNode * newAstNode = _getASTNode();
-                        if (_unaryOperators.find(it->second) != _unaryOperators.end()
-                            && _unaryOperators[it->second] == i) {
-                            newAstNode->type = ASTNode::UNARY_LEFT_OPERATOR;
-                        } else if (_binaryOperators.find(symbol.name) != _binaryOperators.end()) {
-                            newAstNode->type = ASTNode::BINARY_OPERATOR;
-                        } else {
-                            newAstNode->type = ASTNode::OPERAND;
-                        }
-                        astStackTop->children.push_back(newAstNode);
-                    }
+                const auto & rhsSymbols = grammar._productions[productionIndex].rhsSymbols;
+                int action = grammar._buildActions[productionIndex];
+                for (size_t i = rhsSymbols.size(); i > 0; i--) {
+                    if ((int)i - 1 == action)
+                        parseStack.push_back(Symbol{ Symbol::ACTION, productionIndex });
+                    parseStack.push_back(rhsSymbols[i - 1]);
                 }
-
-                for (int i = astStackTop->children.size(); i > 0; i--)
-                    astStack.push(astStackTop->children[i - 1]);
             }
         }
     }
 
-#ifdef LOG_DEBUG
-    cout << endl;
-#endif LOG_DEBUG
-
-    return astTree;
+    return true;
 }
 
 
-Parser::ASTNode * Parser::_convertParseTreeToAST(ASTNode * astTree) {
-
-#ifdef LOG_DEBUG
-    cout << "AST Tree" << endl;
-    cout << "--------" << endl;
-    _printASTTree(astTree, 0);
-    cout << endl;
-#endif LOG_DEBUG
-
-    // Prune the initial parse tree
-    _pruneParseTree(astTree);
-    if (astTree->children.size() == 1)
-        astTree = astTree->children[0];
-    astTree->parent = NULL;
-
-    // Basic step. Move up the operators in the tree until their children match
-    // the number of their operands, in the right order (for example, a unary
-    // left operator will move up the tree until its parent has a right child)
-    _moveUpOperators(astTree);
+//
+// Parses the tokens with the operator precedence table of the grammar, with
+// no symbol stack: the operators are recognized by the table alone.
+//
+bool Parser::_parseByPrecedence(const vector<Token> & tokens, Result & result) {
 
-    // Another final pruning is necessary
-    _pruneParseTree(astTree);
-    if (astTree->children.size() == 1)
-        astTree = astTree->children[0];
-    astTree->parent = NULL;
+    _tokens = &tokens;
+    _nextToken = 0;
+    if (!_parseExpression(result))
+        return false;
 
-#ifdef LOG_DEBUG
-    cout << "AST Tree" << endl;
-    cout << "--------" << endl;
-    _printASTTree(astTree, 0);
-    cout << endl;
-#endif LOG_DEBUG
+    // Anything left over cannot follow the expression
+    if (_nextToken != tokens.size())
+        return _syntaxError(result);
 
-    return astTree;
+    return true;
 }
 
 
-void Parser::_pruneParseTree(ASTNode * root) {
-    root->parent = NULL;
-
-    if (root->children.size() == 0)
-        return;
-
-    // Recursively prune the children first
-    for (auto * child : root->children)
-        _pruneParseTree(child);
-
-    // Delete the epsilon and all the unnecessary terminals, and all the
-    // nonterminals with no children
-    auto it = remove_if(root->children.begin(), root->children.end(),
-        [](const auto * node) {
-        const auto * token = node->token;
-        if ((node->type != ASTNode::EMPTY && token->type == "(")//TODO
-            || (node->type != ASTNode::EMPTY && token->type == ")"))
-            return true;
-
-        return (node->type == ASTNode::EMPTY && node->children.size() == 0);
-    });
-    root->children.erase(it, root->children.end());
+//
+// Parses an operand, then every infix operator of at least the minimum
+// precedence together with its right operand, which is parsed in turn for the
+// operators that bind tighter, and so are the operands of prefix operators
+// and groups. Each subexpression in progress is a frame on the precedence
+// stack rather than a recursive call, so that the nesting depth is only
+// bounded by memory. The node of the expression is left on the AST stack.
+//
+bool Parser::_parseExpression(Result & result) {
 
-    // Collapse node with only one child
-    for (size_t i = 0; i < root->children.size(); i++) {
-        auto * child = root->children[i];
-        if (child->children.size() == 1 && child->type == ASTNode::EMPTY)
-            root->children[i] = child->children[0];
-    }
+    const Grammar & grammar = *_grammar;
+    const vector<Token> & tokens = *_tokens;
+    _precedenceStack.clear();
+    _precedenceStack.push_back({ PrecedenceFrame::TOP, 0, INT_MAX, -1, INT_MAX });
 
-    // Set the parent pointer at each child
-    for (auto * child : root->children)
-        child->parent = root;
-}
+    while (true) {
+        // Operand of the subexpression on top: prefix operators and groups
+        // start a subexpression of their own
+        if (_nextToken == tokens.size())
+            return _syntaxError(result);
+
+        const Token * token = &tokens[_nextToken];
+        int kind = token->kind;
+        if (grammar._prefixPrecedence[kind] > _precedenceStack.back().minPrecedence) {
+            _operatorStack.push_back(token);
+            _nextToken++;
+            _precedenceStack.push_back({ PrecedenceFrame::PREFIX, grammar._prefixPrecedence[kind], INT_MAX, -1,
+                INT_MAX });
+            continue;
 
+        } else if (grammar._groupClosers[kind] != -1) {
+            _nextToken++;
+            _precedenceStack.push_back({ PrecedenceFrame::GROUP, grammar._groupPrecedence[kind], INT_MAX,
+                grammar._groupClosers[kind], INT_MAX });
+            continue;
 
-void Parser::_evalASTTree(ASTNode * astTree) {
+        } else if (kind != TOKEN_EOF && !grammar._operatorTerminals[kind] && !grammar._unusedTerminals[kind]) {
+            _pushOperand(token);
+            _nextToken++;
 
-    if (astTree->token->type != "=") {
-        // Compute the expression recursively using the AST tree
-        vector<Monomial> result;
-        try { 
-            result = _evalASTNode(astTree);
-        } catch (const _EvalException & e) {
-            cerr << "Error: " << e.what() << endl;
-            return;
+        } else {
+            return _syntaxError(result);
         }
 
-        // Print the result, formatted
-        string delimiter = "";
-        cout << "ans = ";
-        if (result.size() != 0) {
-            if (result[0].coefficient != 1 || result[0].exponent == 0)
-                cout << result[0].coefficient;
-            cout << (result[0].exponent != 0 ? "x" : "");
-            if (result[0].exponent != 0 && result[0].exponent != 1)
-                cout << "^" << result[0].exponent;
-            for (size_t i = 1; i < result.size(); i++) {
-                const auto & term = result[i];
-                cout << (term.coefficient > 0 ? " + " : " - ");
-                if (abs(term.coefficient) != 1 || abs(term.exponent) == 0)
-                    cout << abs(term.coefficient);
-                cout << (term.exponent != 0 ? "x" : "");
-                if (term.exponent != 0 && term.exponent != 1)
-                    cout << "^" << term.exponent;
+        // The next infix operator either starts the right operand of the
+        // subexpression on top, or ends it
+        while (true) {
+            PrecedenceFrame & frame = _precedenceStack.back();
+            if (_nextToken < tokens.size()) {
+                token = &tokens[_nextToken];
+                int precedence = grammar._infixPrecedence[token->kind];
+                if (precedence != 0 && precedence >= frame.minPrecedence && precedence <= frame.maxPrecedence) {
+                    _operatorStack.push_back(token);
+                    _nextToken++;
+
+                    // A non-associative operator ends the chain of operators
+                    // of its precedence
+                    int associativity = grammar._infixAssociativity[token->kind];
+                    _precedenceStack.push_back({ PrecedenceFrame::INFIX,
+                        associativity == Grammar::RIGHT ? precedence : precedence + 1, INT_MAX, -1,
+                        associativity == Grammar::NONASSOCIATIVE ? precedence - 1 : INT_MAX });
+                    break;
+                }
             }
-        } else {
-            cout << 0;
-        }
-        cout << endl;
-
-    } else {   // astTree->token->type == "="
-             // We have an equation. Compute the expression on each side recursively as above, and then
-             // subtract the right-hand side from the left-hand side
-        vector<Monomial>  lhs, rhs;
-        try {
-            lhs = _evalASTNode(astTree->children[0]);
-            rhs = _evalASTNode(astTree->children[1]);
-        }
-        catch (const _EvalException & e) {
-            cerr << "Error: " << e.what() << endl;
-            return;
-        }
-        _subtractPolynomial(lhs, rhs);
 
-        if (lhs.size() > 0 && lhs[0].exponent > 2) {
-            cout << "Error: Equations of degree > 2 are not supported" << endl;
-            return;
+            PrecedenceFrame done = frame;
+            _precedenceStack.pop_back();
+            switch (done.continuation) {
+                case PrecedenceFrame::TOP:
+                    return true;
+                case PrecedenceFrame::PREFIX:
+                    _applyOperator(ASTNode::UNARY_LEFT_OPERATOR);
+                    break;
+                case PrecedenceFrame::GROUP:
+                    if (_nextToken == tokens.size() || tokens[_nextToken].kind != done.closer)
+                        return _syntaxError(result);
+                    _nextToken++;
+                    break;
+                case PrecedenceFrame::INFIX:
+                    _applyOperator(ASTNode::BINARY_OPERATOR);
+                    _precedenceStack.back().maxPrecedence =
+                        min(_precedenceStack.back().maxPrecedence, done.parentMaxPrecedence);
+                    break;
+            }
         }
+    }
+}
 
-        if (lhs.size() == 0) {
-            cout << "Infinitely many solutions" << endl;
-            return;
-        }
 
-        int degree = lhs[0].exponent;
-        double a[3] = { lhs[0].coefficient, 0, 0 };   // The coefficients of the equation
-        for (size_t i = 1; i < lhs.size(); i++)
-            a[degree - lhs[i].exponent] = lhs[i].coefficient;
-
-        switch (degree) {
-            case 0:
-                // Trivial equation of scalars (no polynomials)
-                if (a[0] != 0)
-                    cout << "No solutions" << endl;
-                else
-                    cout << "Infinitely many solutions" << endl;
-                break;
+bool Parser::_syntaxError(Result & result) const {
+    result.setError("Wrong syntax", (_nextToken < _tokens->size()) ? (*_tokens)[_nextToken].offset : _lineLength);
+    return false;
+}
 
-            case 1:
-                // Linear equation
-                cout << "x = " << -a[1] / a[0] << endl;
-                break;
 
-            case 2:
-                // Quadratic equation
-                double D = (a[1] * a[1] - 4 * a[0] * a[2]);
-                if (D > 0)
-                    cout << "x = " << ((-a[1] + sqrt(D)) / (2 * a[0]))
-                    << " or x = " << ((-a[1] - sqrt(D)) / (2 * a[0])) << endl;
-                else if (D == 0)
-                    cout << "x = " << -a[1] / (2 * a[0]) << endl;
-                else
-                    cout << "No solutions" << endl;
-                break;
-        }
+//
+// Pushes the node of an operand token. Numbers are folded right away, into
+// constants, except in exact mode.
+//
+void Parser::_pushOperand(const Token * token) {
+    ASTNode * node = _getASTNode();
+    char first = _line[token->offset];
+    if (first == 'x' || first == '$' || _exact) {
+        node->token = token;
+    } else {
+        node->type = ASTNode::CONSTANT;
+        node->value = _tokenNumber(*token);
     }
+    _astStack.push_back(node);
 }
 
 
-bool Parser::_moveUpOperators(ASTNode * root) {
-    for (auto * child : root->children)
-        if (!_moveUpOperators(child))
-            return false;
-
-    bool hasLeft = root->children.size() >= 1;
-    bool hasRight = root->children.size() >= 2;
-
-    ASTNode * current = root;
-    while ( (current->type == ASTNode::BINARY_OPERATOR && (!hasLeft || !hasRight))
-        || (current->type == ASTNode::UNARY_LEFT_OPERATOR && !hasRight) ) {
-        ASTNode * parent = current->parent;
-        if (parent == NULL) {
-            cerr << "Error: Invalid parse tree construction" << endl;
-            return false;
-        }
+bool Parser::_applyBuildAction(int productionIndex) {
+    return _applyOperator((_grammar->_unaryOperators[productionIndex] != -1)
+        ? ASTNode::UNARY_LEFT_OPERATOR : ASTNode::BINARY_OPERATOR);
+}
 
-        // Which child of the parent are we?
-        size_t childIndx = 0;
-        for (; childIndx < parent->children.size(); childIndx++) {
-            if (parent->children[childIndx] == current)
-                break;
-        }
 
-        if (childIndx > 0)
-            hasLeft = true;
-        if (childIndx < parent->children.size() - 1)
-            hasRight = true;
+//
+// Replaces the operands on top of the AST stack by the node of the operator
+// on top of the operator stack. Operators on constants are folded into a
+// constant.
+//
+bool Parser::_applyOperator(ASTNode::ASTNodeType type) {
+    size_t numOperands = (type == ASTNode::UNARY_LEFT_OPERATOR) ? 1 : 2;
+    if (_astStack.size() < numOperands || _operatorStack.empty())
+        return false;
 
-        swap(current->type, parent->type);
-        swap(current->token, parent->token);
-        current = current->parent;
+    const Token * op = _operatorStack.back();
+    _operatorStack.pop_back();
+    ASTNode ** operands = &_astStack[_astStack.size() - numOperands];
+
+    double value;
+    if (operands[0]->type == ASTNode::CONSTANT && operands[numOperands - 1]->type == ASTNode::CONSTANT
+        && _foldConstants(_line[op->offset], type, operands[0]->value, operands[numOperands - 1]->value, value)) {
+        // The first operand node is reused for the result
+        operands[0]->value = value;
+        _astStack.resize(_astStack.size() - numOperands + 1);
+        return true;
     }
 
+    ASTNode * node = _getASTNode();
+    node->type = type;
+    node->token = op;
+    node->children.items = _arena->allocateArray<ASTNode *>(numOperands);
+    node->children.count = numOperands;
+    copy(operands, operands + numOperands, node->children.items);
+
+    _astStack.resize(_astStack.size() - numOperands);
+    _astStack.push_back(node);
     return true;
 }
 
 
 //
-// Dumps the AST tree in preorder traversal
+// Applies an operator to constants, rounding exactly as the polynomial
+// operations of _expandASTNode do, so that folding never changes a result.
+// Returns false for an operator that is left to the evaluation, such as a
+// division by 0 or an equation.
 //
-void Parser::_printASTTree(ASTNode * node, int depth) {
-    for (int i = 0; i < depth; i++) cout << ' ';
-    cout << '(' << node->type;
-    if (node->type != ASTNode::EMPTY && node->token)
-        cout << ',' << node->token->type << ',' << node->token->value;
-    cout << ")" << endl;
-    for (const auto child : node->children)
-        _printASTTree(child, depth + 2);
+bool Parser::_foldConstants(char op, ASTNode::ASTNodeType type, double lhs, double rhs, double & value) const {
+    // Polynomials drop zero coefficients, so a zero factor gives 0 even
+    // with an infinite or NaN operand
+    switch (op) {
+        case '+':
+            value = lhs + rhs;
+            return true;
+        case '-':
+            if (type == ASTNode::BINARY_OPERATOR)
+                value = lhs - rhs;
+            else
+                value = (lhs == 0) ? 0 : -lhs;
+            return true;
+        case '*':
+            value = (lhs == 0 || rhs == 0) ? 0 : lhs * rhs;
+            return true;
+        case '/':
+            // Semantics::divide scales by the reciprocal
+            if (rhs == 0)
+                return false;
+            value = (lhs == 0 || 1 / rhs == 0) ? 0 : lhs * (1 / rhs);
+            return true;
+        case '^':
+            if (!Semantics::hasRealPower(lhs, rhs))
+                return false;
+            value = pow(lhs, rhs);
+            if (value == 0)
+                value = 0;
+            return true;
+    }
+    return false;
 }
 
 
+//
+// Replaces every subtree by the first structurally identical subtree met in
+// post-order, and returns the replacement of the root. Two nodes are
+// identical if they have the same type and token text, and their children are
+// the same nodes once replaced, or identical leaves. The replacements of the
+// children of a node are on top of the AST stack when the node is visited.
+//
+Parser::ASTNode * Parser::_hashConsASTTree(ASTNode * root) {
+    _traversalStack.clear();
+    _astStack.clear();
+    _traversalStack.push_back({ root, false });
+    while (!_traversalStack.empty()) {
+        TraversalFrame & frame = _traversalStack.back();
+        ASTNode * node = frame.node;
+        if (!frame.childrenDone && node->children.size() != 0) {
+            frame.childrenDone = true;
+            for (size_t i = node->children.size(); i > 0; i--)
+                _traversalStack.push_back({ node->children[i - 1], false });
+            continue;
+        }
 
-vector<Parser::Monomial> Parser::_evalASTNode(ASTNode * node) {
-    const auto & children = node->children;
-    if (children.size() == 0) {
-        if (node->token->value[0] == 'x')
-            return vector<Monomial> { { 1, 1 } };
-        else
-            return vector<Monomial> { { (double)atof(node->token->value.c_str()), 0 } };
+        _traversalStack.pop_back();
+        _astStack.push_back(_hashConsASTNode(node));
     }
+    return _astStack.back();
+}
 
-    switch (node->token->value[0]) {
-        case '+':
-            {
-                auto lhs = _evalASTNode(children[0]);
-                return _addPolynomial(lhs, _evalASTNode(children[1]));
-            }
-        case '-':
-            if (node->type == ASTNode::BINARY_OPERATOR) {
-                auto lhs = _evalASTNode(children[0]);
-                return _subtractPolynomial(lhs, _evalASTNode(children[1]));
-            } else if (node->type == ASTNode::UNARY_LEFT_OPERATOR) {
-                vector<Monomial> zero = vector<Monomial>{ { 0, 0 } };
-                return _subtractPolynomial(zero, _evalASTNode(children[0]));
-            }
-        case '*':
-            return _multiplyPolynomials(_evalASTNode(children[0]), _evalASTNode(children[1]));
-        case '/':
-            return _dividePolynomials(_evalASTNode(children[0]), _evalASTNode(children[1]));
-    }
 
-    return vector<Monomial>();
+// Replaces the children of the node by theirs, and returns its replacement
+Parser::ASTNode * Parser::_hashConsASTNode(ASTNode * node) {
+    // FNV-1a over the token text, then the hashes of the children
+    uint64_t hash = 14695981039346656037ULL ^ (uint64_t)node->type;
+    if (node->type == ASTNode::CONSTANT) {
+        const unsigned char * bytes = (const unsigned char *)&node->value;
+        for (size_t i = 0; i < sizeof(node->value); i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    } else if (node->token) {
+        for (size_t i = 0; i < node->token->length; i++)
+            hash = (hash ^ (unsigned char)_line[node->token->offset + i]) * 1099511628211ULL;
+    }
+    size_t firstChild = _astStack.size() - node->children.size();
+    for (size_t i = 0; i < node->children.size(); i++) {
+        ASTNode * child = node->children[i] = _astStack[firstChild + i];
+        hash = (hash ^ child->hash) * 1099511628211ULL;
+    }
+    _astStack.resize(firstChild);
+    node->hash = hash;
+
+    // Sharing a leaf saves nothing, so leaves stay out of the table and are
+    // compared by text instead
+    if (node->children.size() == 0)
+        return node;
+
+    size_t mask = _consTable.size() - 1;
+    for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask) {
+        ASTNode * entry = _consTable[i];
+        if (entry == NULL) {
+            _consTable[i] = node;
+            node->uses = 1;
+            return node;
+        }
+        if (entry->hash == hash && _sameASTNode(entry, node)) {
+            entry->uses++;
+            return entry;
+        }
+    }
 }
 
 
-vector<Parser::Monomial> & Parser::_addPolynomial(vector<Monomial> & lhs, const vector<Monomial> & rhs) {
-    for (const auto & term : rhs)
-        lhs.push_back(term);
+bool Parser::_sameASTNode(const ASTNode * lhs, const ASTNode * rhs) const {
+    if (lhs->type != rhs->type || lhs->children.size() != rhs->children.size()
+        || (lhs->token == NULL) != (rhs->token == NULL))
+        return false;
 
-    sort(lhs.begin(), lhs.end(), [](const Monomial & a, const Monomial & b) {
-        return a.exponent > b.exponent;
-    });
+    if (lhs->type == ASTNode::CONSTANT)
+        return memcmp(&lhs->value, &rhs->value, sizeof(lhs->value)) == 0;
 
-    for (size_t i = 0; i < lhs.size();) {
-        size_t j;
-        for (j = i + 1; j < lhs.size() && lhs[j].exponent == lhs[i].exponent; j++)
-            lhs[i].coefficient += lhs[j].coefficient;
-        i = j;
+    if (lhs->token && (lhs->token->length != rhs->token->length
+        || memcmp(_line + lhs->token->offset, _line + rhs->token->offset, lhs->token->length) != 0))
+        return false;
+
+    // The children were replaced first, so identical children are the same
+    // node, except for leaves
+    for (size_t i = 0; i < lhs->children.size(); i++) {
+        const ASTNode * lhsChild = lhs->children[i];
+        const ASTNode * rhsChild = rhs->children[i];
+        if (lhsChild != rhsChild && (lhsChild->children.size() != 0 || lhsChild->hash != rhsChild->hash
+            || !_sameASTNode(lhsChild, rhsChild)))
+            return false;
     }
+    return true;
+}
 
-    auto it = unique(lhs.begin(), lhs.end(), [](const Monomial & terml, const Monomial & termr) {
-        return terml.exponent == termr.exponent;
-    });
-    it = remove_if(lhs.begin(), it, [](const Monomial & term) { return term.coefficient == 0; });
-    lhs.erase(it, lhs.end());
 
-    return lhs;
+void Parser::_evalASTTree(ASTNode * astTree, Result & result) {
+    if (_exact)
+        _evalASTTree(astTree, result, _exactValueStack, _exactSharedValues);
+    else
+        _evalASTTree(astTree, result, _valueStack, _sharedValues);
 }
 
 
-vector<Parser::Monomial> & Parser::_subtractPolynomial(vector<Monomial> & lhs, const vector<Monomial> & rhs) {
+// Evaluates the tree with values of type Polynomial or RationalPolynomial
+template <typename Value>
+void Parser::_evalASTTree(ASTNode * astTree, Result & result, vector<Value> & valueStack,
+    vector<Value> & sharedValues) {
+
+    StageStats::Stage stage = StageStats::EVALUATE;
+    try {
+        if (!_isEquation(astTree)) {
+            // Compute the expression recursively using the AST tree
+            Semantics::setValue(_evalASTNode(astTree, valueStack, sharedValues), result);
+        } else {   // The root token is "="
+            // We have an equation. Compute the expression on each side recursively as above, and then
+            // subtract the right-hand side from the left-hand side
+            Value lhs = _evalASTNode(astTree->children[0], valueStack, sharedValues);
+            lhs.subtract(_evalASTNode(astTree->children[1], valueStack, sharedValues));
+            _stats.lap(stage);
+            stage = StageStats::SOLVE;
+            Semantics::setSolutions(lhs, result, _complexSolutions);
+        }
+    } catch (const Semantics::EvalError & e) {
+        result.setError(e.what());
+    }
+    _stats.lap(stage);
+}
+
 
-    for (const auto & term : rhs) {
-        Monomial invTerm = term;
-        invTerm.coefficient *= -1;
-        lhs.push_back(invTerm);
+//
+// Dumps the AST tree in preorder traversal, indenting each node by its depth
+//
+void Parser::_printASTTree(ASTNode * root) {
+    vector<pair<ASTNode *, size_t>> stack = { { root, 0 } };
+    while (!stack.empty()) {
+        ASTNode * node = stack.back().first;
+        size_t depth = stack.back().second;
+        stack.pop_back();
+
+        cout << string(depth, ' ') << '(' << node->type;
+        if (node->type == ASTNode::CONSTANT)
+            cout << ',' << node->value;
+        else
+            cout << ',' << _grammar->_terminals[node->token->kind] << ','
+                << string(_line + node->token->offset, node->token->length);
+        cout << ")" << endl;
+        for (size_t i = node->children.size(); i > 0; i--)
+            stack.push_back({ node->children[i - 1], depth + 2 });
     }
+}
 
-    sort(lhs.begin(), lhs.end(), [](const Monomial & a, const Monomial & b) {
-        return a.exponent > b.exponent;
-    });
 
-    for (size_t i = 0; i < lhs.size();) {
-        size_t j;
-        for (j = i + 1; j < lhs.size() && lhs[j].exponent == lhs[i].exponent; j++)
-            lhs[i].coefficient += lhs[j].coefficient;
-        i = j;
+
+//
+// Evaluates the subtree in post-order, leaving the value of each node on the
+// value stack in place of those of its operands, from the first one to the
+// last. A shared subtree is expanded at its first use, and copied at the
+// others.
+//
+template <typename Value>
+Value Parser::_evalASTNode(ASTNode * root, vector<Value> & valueStack, vector<Value> & sharedValues) {
+    _traversalStack.clear();
+    valueStack.clear();
+    _traversalStack.push_back({ root, false });
+    while (!_traversalStack.empty()) {
+        TraversalFrame & frame = _traversalStack.back();
+        ASTNode * node = frame.node;
+        if (!frame.childrenDone) {
+            if (node->sharedValue >= 0) {
+                _traversalStack.pop_back();
+                _stats.recordSkippedEvaluation();
+                valueStack.push_back(sharedValues[node->sharedValue]);
+                continue;
+            }
+            if (node->children.size() != 0) {
+                frame.childrenDone = true;
+                for (size_t i = node->children.size(); i > 0; i--)
+                    _traversalStack.push_back({ node->children[i - 1], false });
+                continue;
+            }
+            valueStack.emplace_back();
+            _evalLeaf(node, valueStack.back());
+        } else {
+            _evalOperator(node, valueStack);
+        }
+        _traversalStack.pop_back();
+
+        const Value & value = valueStack.back();
+        _stats.recordPolynomialSize(value.size());
+        if (node->uses > 1) {
+            node->sharedValue = (int)sharedValues.size();
+            sharedValues.push_back(value);
+        }
     }
+    return move(valueStack.back());
+}
 
-    auto it = unique(lhs.begin(), lhs.end(), [](const Monomial & terml, const Monomial & termr) {
-        return terml.exponent == termr.exponent;
-    });
-    it = remove_if(lhs.begin(), it, [](const Monomial & term) { return term.coefficient == 0; });
-    lhs.erase(it, lhs.end());
 
-    return lhs;
+void Parser::_evalLeaf(const ASTNode * node, Polynomial & value) const {
+    if (node->type == ASTNode::CONSTANT)
+        value = Polynomial::constant(node->value);
+    else if (_line[node->token->offset] == 'x')
+        value = Polynomial::monomial(1, 1);
+    else if (_line[node->token->offset] == '$')
+        // Placeholders only have a value in a prepared expression
+        throw Semantics::EvalError("Unbound placeholder "
+            + string(_line + node->token->offset, node->token->length));
+    else
+        value = Polynomial::constant(_tokenNumber(*node->token));
 }
 
 
-vector<Parser::Monomial> Parser::_multiplyPolynomials(const vector<Monomial> & lhs, const vector<Monomial> & rhs) {
-    vector<Monomial> result;
-    vector<Monomial> temp;
-    for (const auto & termr : rhs) {
-        temp.clear();
-        temp = lhs;
-        for (auto & terml : temp) {
-            terml.coefficient *= termr.coefficient;
-            terml.exponent += termr.exponent;
-        }
+// In exact mode, numbers are parsed from their digits
+void Parser::_evalLeaf(const ASTNode * node, RationalPolynomial & value) const {
+    Rational number;
+    if (node->type == ASTNode::CONSTANT)
+        // Only from a tree parsed before exact mode was set
+        throw Semantics::EvalError("Constants are folded in doubles");
+    else if (_line[node->token->offset] == 'x')
+        value = RationalPolynomial::monomial(1, 1);
+    else if (_line[node->token->offset] == '$')
+        throw Semantics::EvalError("Unbound placeholder "
+            + string(_line + node->token->offset, node->token->length));
+    else if (Rational::parse(_line + node->token->offset, node->token->length, number))
+        value = RationalPolynomial::constant(number);
+    else
+        throw Semantics::EvalError("Invalid number " + string(_line + node->token->offset, node->token->length));
+}
 
-        _addPolynomial(result, temp);
-    }
 
-    return result;
+// Replaces the values of the operands of the node by its value
+template <typename Value>
+void Parser::_evalOperator(const ASTNode * node, vector<Value> & valueStack) {
+    size_t firstOperand = valueStack.size() - node->children.size();
+    Value & lhs = valueStack[firstOperand];
+    const Value & rhs = valueStack.back();
+    switch (_line[node->token->offset]) {
+        case '+':
+            lhs.add(rhs);
+            break;
+        case '-':
+            if (node->type == ASTNode::BINARY_OPERATOR)
+                lhs.subtract(rhs);
+            else
+                lhs.scale(-1);
+            break;
+        case '*':
+            lhs = Semantics::multiply(lhs, rhs);
+            break;
+        case '/':
+            lhs = Semantics::divide(lhs, rhs);
+            break;
+        case '^':
+            lhs = Semantics::power(lhs, rhs);
+            break;
+        default:
+            lhs = Value();
+            break;
+    }
+    valueStack.resize(firstOperand + 1);
 }
 
 
-vector<Parser::Monomial> Parser::_dividePolynomials(const vector<Monomial> & lhs, const vector<Monomial> & rhs) {
-    if (rhs.size() == 0 || (rhs.size() == 1 && rhs[0].coefficient == 0)) {
-        throw _EvalException("Division by 0");
+//
+// Appends the postfix program of the subtree to the prepared expression, by
+// a post-order traversal
+//
+void Parser::_compileASTNode(ASTNode * root, PreparedExpression & prepared) {
+    _traversalStack.clear();
+    _traversalStack.push_back({ root, false });
+    while (!_traversalStack.empty()) {
+        TraversalFrame & frame = _traversalStack.back();
+        ASTNode * node = frame.node;
+        if (!frame.childrenDone && node->children.size() != 0) {
+            frame.childrenDone = true;
+            for (size_t i = node->children.size(); i > 0; i--)
+                _traversalStack.push_back({ node->children[i - 1], false });
+            continue;
+        }
+
+        _traversalStack.pop_back();
+        _compileNode(node, prepared);
     }
+}
 
-    if (rhs.size() != 1 || rhs[0].exponent != 0) {
-        throw _EvalException("Polynomial division is not supported");
+
+// Appends the instruction of the node, whose operands are already compiled
+void Parser::_compileNode(const ASTNode * node, PreparedExpression & prepared) {
+    typedef PreparedExpression::Instruction Instruction;
+
+    const auto & children = node->children;
+    Instruction instruction = { Instruction::CONSTANT, 0, -1 };
+    if (children.size() == 0) {
+        if (node->type == ASTNode::CONSTANT) {
+            instruction.constant = node->value;
+        } else if (_line[node->token->offset] == 'x') {
+            instruction.opcode = Instruction::VARIABLE;
+        } else if (_line[node->token->offset] == '$') {
+            instruction.opcode = Instruction::PARAMETER;
+            instruction.parameter = prepared._addParameter(
+                string(_line + node->token->offset, node->token->length));
+        } else {
+            instruction.constant = _tokenNumber(*node->token);
+        }
+        prepared._program.push_back(instruction);
+        return;
     }
 
-    double divisor = rhs[0].coefficient;
-    vector<Monomial> result = lhs;
-    for (auto & term : result) {
-        term.coefficient /= divisor;
+    switch (_line[node->token->offset]) {
+        case '+':
+            instruction.opcode = Instruction::ADD;
+            break;
+        case '-':
+            instruction.opcode = (node->type == ASTNode::BINARY_OPERATOR)
+                ? Instruction::SUBTRACT : Instruction::NEGATE;
+            break;
+        case '*':
+            instruction.opcode = Instruction::MULTIPLY;
+            break;
+        case '/':
+            instruction.opcode = Instruction::DIVIDE;
+            break;
+        case '^':
+            instruction.opcode = Instruction::POWER;
+            break;
     }
+    prepared._program.push_back(instruction);
+}
+
 
-    return result;
+double Parser::_tokenNumber(const Token & token) const {
+    // The token text is not null-terminated, so it is converted from a copy
+    char buffer[64];
+    if (token.length < sizeof(buffer)) {
+        memcpy(buffer, _line + token.offset, token.length);
+        buffer[token.length] = '\0';
+        return atof(buffer);
+    }
+    return atof(string(_line + token.offset, token.length).c_str());
 }
@@ -0,0 +1,273 @@
+#include "polynomial.h"
+#include "convolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+const int Polynomial::DENSE_MAX_SPARSE_DEGREE;
+const int Polynomial::DENSE_MIN_FILL;
+
+
+Polynomial Polynomial::constant(double coefficient) {
+    return monomial(coefficient, 0);
+}
+
+
+Polynomial Polynomial::monomial(double coefficient, int exponent) {
+    Polynomial result;
+    if (coefficient != 0) {
+        result._terms.push_back({ coefficient, exponent });
+        result._dense = false;
+        result._chooseRepresentation();
+    }
+    return result;
+}
+
+
+Polynomial Polynomial::fromTerms(vector<Term> terms) {
+    Polynomial result;
+    if (!terms.empty()) {
+        result._terms = move(terms);
+        result._dense = false;
+        result._chooseRepresentation();
+    }
+    return result;
+}
+
+
+int Polynomial::degree() const {
+    if (_dense)
+        return (int)_coefficients.size() - 1;
+    return _terms.empty() ? -1 : _terms.back().exponent;
+}
+
+
+double Polynomial::coefficient(int exponent) const {
+    if (_dense)
+        return (exponent >= 0 && exponent < (int)_coefficients.size()) ? _coefficients[exponent] : 0;
+
+    auto it = lower_bound(_terms.begin(), _terms.end(), exponent,
+        [](const Term & term, int exponent) { return term.exponent < exponent; });
+    return (it != _terms.end() && it->exponent == exponent) ? it->coefficient : 0;
+}
+
+
+vector<Polynomial::Term> Polynomial::terms() const {
+    vector<Term> result;
+    if (_dense) {
+        for (size_t i = _coefficients.size(); i > 0; i--)
+            if (_coefficients[i - 1] != 0)
+                result.push_back({ _coefficients[i - 1], (int)i - 1 });
+    } else {
+        result.assign(_terms.rbegin(), _terms.rend());
+    }
+    return result;
+}
+
+
+Polynomial & Polynomial::scale(double factor) {
+    if (factor == 0) {
+        *this = Polynomial();
+        return *this;
+    }
+
+    for (auto & c : _coefficients)
+        c *= factor;
+    for (auto & term : _terms)
+        term.coefficient *= factor;
+
+    // Coefficients can underflow to 0, like the leading one of x/10^200/10^200
+    if (fabs(factor) < 1) {
+        _terms.erase(remove_if(_terms.begin(), _terms.end(), [](const Term & term) {
+            return term.coefficient == 0;
+        }), _terms.end());
+        _trim();
+        _chooseRepresentation();
+    }
+    return *this;
+}
+
+
+Polynomial & Polynomial::_addScaled(const Polynomial & rhs, double factor) {
+    if (rhs.isZero())
+        return *this;
+
+    if (!_dense && !rhs._dense) {
+        // Linear merge of the two sorted term lists
+        vector<Term> merged;
+        merged.reserve(_terms.size() + rhs._terms.size());
+        size_t i = 0, j = 0;
+        while (i < _terms.size() || j < rhs._terms.size()) {
+            if (j == rhs._terms.size() || (i < _terms.size() && _terms[i].exponent < rhs._terms[j].exponent)) {
+                merged.push_back(_terms[i++]);
+            } else if (i == _terms.size() || rhs._terms[j].exponent < _terms[i].exponent) {
+                merged.push_back({ factor * rhs._terms[j].coefficient, rhs._terms[j].exponent });
+                j++;
+            } else {
+                double sum = _terms[i].coefficient + factor * rhs._terms[j].coefficient;
+                if (sum != 0)
+                    merged.push_back({ sum, _terms[i].exponent });
+                i++;
+                j++;
+            }
+        }
+        _terms.swap(merged);
+
+    } else if (_dense && rhs.degree() < (int)max(_coefficients.size(), (size_t)DENSE_MAX_SPARSE_DEGREE)) {
+        // Add into the dense array, which can hold the other operand as well
+        if ((int)_coefficients.size() <= rhs.degree())
+            _coefficients.resize(rhs.degree() + 1, 0);
+
+        if (rhs._dense) {
+            const double * src = rhs._coefficients.data();
+            double * dst = _coefficients.data();
+            size_t n = rhs._coefficients.size();
+            for (size_t k = 0; k < n; k++)
+                dst[k] += factor * src[k];
+        } else {
+            for (const auto & term : rhs._terms)
+                _coefficients[term.exponent] += factor * term.coefficient;
+        }
+        _trim();
+
+    } else if (_dense) {
+        // The other operand is sparse and of much higher degree
+        _toSparse();
+        return _addScaled(rhs, factor);
+
+    } else {
+        // Sparse plus dense: add into a dense copy of the other operand
+        Polynomial result = rhs;
+        result.scale(factor);
+        result._addScaled(*this, 1);
+        *this = move(result);
+    }
+
+    _chooseRepresentation();
+    return *this;
+}
+
+
+Polynomial Polynomial::multiply(const Polynomial & lhs, const Polynomial & rhs) {
+    Polynomial result;
+    if (lhs.isZero() || rhs.isZero())
+        return result;
+
+    if (lhs._dense && rhs._dense) {
+        result._coefficients = Convolution::multiply(lhs._coefficients, rhs._coefficients);
+        result._trim();
+        result._chooseRepresentation();
+        return result;
+    }
+
+    vector<Term> lhsTerms = lhs._dense ? lhs.terms() : lhs._terms;
+    vector<Term> rhsTerms = rhs._dense ? rhs.terms() : rhs._terms;
+    size_t productCount = lhsTerms.size() * rhsTerms.size();
+    int resultDegree = lhs.degree() + rhs.degree();
+
+    if (resultDegree < DENSE_MAX_SPARSE_DEGREE || (size_t)resultDegree < DENSE_MIN_FILL * productCount) {
+        // Accumulate the products into a dense array
+        auto & c = result._coefficients;
+        c.assign(resultDegree + 1, 0);
+        for (const auto & terml : lhsTerms)
+            for (const auto & termr : rhsTerms)
+                c[terml.exponent + termr.exponent] += terml.coefficient * termr.coefficient;
+        result._trim();
+    } else {
+        // Sort all the products by exponent and combine equal exponents
+        auto & terms = result._terms;
+        result._dense = false;
+        terms.reserve(productCount);
+        for (const auto & terml : lhsTerms)
+            for (const auto & termr : rhsTerms)
+                terms.push_back({ terml.coefficient * termr.coefficient, terml.exponent + termr.exponent });
+        sort(terms.begin(), terms.end(), [](const Term & a, const Term & b) {
+            return a.exponent < b.exponent;
+        });
+
+        size_t end = 0;
+        for (size_t i = 0; i < terms.size();) {
+            Term sum = terms[i];
+            for (i++; i < terms.size() && terms[i].exponent == sum.exponent; i++)
+                sum.coefficient += terms[i].coefficient;
+            if (sum.coefficient != 0)
+                terms[end++] = sum;
+        }
+        terms.resize(end);
+    }
+
+    result._chooseRepresentation();
+    return result;
+}
+
+
+Polynomial Polynomial::power(const Polynomial & base, unsigned exponent) {
+    // The square of the base for each bit of the exponent, multiplied into
+    // the result for the bits that are set
+    Polynomial result = constant(1);
+    bool resultIsOne = true;
+    Polynomial square = base;
+    while (true) {
+        if (exponent & 1) {
+            result = resultIsOne ? square : multiply(result, square);
+            resultIsOne = false;
+        }
+        exponent >>= 1;
+        if (exponent == 0)
+            break;
+        square = multiply(square, square);
+    }
+    return result;
+}
+
+
+void Polynomial::_toDense() {
+    if (_dense)
+        return;
+
+    _coefficients.assign(_terms.empty() ? 0 : _terms.back().exponent + 1, 0);
+    for (const auto & term : _terms)
+        _coefficients[term.exponent] = term.coefficient;
+    _terms.clear();
+    _dense = true;
+}
+
+
+void Polynomial::_toSparse() {
+    if (!_dense)
+        return;
+
+    _terms.clear();
+    for (size_t i = 0; i < _coefficients.size(); i++)
+        if (_coefficients[i] != 0)
+            _terms.push_back({ _coefficients[i], (int)i });
+    _coefficients.clear();
+    _dense = false;
+}
+
+
+void Polynomial::_trim() {
+    while (!_coefficients.empty() && _coefficients.back() == 0)
+        _coefficients.pop_back();
+}
+
+
+void Polynomial::_chooseRepresentation() {
+    int deg = degree();
+    if (deg < DENSE_MAX_SPARSE_DEGREE) {
+        _toDense();
+        return;
+    }
+
+    size_t nonzeros = _terms.size();
+    if (_dense)
+        nonzeros = count_if(_coefficients.begin(), _coefficients.end(), [](double c) { return c != 0; });
+
+    if (nonzeros * DENSE_MIN_FILL >= (size_t)deg + 1)
+        _toDense();
+    else
+        _toSparse();
+}
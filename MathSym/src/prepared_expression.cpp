@@ -0,0 +1,215 @@
+#include "prepared_expression.h"
+#include "semantics.h"
+#include "vector_kernels.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+const size_t PreparedExpression::BLOCK_SIZE;
+
+
+int PreparedExpression::parameterIndex(const string & name) const {
+    for (size_t i = 0; i < _parameters.size(); i++)
+        if (_parameters[i] == name || _parameters[i].compare(1, string::npos, name) == 0)
+            return (int)i;
+    return -1;
+}
+
+
+bool PreparedExpression::bind(const string & name, double value) {
+    int index = parameterIndex(name);
+    if (index == -1)
+        return false;
+
+    bind(index, value);
+    return true;
+}
+
+
+const Result & PreparedExpression::evaluate() {
+    _result.clear();
+    if (!_checkBindings())
+        return _result;
+
+    try {
+        if (_equation)
+            Semantics::setSolutions(_expand(), _result, _complexSolutions);
+        else
+            Semantics::setValue(_expand(), _result);
+    } catch (const Semantics::EvalError & e) {
+        _result.setError(e.what());
+    }
+    return _result;
+}
+
+
+const Result & PreparedExpression::evaluateAt(const double * xs, size_t count, double * values,
+    NumericMethod method) {
+    _result.clear();
+    if (!_checkBindings())
+        return _result;
+
+    // The expansion also finds the divisions that have no numeric meaning
+    // at any x, even when the program itself is run below
+    const Polynomial * expanded;
+    try {
+        expanded = &_expand();
+    } catch (const Semantics::EvalError & e) {
+        _result.setError(e.what());
+        return _result;
+    }
+
+    if (method == AUTOMATIC) {
+        // Horner's rule takes a multiply and an add per degree of the
+        // expansion, the program about as much per instruction
+        method = (expanded->isDense() && expanded->degree() <= (int)_program.size()) ? HORNER : PROGRAM;
+    }
+
+    if (method == HORNER) {
+        _coefficients.assign(expanded->degree() + 1, 0);
+        for (const auto & term : expanded->terms())
+            _coefficients[term.exponent] = term.coefficient;
+        VectorKernels::horner(_coefficients.data(), _coefficients.size(), xs, count, values);
+    } else {
+        for (size_t i = 0; i < count; i += BLOCK_SIZE)
+            _runOnBlock(xs + i, min(count - i, BLOCK_SIZE), values + i);
+    }
+    return _result;
+}
+
+
+bool PreparedExpression::_checkBindings() {
+    if (_program.empty()) {
+        _result.setError("No expression is prepared");
+        return false;
+    }
+    for (size_t i = 0; i < _parameters.size(); i++) {
+        if (!_bound[i]) {
+            _result.setError("Unbound placeholder " + _parameters[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//
+// Runs the program on polynomials and returns the value of the expression, or
+// for an equation the left-hand side minus the right-hand side. Throws
+// Semantics::EvalError.
+//
+Polynomial & PreparedExpression::_expand() {
+    // Each operator pops its operands and leaves its result on the stack
+    _stack.clear();
+    for (const auto & instruction : _program) {
+        switch (instruction.opcode) {
+            case Instruction::CONSTANT:
+                _stack.push_back(Polynomial::constant(instruction.constant));
+                break;
+            case Instruction::VARIABLE:
+                _stack.push_back(Polynomial::monomial(1, 1));
+                break;
+            case Instruction::PARAMETER:
+                _stack.push_back(Polynomial::constant(_values[instruction.parameter]));
+                break;
+            case Instruction::NEGATE:
+                _stack.back().scale(-1);
+                break;
+            default: {
+                Polynomial rhs = move(_stack.back());
+                _stack.pop_back();
+                Polynomial & lhs = _stack.back();
+                if (instruction.opcode == Instruction::ADD)
+                    lhs.add(rhs);
+                else if (instruction.opcode == Instruction::SUBTRACT)
+                    lhs.subtract(rhs);
+                else if (instruction.opcode == Instruction::MULTIPLY)
+                    lhs = Semantics::multiply(lhs, rhs);
+                else if (instruction.opcode == Instruction::POWER)
+                    lhs = Semantics::power(lhs, rhs);
+                else
+                    lhs = Semantics::divide(lhs, rhs);
+                break;
+            }
+        }
+    }
+
+    if (_equation)
+        _stack[0].subtract(_stack[1]);
+    return _stack[0];
+}
+
+
+//
+// Runs the program on up to BLOCK_SIZE values of x at once, with one block of
+// doubles per stack level
+//
+void PreparedExpression::_runOnBlock(const double * xs, size_t count, double * values) {
+    size_t depth = 0;
+    auto level = [this](size_t i) -> double * {
+        if (_blocks.size() < (i + 1) * BLOCK_SIZE)
+            _blocks.resize((i + 1) * BLOCK_SIZE);
+        return _blocks.data() + i * BLOCK_SIZE;
+    };
+
+    for (const auto & instruction : _program) {
+        switch (instruction.opcode) {
+            case Instruction::CONSTANT:
+                VectorKernels::fill(instruction.constant, count, level(depth++));
+                break;
+            case Instruction::VARIABLE:
+                copy(xs, xs + count, level(depth++));
+                break;
+            case Instruction::PARAMETER:
+                VectorKernels::fill(_values[instruction.parameter], count, level(depth++));
+                break;
+            case Instruction::NEGATE:
+                VectorKernels::negate(level(depth - 1), count, level(depth - 1));
+                break;
+            default: {
+                double * lhs = level(depth - 2);
+                double * rhs = level(depth - 1);
+                if (instruction.opcode == Instruction::ADD)
+                    VectorKernels::add(lhs, rhs, count, lhs);
+                else if (instruction.opcode == Instruction::SUBTRACT)
+                    VectorKernels::subtract(lhs, rhs, count, lhs);
+                else if (instruction.opcode == Instruction::MULTIPLY)
+                    VectorKernels::multiply(lhs, rhs, count, lhs);
+                else if (instruction.opcode == Instruction::POWER)
+                    VectorKernels::power(lhs, rhs, count, lhs);
+                else
+                    VectorKernels::divide(lhs, rhs, count, lhs);
+                depth--;
+                break;
+            }
+        }
+    }
+
+    if (_equation)
+        VectorKernels::subtract(level(0), level(1), count, values);
+    else
+        copy(level(0), level(0) + count, values);
+}
+
+
+void PreparedExpression::_clear() {
+    _program.clear();
+    _equation = false;
+    _parameters.clear();
+    _values.clear();
+    _bound.clear();
+}
+
+
+int PreparedExpression::_addParameter(const string & name) {
+    for (size_t i = 0; i < _parameters.size(); i++)
+        if (_parameters[i] == name)
+            return (int)i;
+
+    _parameters.push_back(name);
+    _values.push_back(0);
+    _bound.push_back(0);
+    return (int)_parameters.size() - 1;
+}
@@ -0,0 +1,376 @@
+#include "rational.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+
+namespace {
+
+// The checked operations fail on an overflow, and also on a result of
+// INT64_MIN, which is never stored inline
+
+#if defined(__GNUC__) || defined(__clang__)
+
+inline bool checkedAdd(int64_t lhs, int64_t rhs, int64_t & result) {
+    return !__builtin_add_overflow(lhs, rhs, &result) && result != INT64_MIN;
+}
+
+inline bool checkedMultiply(int64_t lhs, int64_t rhs, int64_t & result) {
+    return !__builtin_mul_overflow(lhs, rhs, &result) && result != INT64_MIN;
+}
+
+#else
+
+inline bool checkedAdd(int64_t lhs, int64_t rhs, int64_t & result) {
+    if ((rhs > 0 && lhs > INT64_MAX - rhs) || (rhs < 0 && lhs <= INT64_MIN - rhs))
+        return false;
+    result = lhs + rhs;
+    return true;
+}
+
+// The operands are never INT64_MIN, so their magnitudes fit
+inline bool checkedMultiply(int64_t lhs, int64_t rhs, int64_t & result) {
+    uint64_t lhsMagnitude = (uint64_t)llabs(lhs), rhsMagnitude = (uint64_t)llabs(rhs);
+    if (lhsMagnitude != 0 && rhsMagnitude > (uint64_t)INT64_MAX / lhsMagnitude)
+        return false;
+    result = lhs * rhs;
+    return true;
+}
+
+#endif
+
+// Greatest common divisor of non-negative values, gcd(0, b) being b
+int64_t gcd(int64_t a, int64_t b) {
+    while (b != 0) {
+        int64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Square root of a perfect square, or -1
+int64_t exactSqrt(int64_t value) {
+    if (value < 0)
+        return -1;
+    uint64_t root = (uint64_t)std::sqrt((double)value);
+    // The double can be a little off either way
+    while (root * root > (uint64_t)value)
+        root--;
+    while ((root + 1) * (root + 1) <= (uint64_t)value)
+        root++;
+    return root * root == (uint64_t)value ? (int64_t)root : -1;
+}
+
+int bitLength(uint64_t value) {
+    int bits = 0;
+    for (; value != 0; value >>= 1)
+        bits++;
+    return bits;
+}
+
+}
+
+
+Rational & Rational::operator=(const Rational & other) {
+    _numerator = other._numerator;
+    _denominator = other._denominator;
+    _big.reset(other._big ? new Big(*other._big) : NULL);
+    return *this;
+}
+
+
+bool Rational::parse(const char * text, size_t length, Rational & value) {
+    // Up to 18 digits fit inline, whatever they are
+    const size_t MAX_SMALL_DIGITS = 18;
+    size_t numDigits = 0, numDecimals = 0;
+    bool point = false;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '.' && !point)
+            point = true;
+        else if (text[i] >= '0' && text[i] <= '9')
+            numDigits++;
+        else
+            return false;
+        if (point && text[i] != '.')
+            numDecimals++;
+    }
+    if (numDigits == 0)
+        return false;
+
+    if (numDigits <= MAX_SMALL_DIGITS) {
+        int64_t numerator = 0, denominator = 1;
+        for (size_t i = 0; i < length; i++)
+            if (text[i] != '.')
+                numerator = numerator * 10 + (text[i] - '0');
+        for (size_t i = 0; i < numDecimals; i++)
+            denominator *= 10;
+        int64_t divisor = gcd(numerator, denominator);
+        value = Rational(numerator / divisor);
+        value._denominator = denominator / divisor;
+        return true;
+    }
+
+    // Digits and powers of 10 are gathered 9 at a time
+    const BigInteger CHUNK = 1000000000;
+    BigInteger numerator, denominator = 1;
+    int64_t chunk = 0, chunkScale = 1;
+    for (size_t i = 0; i <= length; i++) {
+        if (chunkScale == 1000000000 || i == length) {
+            numerator = numerator * BigInteger(chunkScale) + BigInteger(chunk);
+            chunk = 0;
+            chunkScale = 1;
+        }
+        if (i < length && text[i] != '.') {
+            chunk = chunk * 10 + (text[i] - '0');
+            chunkScale *= 10;
+        }
+    }
+    for (size_t i = 0; i < numDecimals / 9; i++)
+        denominator = denominator * CHUNK;
+    for (size_t i = 0; i < numDecimals % 9; i++)
+        denominator = denominator * BigInteger(10);
+    value = Rational(numerator, denominator);
+    return true;
+}
+
+
+int Rational::sign() const {
+    if (_big)
+        return _big->numerator.isNegative() ? -1 : 1;
+    return (_numerator > 0) - (_numerator < 0);
+}
+
+
+double Rational::toDouble() const {
+    if (!_big)
+        return (double)_numerator / (double)_denominator;
+
+    // Dividing the mantissas does not overflow where the values would
+    int numeratorExponent, denominatorExponent;
+    double numerator = _big->numerator.frexp(numeratorExponent);
+    double denominator = _big->denominator.frexp(denominatorExponent);
+    return ldexp(numerator / denominator, numeratorExponent - denominatorExponent);
+}
+
+
+int Rational::bitLength() const {
+    if (!_big)
+        return ::bitLength((uint64_t)llabs(_numerator)) + ::bitLength((uint64_t)_denominator);
+
+    // frexp() gives the position of the highest bit set
+    int numeratorBits = 0, denominatorBits = 0;
+    _big->numerator.frexp(numeratorBits);
+    _big->denominator.frexp(denominatorBits);
+    return numeratorBits + denominatorBits;
+}
+
+
+string Rational::toString() const {
+    if (_big) {
+        string text = _big->numerator.toString();
+        if (!_big->denominator.isOne())
+            text += '/' + _big->denominator.toString();
+        return text;
+    }
+    string text = to_string(_numerator);
+    if (_denominator != 1)
+        text += '/' + to_string(_denominator);
+    return text;
+}
+
+
+Rational Rational::operator-() const {
+    Rational result = *this;
+    if (result._big)
+        result._big->numerator = -result._big->numerator;
+    else
+        result._numerator = -result._numerator;
+    return result;
+}
+
+
+Rational & Rational::operator+=(const Rational & rhs) {
+    if (!_big && !rhs._big) {
+        int64_t a = _numerator, b = _denominator, c = rhs._numerator, d = rhs._denominator;
+        int64_t sum;
+        if (b == 1 && d == 1) {
+            if (checkedAdd(a, c, sum)) {
+                _numerator = sum;
+                return *this;
+            }
+        } else {
+            // a/b + c/d = (a (d/g) + c (b/g)) / (b/g d), with g = gcd(b, d)
+            int64_t g = gcd(b, d), x, y, denominator;
+            if (checkedMultiply(a, d / g, x) && checkedMultiply(c, b / g, y) && checkedAdd(x, y, sum)
+                && checkedMultiply(b / g, d, denominator)) {
+                int64_t divisor = gcd(llabs(sum), denominator);
+                _numerator = sum / divisor;
+                _denominator = denominator / divisor;
+                return *this;
+            }
+        }
+    }
+
+    // Sums of integers, such as the coefficients of powers, skip the
+    // denominators and their gcd
+    if (isInteger() && rhs.isInteger()) {
+        BigInteger lhsScratch, rhsScratch;
+        _setInteger(_integer(lhsScratch) + rhs._integer(rhsScratch));
+        return *this;
+    }
+    Big lhs = _toBig(), rhsBig = rhs._toBig();
+    _setBig(lhs.numerator * rhsBig.denominator + rhsBig.numerator * lhs.denominator,
+        lhs.denominator * rhsBig.denominator);
+    return *this;
+}
+
+
+Rational & Rational::operator*=(const Rational & rhs) {
+    if (!_big && !rhs._big) {
+        int64_t a = _numerator, b = _denominator, c = rhs._numerator, d = rhs._denominator;
+        if (a == 0 || c == 0) {
+            _numerator = 0;
+            _denominator = 1;
+            return *this;
+        }
+
+        // Cancelling across first keeps the result in lowest terms
+        int64_t g1 = gcd(llabs(a), d), g2 = gcd(llabs(c), b), numerator, denominator;
+        if (checkedMultiply(a / g1, c / g2, numerator) && checkedMultiply(b / g2, d / g1, denominator)) {
+            _numerator = numerator;
+            _denominator = denominator;
+            return *this;
+        }
+    }
+
+    if (isInteger() && rhs.isInteger()) {
+        BigInteger lhsScratch, rhsScratch;
+        _setInteger(_integer(lhsScratch) * rhs._integer(rhsScratch));
+        return *this;
+    }
+    Big lhs = _toBig(), rhsBig = rhs._toBig();
+    _setBig(lhs.numerator * rhsBig.numerator, lhs.denominator * rhsBig.denominator);
+    return *this;
+}
+
+
+Rational operator*(const Rational & lhs, const Rational & rhs) {
+    // Products of big integers, the bulk of the products of polynomials,
+    // are built in place rather than from a copy of lhs
+    Rational result;
+    if (lhs._big && lhs.isInteger() && rhs.isInteger()) {
+        BigInteger scratch;
+        result._setInteger(lhs._big->numerator * rhs._integer(scratch));
+    } else {
+        result = lhs;
+        result *= rhs;
+    }
+    return result;
+}
+
+
+Rational & Rational::operator/=(const Rational & rhs) {
+    if (!rhs._big) {
+        Rational reciprocal;
+        reciprocal._numerator = rhs._numerator < 0 ? -rhs._denominator : rhs._denominator;
+        reciprocal._denominator = llabs(rhs._numerator);
+        return *this *= reciprocal;
+    }
+
+    Big lhs = _toBig();
+    _setBig(lhs.numerator * rhs._big->denominator, lhs.denominator * rhs._big->numerator);
+    return *this;
+}
+
+
+bool operator==(const Rational & lhs, const Rational & rhs) {
+    // Values that fit are always inline, so the representations match
+    if (lhs._big || rhs._big)
+        return lhs._big && rhs._big && lhs._big->numerator == rhs._big->numerator
+            && lhs._big->denominator == rhs._big->denominator;
+    return lhs._numerator == rhs._numerator && lhs._denominator == rhs._denominator;
+}
+
+
+Rational Rational::power(const Rational & base, int64_t exponent) {
+    Rational square = exponent < 0 ? Rational(1) / base : base;
+    uint64_t remaining = exponent < 0 ? 0 - (uint64_t)exponent : (uint64_t)exponent;
+    Rational result = 1;
+    while (remaining != 0) {
+        if (remaining & 1)
+            result *= square;
+        remaining >>= 1;
+        if (remaining != 0)
+            square *= square;
+    }
+    return result;
+}
+
+
+bool Rational::sqrt(Rational & root) const {
+    if (sign() < 0)
+        return false;
+
+    // In lowest terms, both parts must be squares
+    if (!_big) {
+        int64_t numerator = exactSqrt(_numerator), denominator = exactSqrt(_denominator);
+        if (numerator < 0 || denominator < 0)
+            return false;
+        root = Rational(numerator);
+        root._denominator = denominator;
+        return true;
+    }
+
+    BigInteger numerator = _big->numerator.sqrt(), denominator = _big->denominator.sqrt();
+    if (numerator * numerator != _big->numerator || denominator * denominator != _big->denominator)
+        return false;
+    root = Rational(numerator, denominator);
+    return true;
+}
+
+
+// Sets an integer value, inline if it fits, reusing the Big if any
+void Rational::_setInteger(BigInteger value) {
+    int64_t small;
+    if (value.toInt64(small)) {
+        _numerator = small;
+        _denominator = 1;
+        _big.reset();
+    } else if (_big) {
+        _big->numerator = move(value);
+        if (!_big->denominator.isOne())
+            _big->denominator = 1;
+    } else {
+        _big.reset(new Big{ move(value), 1 });
+    }
+}
+
+
+//
+// Sets numerator / denominator in lowest terms, inline if it fits
+//
+void Rational::_setBig(BigInteger numerator, BigInteger denominator) {
+    if (denominator.isNegative()) {
+        numerator = -numerator;
+        denominator = -denominator;
+    }
+    if (!denominator.isOne()) {
+        BigInteger divisor = BigInteger::gcd(numerator, denominator);
+        if (!divisor.isOne()) {
+            numerator = numerator / divisor;
+            denominator = denominator / divisor;
+        }
+    }
+
+    int64_t smallNumerator, smallDenominator;
+    if (numerator.toInt64(smallNumerator) && denominator.toInt64(smallDenominator)) {
+        _numerator = smallNumerator;
+        _denominator = smallDenominator;
+        _big.reset();
+    } else {
+        _big.reset(new Big{ move(numerator), move(denominator) });
+    }
+}
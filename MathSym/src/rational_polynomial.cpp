@@ -0,0 +1,134 @@
+#include "rational_polynomial.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+RationalPolynomial RationalPolynomial::constant(const Rational & coefficient) {
+    return monomial(coefficient, 0);
+}
+
+
+RationalPolynomial RationalPolynomial::monomial(const Rational & coefficient, int exponent) {
+    RationalPolynomial result;
+    if (!coefficient.isZero())
+        result._terms.push_back({ coefficient, exponent });
+    return result;
+}
+
+
+Rational RationalPolynomial::coefficient(int exponent) const {
+    auto it = lower_bound(_terms.begin(), _terms.end(), exponent,
+        [](const Term & term, int exponent) { return term.exponent < exponent; });
+    return (it != _terms.end() && it->exponent == exponent) ? it->coefficient : Rational(0);
+}
+
+
+RationalPolynomial & RationalPolynomial::scale(const Rational & factor) {
+    if (factor.isZero()) {
+        _terms.clear();
+        return *this;
+    }
+
+    for (auto & term : _terms)
+        term.coefficient *= factor;
+    return *this;
+}
+
+
+RationalPolynomial & RationalPolynomial::_addScaled(const RationalPolynomial & rhs, int factor) {
+    if (rhs.isZero())
+        return *this;
+
+    // Linear merge of the two sorted term lists
+    vector<Term> merged;
+    merged.reserve(_terms.size() + rhs._terms.size());
+    size_t i = 0, j = 0;
+    while (i < _terms.size() || j < rhs._terms.size()) {
+        if (j == rhs._terms.size() || (i < _terms.size() && _terms[i].exponent < rhs._terms[j].exponent)) {
+            merged.push_back(move(_terms[i++]));
+        } else if (i == _terms.size() || rhs._terms[j].exponent < _terms[i].exponent) {
+            const Term & term = rhs._terms[j++];
+            merged.push_back({ factor < 0 ? -term.coefficient : term.coefficient, term.exponent });
+        } else {
+            Term & sum = _terms[i++];
+            if (factor < 0)
+                sum.coefficient -= rhs._terms[j++].coefficient;
+            else
+                sum.coefficient += rhs._terms[j++].coefficient;
+            if (!sum.coefficient.isZero())
+                merged.push_back(move(sum));
+        }
+    }
+    _terms.swap(merged);
+    return *this;
+}
+
+
+RationalPolynomial RationalPolynomial::multiply(const RationalPolynomial & lhs, const RationalPolynomial & rhs) {
+    RationalPolynomial result;
+    if (lhs.isZero() || rhs.isZero())
+        return result;
+
+    size_t productCount = lhs._terms.size() * rhs._terms.size();
+    int resultDegree = lhs.degree() + rhs.degree();
+    auto & terms = result._terms;
+
+    if ((size_t)resultDegree < 4 * productCount) {
+        // Most exponents are hit: accumulate the products into an array
+        vector<Rational> coefficients(resultDegree + 1);
+        for (const auto & terml : lhs._terms)
+            for (const auto & termr : rhs._terms)
+                coefficients[terml.exponent + termr.exponent] += terml.coefficient * termr.coefficient;
+        for (size_t k = 0; k < coefficients.size(); k++)
+            if (!coefficients[k].isZero())
+                terms.push_back({ move(coefficients[k]), (int)k });
+        return result;
+    }
+
+    // Sort all the products by exponent and combine equal exponents
+    terms.reserve(productCount);
+    for (const auto & terml : lhs._terms)
+        for (const auto & termr : rhs._terms)
+            terms.push_back({ terml.coefficient * termr.coefficient, terml.exponent + termr.exponent });
+    stable_sort(terms.begin(), terms.end(), [](const Term & a, const Term & b) {
+        return a.exponent < b.exponent;
+    });
+
+    size_t end = 0;
+    for (size_t i = 0; i < terms.size();) {
+        Term sum = move(terms[i]);
+        for (i++; i < terms.size() && terms[i].exponent == sum.exponent; i++)
+            sum.coefficient += terms[i].coefficient;
+        if (!sum.coefficient.isZero())
+            terms[end++] = move(sum);
+    }
+    terms.resize(end);
+    return result;
+}
+
+
+RationalPolynomial RationalPolynomial::power(const RationalPolynomial & base, unsigned exponent) {
+    RationalPolynomial result = constant(1), square = base;
+    while (exponent != 0) {
+        if (exponent & 1)
+            result = multiply(result, square);
+        exponent >>= 1;
+        if (exponent != 0)
+            square = multiply(square, square);
+    }
+    return result;
+}
+
+
+Polynomial RationalPolynomial::toPolynomial() const {
+    vector<Polynomial::Term> terms;
+    terms.reserve(_terms.size());
+    for (const auto & term : _terms) {
+        double coefficient = term.coefficient.toDouble();
+        if (coefficient != 0)
+            terms.push_back({ coefficient, term.exponent });
+    }
+    return Polynomial::fromTerms(move(terms));
+}
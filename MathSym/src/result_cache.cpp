@@ -0,0 +1,102 @@
+#include "result_cache.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+const size_t ResultCache::NUM_SHARDS;
+
+
+ResultCache::ResultCache(size_t capacity)
+    : _capacity(capacity), _shards(new Shard[NUM_SHARDS]), _hits(0), _misses(0) {
+
+    // Spread the capacity over the shards, none of them empty unless disabled
+    for (size_t i = 0; i < NUM_SHARDS; i++)
+        _shards[i].capacity = (capacity == 0) ? 0 : max((size_t)1, (capacity + i) / NUM_SHARDS);
+}
+
+
+void ResultCache::makeKey(const vector<Token> & tokens, const char * line, string & key) {
+    // Kind and length of each token, followed by its text; the lengths keep
+    // the encoding unambiguous
+    key.clear();
+    for (const auto & token : tokens) {
+        key.append((const char *)&token.kind, sizeof(token.kind));
+        key.append((const char *)&token.length, sizeof(token.length));
+        key.append(line + token.offset, token.length);
+    }
+}
+
+
+bool ResultCache::lookup(const string & key, const vector<Token> & tokens, size_t lineLength,
+    Result & result) {
+
+    if (!enabled())
+        return false;
+
+    Shard & shard = _shard(key);
+    {
+        lock_guard<mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            // Move to the front as the most recently used
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            const Entry & entry = *it->second;
+            result = entry.result;
+            if (!result.ok && result.errorColumn != Result::NO_COLUMN)
+                result.errorColumn = (entry.errorToken < tokens.size())
+                    ? tokens[entry.errorToken].offset : lineLength;
+            _hits++;
+            return true;
+        }
+    }
+    _misses++;
+    return false;
+}
+
+
+void ResultCache::insert(const string & key, const vector<Token> & tokens, const Result & result) {
+    if (!enabled())
+        return;
+
+    Entry entry = { key, result, tokens.size() };
+    if (!result.ok && result.errorColumn != Result::NO_COLUMN) {
+        auto it = lower_bound(tokens.begin(), tokens.end(), result.errorColumn,
+            [](const Token & token, size_t column) { return token.offset < column; });
+        entry.errorToken = it - tokens.begin();
+    }
+
+    Shard & shard = _shard(key);
+    lock_guard<mutex> lock(shard.mutex);
+    if (shard.index.find(key) != shard.index.end())
+        return;   // Inserted by another thread meanwhile
+
+    if (shard.entries.size() >= shard.capacity) {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front(move(entry));
+    shard.index[shard.entries.front().key] = shard.entries.begin();
+}
+
+
+void ResultCache::clear() {
+    for (size_t i = 0; i < NUM_SHARDS; i++) {
+        lock_guard<mutex> lock(_shards[i].mutex);
+        _shards[i].entries.clear();
+        _shards[i].index.clear();
+    }
+    _hits = 0;
+    _misses = 0;
+}
+
+
+size_t ResultCache::size() const {
+    size_t size = 0;
+    for (size_t i = 0; i < NUM_SHARDS; i++) {
+        lock_guard<mutex> lock(_shards[i].mutex);
+        size += _shards[i].entries.size();
+    }
+    return size;
+}
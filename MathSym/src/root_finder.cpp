@@ -0,0 +1,267 @@
+#include "root_finder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+
+
+const int RootFinder::MAX_DEGREE;
+const int RootFinder::MAX_ITERATIONS;
+const int RootFinder::POLISHING_STEPS;
+const double RootFinder::CLUSTER_TOLERANCE = 1e-2;
+
+
+void RootFinder::findRoots(const vector<double> & coefficients, vector<Root> & roots) {
+    roots.clear();
+
+    // Zero roots are factored out, so that the constant coefficient is nonzero
+    size_t numZeros = 0;
+    while (numZeros + 1 < coefficients.size() && coefficients[numZeros] == 0)
+        numZeros++;
+    if (numZeros != 0)
+        roots.push_back({ 0, (int)numZeros, true });
+
+    vector<double> a(coefficients.begin() + numZeros, coefficients.end());
+    size_t n = a.size() - 1;
+    if (n == 0)
+        return;
+
+    vector<complex<double>> z;
+    _initialApproximations(a, z);
+
+    // Each approximation is moved by its Newton correction, corrected for the
+    // attraction of the others: w = c / (1 - c * sum of 1 / (z[k] - z[j])).
+    // The updated approximations are used right away within the sweep. An
+    // approximation is refined until its step is below the precision, even
+    // once it is a root within the bound of the rounding errors: the bound is
+    // far too wide for ill-conditioned roots, while the actual errors are
+    // small enough for the iteration to get much closer.
+    vector<uint8_t> converged(n, 0);
+    size_t numConverged = 0;
+    for (int iteration = 0; iteration < MAX_ITERATIONS && numConverged < n; iteration++) {
+        for (size_t k = 0; k < n; k++) {
+            if (converged[k])
+                continue;
+
+            complex<double> correction;
+            double radius;
+            _newtonCorrection(a, z[k], correction, radius);
+            if (correction == 0.0) {
+                converged[k] = 1;
+                numConverged++;
+                continue;
+            }
+
+            double sumReal = 0, sumImag = 0;
+            for (size_t j = 0; j < n; j++) {
+                if (j == k)
+                    continue;
+                double dr = z[k].real() - z[j].real(), di = z[k].imag() - z[j].imag();
+                double scale = 1 / (dr * dr + di * di);
+                sumReal += dr * scale;
+                sumImag -= di * scale;
+            }
+
+            double cr = correction.real(), ci = correction.imag();
+            double denominatorReal = 1 - (cr * sumReal - ci * sumImag);
+            double denominatorImag = -(cr * sumImag + ci * sumReal);
+            complex<double> step = correction / complex<double>(denominatorReal, denominatorImag);
+            if (!isfinite(step.real()) || !isfinite(step.imag()))
+                step = correction;
+
+            z[k] -= step;
+            if (abs(step) <= DBL_EPSILON * abs(z[k])) {
+                converged[k] = 1;
+                numConverged++;
+            }
+        }
+    }
+
+    // The rounding errors spread the approximations of a root of
+    // multiplicity m around it, the wider the larger m is. Approximations
+    // whose inclusion disks overlap are merged into one root, connected
+    // component by connected component, unless they are too far apart to be
+    // the same root, as the disks of ill-conditioned roots are very wide.
+    vector<double> radii(n);
+    for (size_t k = 0; k < n; k++) {
+        complex<double> correction;
+        _newtonCorrection(a, z[k], correction, radii[k]);
+    }
+
+    vector<size_t> cluster(n);
+    for (size_t k = 0; k < n; k++)
+        cluster[k] = k;
+    auto findCluster = [&cluster](size_t k) {
+        while (cluster[k] != k)
+            k = cluster[k] = cluster[cluster[k]];
+        return k;
+    };
+    // Each cluster is represented by its first approximation
+    for (size_t k = 0; k < n; k++) {
+        for (size_t j = k + 1; j < n; j++) {
+            double distance = abs(z[k] - z[j]);
+            if (distance <= radii[k] + radii[j] && distance <= CLUSTER_TOLERANCE * max(1.0, abs(z[k]))) {
+                size_t first = findCluster(k), second = findCluster(j);
+                cluster[max(first, second)] = min(first, second);
+            }
+        }
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        if (findCluster(k) != k)
+            continue;
+
+        int multiplicity = 0;
+        complex<double> center = 0;
+        for (size_t j = k; j < n; j++) {
+            if (findCluster(j) == k) {
+                center += z[j];
+                multiplicity++;
+            }
+        }
+        center /= (double)multiplicity;
+
+        double clusterRadius = 0;
+        for (size_t j = k; j < n; j++)
+            if (findCluster(j) == k)
+                clusterRadius = max(clusterRadius, abs(z[j] - center) + radii[j]);
+
+        Root root = { center, multiplicity, abs(center.imag()) <= clusterRadius };
+        if (root.real)
+            root.value = center.real();
+
+        // The root is polished by Newton steps, which keep a real root real,
+        // as long as they stay within its inclusion disk. A root of
+        // multiplicity m is a simple root of the (m - 1)-th derivative.
+        vector<double> derivative = a;
+        for (int m = 1; m < multiplicity; m++) {
+            for (size_t i = 1; i < derivative.size(); i++)
+                derivative[i - 1] = derivative[i] * (double)i;
+            derivative.pop_back();
+        }
+        for (int step = 0; step < POLISHING_STEPS; step++) {
+            complex<double> correction;
+            double radius;
+            if (!_newtonCorrection(derivative, root.value, correction, radius) || abs(correction) > clusterRadius)
+                break;
+            root.value -= correction;
+        }
+
+        // Likewise, a real part of 0 within the accuracy is made exact
+        if (!root.real && abs(root.value.real()) <= clusterRadius)
+            root.value = complex<double>(0, root.value.imag());
+
+        roots.push_back(root);
+    }
+
+    // The coefficients are real, so the complex roots come in conjugate
+    // pairs, which are made exact
+    vector<uint8_t> paired(roots.size(), 0);
+    for (size_t k = 0; k < roots.size(); k++) {
+        Root & root = roots[k];
+        if (root.real || root.value.imag() < 0)
+            continue;
+        size_t conjugate = roots.size();
+        for (size_t j = 0; j < roots.size(); j++)
+            if (!roots[j].real && roots[j].value.imag() < 0 && !paired[j] && roots[j].multiplicity == root.multiplicity
+                && (conjugate == roots.size()
+                    || abs(roots[j].value - conj(root.value)) < abs(roots[conjugate].value - conj(root.value))))
+                conjugate = j;
+        if (conjugate != roots.size()) {
+            paired[conjugate] = 1;
+            root.value = (root.value + conj(roots[conjugate].value)) / 2.0;
+            roots[conjugate].value = conj(root.value);
+        }
+    }
+
+    sort(roots.begin(), roots.end(), [](const Root & lhs, const Root & rhs) {
+        return lhs.value.real() != rhs.value.real()
+            ? lhs.value.real() < rhs.value.real() : lhs.value.imag() > rhs.value.imag();
+    });
+}
+
+
+bool RootFinder::_newtonCorrection(const vector<double> & a, complex<double> z, complex<double> & correction,
+    double & radius) {
+
+    // Horner evaluation of the value, the derivative, and the sum of the
+    // absolute values of the terms, which bounds the rounding error. Outside
+    // the unit disk, p(z) = z^n q(1/z) with q the reversed polynomial.
+    size_t n = a.size() - 1;
+    bool reversed = abs(z) > 1;
+    complex<double> x = reversed ? 1.0 / z : z;
+    double xr = x.real(), xi = x.imag(), xAbs = abs(x);
+
+    double pr = reversed ? a[0] : a[n], pi = 0, dr = 0, di = 0;
+    double bound = abs(pr);
+    for (size_t i = 1; i <= n; i++) {
+        double c = reversed ? a[i] : a[n - i];
+        double newDr = dr * xr - di * xi + pr, newDi = dr * xi + di * xr + pi;
+        double newPr = pr * xr - pi * xi + c, newPi = pr * xi + pi * xr;
+        dr = newDr;
+        di = newDi;
+        pr = newPr;
+        pi = newPi;
+        bound = bound * xAbs + abs(c);
+    }
+    double error = 2 * n * DBL_EPSILON * bound;
+
+    complex<double> value(pr, pi), derivative(dr, di);
+    if (reversed) {
+        // p(z) / p'(z) = z q(x) / (n q(x) - x q'(x)) with x = 1 / z
+        derivative = (double)n * value - x * derivative;
+        value *= z;
+        error *= abs(z);
+    }
+
+    double derivativeAbs = abs(derivative);
+    if (derivativeAbs == 0) {
+        correction = 0;
+        radius = HUGE_VAL;
+        return abs(value) > error;
+    }
+
+    correction = value / derivative;
+    radius = n * (abs(value) + error) / derivativeAbs;
+    return abs(value) > error;
+}
+
+
+//
+// Spreads the approximations on circles centered at 0, with one circle per
+// edge of the upper convex hull of the points (i, log |a[i]|), whose slope
+// gives the radius. The number of roots of about that modulus is the width of
+// the edge.
+//
+void RootFinder::_initialApproximations(const vector<double> & a, vector<complex<double>> & approximations) {
+    size_t n = a.size() - 1;
+    vector<size_t> hull;
+    for (size_t i = 0; i <= n; i++) {
+        if (a[i] == 0)
+            continue;
+        while (hull.size() >= 2) {
+            size_t i1 = hull[hull.size() - 2], i2 = hull.back();
+            double l1 = log(abs(a[i1])), l2 = log(abs(a[i2])), l3 = log(abs(a[i]));
+            // Drop the middle point unless it lies strictly above the chord
+            if ((l2 - l1) * (double)(i - i1) > (l3 - l1) * (double)(i2 - i1))
+                break;
+            hull.pop_back();
+        }
+        hull.push_back(i);
+    }
+
+    const double PI = 3.14159265358979323846;
+    const double OFFSET = 0.7;   // Keeps the circles from starting on the real axis
+    approximations.clear();
+    for (size_t h = 0; h + 1 < hull.size(); h++) {
+        size_t i = hull[h], j = hull[h + 1];
+        double radius = exp((log(abs(a[i])) - log(abs(a[j]))) / (double)(j - i));
+        for (size_t k = 0; k < j - i; k++) {
+            double angle = 2 * PI * ((double)k / (double)(j - i) + (double)i / (double)n) + OFFSET;
+            approximations.push_back(polar(radius, angle));
+        }
+    }
+}
@@ -0,0 +1,373 @@
+#include "semantics.h"
+#include "root_finder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+
+const int Semantics::MAX_POWER_DEGREE;
+const int Semantics::MAX_POWER_TERMS;
+const int Semantics::MAX_EXACT_EXPONENT;
+const double Semantics::MAX_EXACT_POWER_BITS = 4000000;
+
+
+namespace {
+
+// Fractions take a gcd after each product, which makes the products of
+// polynomials with fractional coefficients about as slow as those of
+// integer ones with this many times the bits
+const double FRACTION_COST = 40;
+
+// Bits of the largest coefficient of the polynomial, as numerator and
+// denominator, and whether any is a fraction
+int coefficientBits(const RationalPolynomial & value, bool & fractions) {
+    int bits = 0;
+    for (const auto & term : value.terms()) {
+        bits = max(bits, term.coefficient.bitLength());
+        fractions = fractions || !term.coefficient.isInteger();
+    }
+    return bits;
+}
+
+// Estimated bits of all the coefficients of base^exponent, from the number
+// of terms it can have and a bound on the bits of each coefficient, which
+// is exponent times those of the largest coefficient of the base and of the
+// number of its terms
+double exactPowerBits(const RationalPolynomial & base, int64_t exponent) {
+    bool fractions = false;
+    int baseBits = coefficientBits(base, fractions);
+    double bits = (double)exponent * (baseBits + log2((double)base.size()));
+    double numTerms = (base.size() == 1) ? 1 : (double)exponent * base.degree() + 1;
+    return numTerms * bits * (fractions && base.size() > 1 ? FRACTION_COST : 1);
+}
+
+// The same for lhs * rhs, whose coefficients are sums of products of those
+// of the operands
+double exactProductBits(const RationalPolynomial & lhs, const RationalPolynomial & rhs) {
+    bool fractions = false;
+    size_t smaller = min(lhs.size(), rhs.size());
+    double bits = coefficientBits(lhs, fractions) + coefficientBits(rhs, fractions) + log2((double)smaller);
+    double numTerms = min((double)lhs.size() * rhs.size(), (double)lhs.degree() + rhs.degree() + 1);
+    return numTerms * bits * (fractions && smaller > 1 ? FRACTION_COST : 1);
+}
+
+}
+
+
+Polynomial Semantics::multiply(const Polynomial & lhs, const Polynomial & rhs) {
+    int degree = max(lhs.degree(), 0) + max(rhs.degree(), 0);
+    if (degree > MAX_POWER_DEGREE)
+        throw EvalError("Products of degree > " + to_string(MAX_POWER_DEGREE) + " are not supported");
+    // The product of a single term by anything is cheap
+    if (degree >= MAX_POWER_TERMS && lhs.terms().size() > 1 && rhs.terms().size() > 1)
+        throw EvalError("Products with more than " + to_string(MAX_POWER_TERMS) + " terms are not supported");
+    return Polynomial::multiply(lhs, rhs);
+}
+
+
+Polynomial Semantics::divide(const Polynomial & lhs, const Polynomial & rhs) {
+    if (rhs.isZero()) {
+        throw EvalError("Division by 0");
+    }
+
+    if (rhs.degree() != 0) {
+        throw EvalError("Polynomial division is not supported");
+    }
+
+    Polynomial result = lhs;
+    return result.scale(1 / rhs.coefficient(0));
+}
+
+
+Polynomial Semantics::power(const Polynomial & lhs, const Polynomial & rhs) {
+    if (rhs.degree() > 0)
+        throw EvalError("Polynomial exponents are not supported");
+
+    double exponent = rhs.coefficient(0);
+    if (lhs.degree() <= 0) {
+        double base = lhs.coefficient(0);
+        if (base == 0 && exponent < 0)
+            throw EvalError("Division by 0");
+        if (!hasRealPower(base, exponent))
+            throw EvalError("Fractional powers of negative numbers are not supported");
+        return Polynomial::constant(pow(base, exponent));
+    }
+
+    if (exponent < 0 || exponent != floor(exponent))
+        throw EvalError("Powers of polynomials must have non-negative integer exponents");
+    if (exponent * lhs.degree() > MAX_POWER_DEGREE)
+        throw EvalError("Powers of degree > " + to_string(MAX_POWER_DEGREE) + " are not supported");
+    // The powers of a single term stay a single term, and are cheap
+    if (lhs.terms().size() > 1 && exponent * lhs.degree() >= MAX_POWER_TERMS)
+        throw EvalError("Powers with more than " + to_string(MAX_POWER_TERMS) + " terms are not supported");
+    return Polynomial::power(lhs, (unsigned)exponent);
+}
+
+
+RationalPolynomial Semantics::multiply(const RationalPolynomial & lhs, const RationalPolynomial & rhs) {
+    if (max(lhs.degree(), 0) + max(rhs.degree(), 0) > MAX_POWER_DEGREE)
+        throw EvalError("Products of degree > " + to_string(MAX_POWER_DEGREE) + " are not supported");
+    if (lhs.size() > 1 && rhs.size() > 1 && exactProductBits(lhs, rhs) > MAX_EXACT_POWER_BITS)
+        throw EvalError("Exact products of more than " + to_string((int)MAX_EXACT_POWER_BITS)
+            + " bits are not supported");
+    return RationalPolynomial::multiply(lhs, rhs);
+}
+
+
+RationalPolynomial Semantics::divide(const RationalPolynomial & lhs, const RationalPolynomial & rhs) {
+    if (rhs.isZero())
+        throw EvalError("Division by 0");
+    if (rhs.degree() != 0)
+        throw EvalError("Polynomial division is not supported");
+
+    RationalPolynomial result = lhs;
+    return result.scale(Rational(1) / rhs.coefficient(0));
+}
+
+
+RationalPolynomial Semantics::power(const RationalPolynomial & lhs, const RationalPolynomial & rhs) {
+    if (rhs.degree() > 0)
+        throw EvalError("Polynomial exponents are not supported");
+
+    Rational exponent = rhs.coefficient(0);
+    int64_t n = 0;
+    bool integer = exponent.isInteger() && exponent.numerator().toInt64(n);
+    if (lhs.degree() <= 0) {
+        Rational base = lhs.coefficient(0);
+        if (base.isZero() && exponent.sign() < 0)
+            throw EvalError("Division by 0");
+        if (!exponent.isInteger())
+            throw EvalError("Fractional powers are not supported in exact mode");
+        // Powers of 0, 1 and -1 stay small whatever the exponent
+        bool unit = base * base == Rational(1);
+        if (!integer || (llabs(n) > MAX_EXACT_EXPONENT && !unit && !base.isZero()))
+            throw EvalError("Exact powers with exponents > " + to_string(MAX_EXACT_EXPONENT) + " are not supported");
+        if (unit)
+            n %= 2;
+        return RationalPolynomial::constant(Rational::power(base, n));
+    }
+
+    if (!integer || n < 0)
+        throw EvalError("Powers of polynomials must have non-negative integer exponents");
+    if (n > MAX_POWER_DEGREE / lhs.degree())
+        throw EvalError("Powers of degree > " + to_string(MAX_POWER_DEGREE) + " are not supported");
+    if (exactPowerBits(lhs, n) > MAX_EXACT_POWER_BITS) {
+        // The largest exponent within the bound, which grows with it
+        int64_t largest = 0;
+        for (int64_t step = n / 2; step > 0; step /= 2) {
+            while (largest + step < n && exactPowerBits(lhs, largest + step) <= MAX_EXACT_POWER_BITS)
+                largest += step;
+        }
+        throw EvalError("Exact powers of this polynomial with exponents > " + to_string(largest)
+            + " are not supported");
+    }
+    return RationalPolynomial::power(lhs, (unsigned)n);
+}
+
+
+void Semantics::setValue(const Polynomial & value, Result & result) {
+    string & text = result.text;
+    vector<Polynomial::Term> terms = value.terms();
+    text = "ans = ";
+    if (terms.size() != 0) {
+        if (terms[0].coefficient != 1 || terms[0].exponent == 0)
+            appendNumber(text, terms[0].coefficient);
+        _appendExponent(text, terms[0].exponent);
+        for (size_t i = 1; i < terms.size(); i++) {
+            const auto & term = terms[i];
+            text += (term.coefficient > 0 ? " + " : " - ");
+            if (abs(term.coefficient) != 1 || abs(term.exponent) == 0)
+                appendNumber(text, abs(term.coefficient));
+            _appendExponent(text, term.exponent);
+        }
+    } else {
+        text += '0';
+    }
+
+}
+
+
+void Semantics::setValue(const RationalPolynomial & value, Result & result) {
+    string & text = result.text;
+    const auto & terms = value.terms();
+    text = "ans = ";
+    if (terms.empty()) {
+        text += '0';
+        return;
+    }
+
+    // By descending exponent, with the same layout as above
+    for (size_t i = terms.size(); i > 0; i--) {
+        const auto & term = terms[i - 1];
+        if (i == terms.size()) {
+            if (term.coefficient != Rational(1) || term.exponent == 0)
+                _appendCoefficient(text, term.coefficient, term.exponent);
+        } else {
+            text += (term.coefficient.sign() > 0 ? " + " : " - ");
+            Rational magnitude = term.coefficient.sign() > 0 ? term.coefficient : -term.coefficient;
+            if (magnitude != Rational(1) || term.exponent == 0)
+                _appendCoefficient(text, magnitude, term.exponent);
+        }
+        _appendExponent(text, term.exponent);
+    }
+}
+
+
+void Semantics::setSolutions(const Polynomial & lhs, Result & result, bool complexSolutions) {
+    string & text = result.text;
+    if (lhs.degree() > RootFinder::MAX_DEGREE) {
+        result.setError("Equations of degree > " + to_string(RootFinder::MAX_DEGREE) + " are not supported");
+        return;
+    }
+
+    if (lhs.degree() > 2) {
+        vector<double> coefficients(lhs.degree() + 1, 0.0);
+        for (const auto & term : lhs.terms())
+            coefficients[term.exponent] = term.coefficient;
+
+        vector<RootFinder::Root> roots;
+        RootFinder::findRoots(coefficients, roots);
+
+        // Real solutions first, each once whatever its multiplicity
+        text.clear();
+        for (int pass = 0; pass < (complexSolutions ? 2 : 1); pass++) {
+            for (const auto & root : roots) {
+                if (root.real != (pass == 0))
+                    continue;
+                text += text.empty() ? "x = " : " or x = ";
+                if (root.real)
+                    appendNumber(text, root.value.real());
+                else
+                    _appendComplex(text, root.value.real(), root.value.imag());
+            }
+        }
+        if (text.empty())
+            text = "No solutions";
+        return;
+    }
+
+    if (lhs.isZero()) {
+        text = "Infinitely many solutions";
+        return;
+    }
+
+    int degree = lhs.degree();
+    double a[3] = { 0, 0, 0 };   // The coefficients of the equation
+    for (int i = 0; i <= degree; i++)
+        a[i] = lhs.coefficient(degree - i);
+
+    switch (degree) {
+        case 0:
+            // Trivial equation of scalars (no polynomials)
+            if (a[0] != 0)
+                text = "No solutions";
+            else
+                text = "Infinitely many solutions";
+            break;
+
+        case 1:
+            // Linear equation
+            text = "x = ";
+            appendNumber(text, -a[1] / a[0]);
+            break;
+
+        case 2:
+            // Quadratic equation
+            double D = (a[1] * a[1] - 4 * a[0] * a[2]);
+            if (D > 0) {
+                text = "x = ";
+                appendNumber(text, (-a[1] + sqrt(D)) / (2 * a[0]));
+                text += " or x = ";
+                appendNumber(text, (-a[1] - sqrt(D)) / (2 * a[0]));
+            } else if (D == 0) {
+                text = "x = ";
+                appendNumber(text, -a[1] / (2 * a[0]));
+            } else if (complexSolutions) {
+                double real = -a[1] / (2 * a[0]), imag = abs(sqrt(-D) / (2 * a[0]));
+                text = "x = ";
+                _appendComplex(text, real, imag);
+                text += " or x = ";
+                _appendComplex(text, real, -imag);
+            } else {
+                text = "No solutions";
+            }
+            break;
+    }
+}
+
+
+void Semantics::setSolutions(const RationalPolynomial & lhs, Result & result, bool complexSolutions) {
+    string & text = result.text;
+    int degree = lhs.degree();
+    if (degree <= 0) {
+        text = lhs.isZero() ? "Infinitely many solutions" : "No solutions";
+        return;
+    }
+    if (degree == 1) {
+        text = "x = " + (-lhs.coefficient(0) / lhs.coefficient(1)).toString();
+        return;
+    }
+
+    if (degree == 2) {
+        // The roots are rational when the discriminant is a square
+        Rational a = lhs.coefficient(2), b = lhs.coefficient(1), c = lhs.coefficient(0);
+        Rational D = b * b - Rational(4) * a * c, root;
+        if (D.sign() >= 0 && D.sqrt(root)) {
+            text = "x = " + ((-b + root) / (Rational(2) * a)).toString();
+            if (!root.isZero())
+                text += " or x = " + ((-b - root) / (Rational(2) * a)).toString();
+            return;
+        }
+    }
+
+    setSolutions(lhs.toPolynomial(), result, complexSolutions);
+}
+
+
+void Semantics::appendNumber(string & text, double value) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%g", value);
+    text.append(buffer, length);
+}
+
+
+// Appends a + bi, or bi if a is 0, with a factor that shows as 1 left out
+void Semantics::_appendComplex(string & text, double real, double imag) {
+    if (real != 0) {
+        appendNumber(text, real);
+        text += (imag < 0) ? " - " : " + ";
+    } else if (imag < 0) {
+        text += '-';
+    }
+
+    string factor;
+    appendNumber(factor, abs(imag));
+    if (factor != "1")
+        text += factor;
+    text += 'i';
+}
+
+
+// Appends x^exponent, x for 1 and nothing for 0
+void Semantics::_appendExponent(string & text, int exponent) {
+    if (exponent != 0)
+        text += 'x';
+    if (exponent != 0 && exponent != 1) {
+        text += '^';
+        text += to_string(exponent);
+    }
+}
+
+
+// Appends the exact coefficient of x^exponent, within parentheses if it is a
+// fraction followed by x
+void Semantics::_appendCoefficient(string & text, const Rational & coefficient, int exponent) {
+    if (exponent != 0 && !coefficient.isInteger())
+        text += '(' + coefficient.toString() + ')';
+    else
+        text += coefficient.toString();
+}
@@ -0,0 +1,339 @@
+#include "server.h"
+#include "batch.h"
+
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+const uint32_t Server::MAX_REQUEST_SIZE;
+const size_t Server::INPUT_HIGH_WATER;
+const size_t Server::OUTPUT_HIGH_WATER;
+
+
+#ifdef __linux__
+
+namespace {
+
+const int MAX_EVENTS = 64;
+const size_t READ_SIZE = 64 * 1024;
+
+uint32_t readLength(const char * bytes) {
+    const unsigned char * b = (const unsigned char *)bytes;
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+void appendLength(string & text, uint32_t length) {
+    char bytes[4] = { (char)(length >> 24), (char)(length >> 16), (char)(length >> 8), (char)length };
+    text.append(bytes, 4);
+}
+
+// Whether the address is a TCP port, with the port in port
+bool parsePort(const string & address, int & port) {
+    string digits = address.compare(0, 10, "localhost:") == 0 ? address.substr(10) : address;
+    if (digits.empty() || digits.size() > 5 || digits.find_first_not_of("0123456789") != string::npos)
+        return false;
+    port = stoi(digits);
+    return port <= 65535;
+}
+
+}
+
+
+Server::~Server() {
+    for (auto & connection : _connections)
+        ::close(connection.first);
+    if (_listenFd >= 0)
+        ::close(_listenFd);
+    if (_epollFd >= 0)
+        ::close(_epollFd);
+    if (_stopFd >= 0)
+        ::close(_stopFd);
+    if (!_socketPath.empty())
+        unlink(_socketPath.c_str());
+}
+
+
+bool Server::listen(const string & address) {
+    int port;
+    _tcp = parsePort(address, port);
+    if (_tcp) {
+        _listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if (_listenFd >= 0)
+            setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in socketAddress = {};
+        socketAddress.sin_family = AF_INET;
+        socketAddress.sin_port = htons((uint16_t)port);
+        socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (_listenFd < 0 || ::bind(_listenFd, (sockaddr *)&socketAddress, sizeof(socketAddress)) != 0) {
+            cerr << "Error: Failed to listen on port " << port << ": " << strerror(errno) << endl;
+            return false;
+        }
+    } else {
+        sockaddr_un socketAddress = {};
+        socketAddress.sun_family = AF_UNIX;
+        if (address.size() >= sizeof(socketAddress.sun_path)) {
+            cerr << "Error: Socket path too long: " << address << endl;
+            return false;
+        }
+        memcpy(socketAddress.sun_path, address.c_str(), address.size() + 1);
+
+        // A socket left by a server that did not exit cleanly, but no other file
+        struct stat status;
+        if (stat(address.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+            unlink(address.c_str());
+
+        _listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (_listenFd < 0 || ::bind(_listenFd, (sockaddr *)&socketAddress, sizeof(socketAddress)) != 0) {
+            cerr << "Error: Failed to listen on " << address << ": " << strerror(errno) << endl;
+            return false;
+        }
+        _socketPath = address;
+    }
+
+    _epollFd = epoll_create1(EPOLL_CLOEXEC);
+    _stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (::listen(_listenFd, SOMAXCONN) != 0 || _epollFd < 0 || _stopFd < 0) {
+        cerr << "Error: Failed to listen on " << address << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = _listenFd;
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, _listenFd, &event);
+    event.data.fd = _stopFd;
+    epoll_ctl(_epollFd, EPOLL_CTL_ADD, _stopFd, &event);
+    return true;
+}
+
+
+ServerStats Server::run() {
+    ServerStats stats;
+    auto start = chrono::steady_clock::now();
+
+    epoll_event events[MAX_EVENTS];
+    bool stopped = (_epollFd < 0);
+    while (!stopped) {
+        int numEvents = epoll_wait(_epollFd, events, MAX_EVENTS, -1);
+        if (numEvents < 0 && errno != EINTR) {
+            cerr << "Error: epoll_wait failed: " << strerror(errno) << endl;
+            break;
+        }
+
+        for (int i = 0; i < numEvents; i++) {
+            int fd = events[i].data.fd;
+            if (fd == _stopFd) {
+                stopped = true;
+            } else if (fd == _listenFd) {
+                _accept(stats);
+            } else {
+                auto it = _connections.find(fd);
+                if (it != _connections.end() && !_serve(*it->second, events[i].events, stats))
+                    _close(fd);
+            }
+        }
+    }
+
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+
+void Server::stop() {
+    // write() is safe in a signal handler
+    uint64_t one = 1;
+    if (_stopFd >= 0) {
+        ssize_t written = write(_stopFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+
+void Server::_accept(ServerStats & stats) {
+    while (true) {
+        int fd = accept4(_listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;   // EAGAIN once all are accepted, or a connection aborted before
+        if (_tcp) {
+            // Responses are written whole, and must not wait for an ACK
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+
+        unique_ptr<Connection> connection(new Connection());
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        epoll_event event = {};
+        event.events = connection->events;
+        event.data.fd = fd;
+        if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            ::close(fd);
+            continue;
+        }
+        _connections[fd] = move(connection);
+        stats.connections++;
+    }
+}
+
+
+//
+// Reads what the client sent, answers its complete requests and writes the
+// responses, as far as the socket takes them without blocking. Returns false
+// if the connection is to be closed.
+//
+bool Server::_serve(Connection & connection, uint32_t events, ServerStats & stats) {
+    if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !connection.peerClosed && !_read(connection))
+        return false;
+
+    // Answering stops at the high water mark, and resumes as the responses
+    // are written
+    while (true) {
+        size_t answered = connection.requests;
+        if (!_answer(connection, stats) || !_write(connection))
+            return false;
+        if (connection.requests == answered || connection.output.size() >= OUTPUT_HIGH_WATER)
+            break;
+    }
+
+    bool pendingOutput = !connection.output.empty();
+    if (connection.peerClosed && !pendingOutput)
+        return false;
+
+    uint32_t wanted = 0;
+    if (pendingOutput)
+        wanted |= EPOLLOUT;
+    if (!connection.peerClosed && connection.output.size() < OUTPUT_HIGH_WATER
+        && connection.input.size() - connection.inputStart < INPUT_HIGH_WATER)
+        wanted |= EPOLLIN;
+    if (wanted != connection.events) {
+        connection.events = wanted;
+        epoll_event event = {};
+        event.events = wanted;
+        event.data.fd = connection.fd;
+        epoll_ctl(_epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+    return true;
+}
+
+
+// Reads until the socket is drained or INPUT_HIGH_WATER bytes are unanswered;
+// false on an error. The rest stays in the socket, and epoll reports it again.
+bool Server::_read(Connection & connection) {
+    char buffer[READ_SIZE];
+    while (connection.input.size() - connection.inputStart < INPUT_HIGH_WATER) {
+        ssize_t count = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (count > 0) {
+            connection.input.append(buffer, count);
+            continue;
+        }
+        if (count == 0) {
+            connection.peerClosed = true;
+            return true;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    return true;
+}
+
+
+// Answers the complete requests in the input; false for a request too long
+bool Server::_answer(Connection & connection, ServerStats & stats) {
+    string & input = connection.input;
+    while (connection.output.size() < OUTPUT_HIGH_WATER && input.size() - connection.inputStart >= 4) {
+        uint32_t length = readLength(&input[connection.inputStart]);
+        if (length > MAX_REQUEST_SIZE)
+            return false;
+        if (input.size() - connection.inputStart - 4 < length)
+            break;
+
+        _line.assign(input, connection.inputStart + 4, length);
+        connection.inputStart += 4 + length;
+        const Result & result = _evaluator.evaluate(_line);
+        stats.requests++;
+        stats.errors += !result.ok;
+
+        _response.clear();
+        BatchEvaluator::formatResult(_response, ++connection.requests, result);
+        _response.pop_back();
+        appendLength(connection.output, (uint32_t)_response.size());
+        connection.output += _response;
+    }
+
+    // Drop the answered requests once they are most of the buffer
+    if (connection.inputStart > input.size() / 2) {
+        input.erase(0, connection.inputStart);
+        connection.inputStart = 0;
+    }
+    return true;
+}
+
+
+// Writes as much of the output as the socket takes; false on an error
+bool Server::_write(Connection & connection) {
+    string & output = connection.output;
+    while (connection.outputStart < output.size()) {
+        ssize_t count = send(connection.fd, output.data() + connection.outputStart,
+            output.size() - connection.outputStart, MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+            return false;
+        }
+        connection.outputStart += count;
+    }
+
+    if (connection.outputStart == output.size()) {
+        output.clear();
+        connection.outputStart = 0;
+    } else if (connection.outputStart > output.size() / 2) {
+        output.erase(0, connection.outputStart);
+        connection.outputStart = 0;
+    }
+    return true;
+}
+
+
+void Server::_close(int fd) {
+    epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
+    ::close(fd);
+    _connections.erase(fd);
+}
+
+#else
+
+Server::~Server() {}
+
+
+bool Server::listen(const string &) {
+    cerr << "Error: The server mode needs epoll, which is only on Linux" << endl;
+    return false;
+}
+
+
+ServerStats Server::run() {
+    return ServerStats();
+}
+
+
+void Server::stop() {}
+
+#endif
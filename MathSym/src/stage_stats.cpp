@@ -0,0 +1,93 @@
+#include "stage_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <string>
+
+using namespace std;
+
+
+const int StageStats::NUM_BUCKETS;
+
+
+namespace {
+
+// Duration in ns with a unit that keeps it to at most 4 digits, rounded
+// down, e.g. 512ns, 65us, 2ms
+string formatDuration(uint64_t ns) {
+    const char * units[] = { "ns", "us", "ms", "s" };
+    int unit = 0;
+    while (unit < 3 && ns >= 10000) {
+        ns /= 1000;
+        unit++;
+    }
+    return to_string(ns) + units[unit];
+}
+
+}
+
+
+const char * StageStats::stageName(Stage stage) {
+    switch (stage) {
+        case TOKENIZE: return "tokenize";
+        case PARSE: return "parse";
+        case SHARE: return "share";
+        case EVALUATE: return "evaluate";
+        case SOLVE: return "solve";
+        default: return "";
+    }
+}
+
+
+uint64_t StageStats::percentileNs(Stage stage, double fraction) const {
+    const StageCounters & counters = _stages[stage];
+    uint64_t rank = (uint64_t)ceil(fraction * (double)counters.calls), count = 0;
+    for (int bucket = 0; bucket < NUM_BUCKETS - 1; bucket++) {
+        count += counters.histogram[bucket];
+        if (count >= rank)
+            return min(counters.maxNs, (uint64_t)1 << bucket);
+    }
+    return counters.maxNs;
+}
+
+
+void StageStats::print(ostream & out) const {
+    out << left << setw(10) << "Stage" << right << setw(12) << "Calls" << setw(12) << "Mean us"
+        << setw(12) << "p50 us" << setw(12) << "p99 us" << setw(12) << "Max us" << endl;
+    out << fixed << setprecision(2);
+    for (int i = 0; i < NUM_STAGES; i++) {
+        Stage stage = (Stage)i;
+        const StageCounters & counters = _stages[i];
+        out << left << setw(10) << stageName(stage) << right << setw(12) << counters.calls
+            << setw(12) << (counters.calls ? counters.totalNs / 1e3 / (double)counters.calls : 0)
+            << setw(12) << percentileNs(stage, 0.5) / 1e3
+            << setw(12) << percentileNs(stage, 0.99) / 1e3
+            << setw(12) << counters.maxNs / 1e3 << endl;
+    }
+
+    // Only the nonempty buckets, by their upper bound
+    out << endl << "Latency histograms (calls below each bound):" << endl;
+    for (int i = 0; i < NUM_STAGES; i++) {
+        const StageCounters & counters = _stages[i];
+        if (counters.calls == 0)
+            continue;
+        out << "  " << left << setw(10) << stageName((Stage)i) << right;
+        for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+            if (counters.histogram[bucket] == 0)
+                continue;
+            out << ' ' << (bucket < NUM_BUCKETS - 1 ? "<" + formatDuration((uint64_t)1 << bucket) : "more")
+                << ':' << counters.histogram[bucket];
+        }
+        out << endl;
+    }
+
+    uint64_t parses = _stages[PARSE].calls;
+    out << endl << "AST nodes: " << _astNodes << " (" << (parses ? (double)_astNodes / (double)parses : 0)
+        << " per parse, " << _maxASTNodes << " at most)" << endl;
+    out << "New AST arena chunks: " << _arenaOverflows << endl;
+    out << "Repeated subexpressions: " << _skippedEvaluations << " evaluations skipped" << endl;
+    out << "Largest polynomial: " << _maxPolynomialSize << " coefficients" << endl;
+    out.unsetf(ios::floatfield);
+    out << setprecision(6);
+}
@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+WorkStealingPool::WorkStealingPool(size_t numThreads) : _nextQueue(0) {
+    if (numThreads == 0)
+        numThreads = max(1u, thread::hardware_concurrency());
+
+    for (size_t i = 0; i < numThreads; i++)
+        _queues.emplace_back(new Queue());
+    for (size_t i = 0; i < numThreads; i++)
+        _threads.emplace_back(&WorkStealingPool::_work, this, i);
+}
+
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _taskAvailable.notify_all();
+    for (auto & thread : _threads)
+        thread.join();
+}
+
+
+void WorkStealingPool::submit(Task task) {
+    // Counted before it is queued, so that a worker never takes a task that
+    // has not been counted yet
+    {
+        lock_guard<mutex> lock(_mutex);
+        _queuedTasks++;
+    }
+
+    Queue & queue = *_queues[_nextQueue++ % _queues.size()];
+    {
+        lock_guard<mutex> lock(queue.mutex);
+        queue.tasks.push_back(move(task));
+    }
+    _taskAvailable.notify_one();
+}
+
+
+void WorkStealingPool::_work(size_t worker) {
+    while (true) {
+        Task task;
+        if (_takeTask(worker, task)) {
+            task(worker);
+            continue;
+        }
+
+        unique_lock<mutex> lock(_mutex);
+        _taskAvailable.wait(lock, [this] { return _queuedTasks > 0 || _stopping; });
+        if (_queuedTasks == 0 && _stopping)
+            return;
+    }
+}
+
+
+bool WorkStealingPool::_takeTask(size_t worker, Task & task) {
+    // Own queue first, oldest task first, then steal the newest task of the
+    // other queues
+    for (size_t i = 0; i < _queues.size(); i++) {
+        Queue & queue = *_queues[(worker + i) % _queues.size()];
+        lock_guard<mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        if (i == 0) {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        break;
+    }
+    if (!task)
+        return false;
+
+    lock_guard<mutex> lock(_mutex);
+    _queuedTasks--;
+    return true;
+}
@@ -1,6 +1,7 @@
 #include "tokenizer.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 
@@ -25,7 +26,7 @@ bool Tokenizer::init(const string & configFile) {
             continue;
 
         // Remove all whitespace from the config line
-        auto truncEnd = remove_if(line.begin(), line.end(), isspace);
+        auto truncEnd = remove_if(line.begin(), line.end(), [](char c) {return isspace(c) != 0; });
         line.erase(truncEnd, line.end());
 
         auto delimPos = line.find(':');
@@ -37,57 +38,54 @@ bool Tokenizer::init(const string & configFile) {
 
         // Create a new rule for the regular expression of the line
         try {
-            _rules.push_back({ line.substr(0, delimPos), regex(line.substr(delimPos + 1)) });
-        } catch (const regex_error & e) {
+            _dfa.addRule(line.substr(delimPos + 1));
+        } catch (const DFA::SyntaxError & e) {
             cerr << "Error: Malformed regular expression in line " << lineCount
                 << " of file " << configFile << endl;
             cout << "       " << e.what() << endl;
             return false;
         }
+
+        // Rules of the same token type share the same token kind
+        string type = line.substr(0, delimPos);
+        auto itKind = find(_kindNames.begin() + TOKEN_EOF + 1, _kindNames.end(), type);
+        _ruleKinds.push_back((int)(itKind - _kindNames.begin()));
+        if (itKind == _kindNames.end())
+            _kindNames.push_back(type);
     }
 
+    // Combine all the rules into a single automaton
+    _dfa.compile();
+
     return true;
 }
 
-bool Tokenizer::tokenize(string & line, vector<Token> & tokens) {
-    // Remove all whitespace from the input command
-    auto lineEnd = remove_if(line.begin(), line.end(), isspace);
-    line.erase(lineEnd, line.end());
+bool Tokenizer::tokenize(const char * begin, const char * end, vector<Token> & tokens, Result & result) const {
+    // Token offsets are 32-bit
+    if (end - begin > (ptrdiff_t)UINT32_MAX) {
+        result.setError("Input line is too long");
+        return false;
+    }
 
     // Go through the whole command line and tokenize it fully, i.e. making sure that each
     // character belongs to one token, specified by the rules read from the config file
-    size_t inPos = 0;
-    while (inPos < line.size()) {
-        bool matched = false;
-        for (size_t i = 0; i < _rules.size(); i++) {
-            const Rule & rule = _rules[i];
-
-            smatch match;
-            try {
-                if (!regex_search(line.cbegin() + inPos, line.cend(), match, rule.regex,
-                    regex_constants::match_continuous))
-                    continue;
-
-                // Found the next token
-                tokens.push_back({ rule.type, match.str() });
-                inPos += match.length();
-                matched = true;
-                break;
-
-            } catch (const regex_error & e) {
-                cerr << "Error: Failed to run regular expression" << endl;
-                cout << "       " << e.what() << endl;
-                return false;
-            }
-        }
-
-        if (matched == false) {
-            cerr << line << endl;
-            for (size_t i = 0; i < inPos; i++)  cerr << ' ';
-            cerr << '|' << endl;
-            cerr << "Error: Invalid character in input" << endl << endl;
+    const char * pos = begin;
+    while (true) {
+        while (pos != end && isspace((unsigned char)*pos))
+            pos++;
+        if (pos == end)
+            break;
+
+        size_t length;
+        int rule = _dfa.match(pos, end, length);
+        if (rule == -1) {
+            result.setError("Invalid character in input", pos - begin);
             return false;
         }
+
+        // Found the next token
+        tokens.push_back({ _ruleKinds[rule], (uint32_t)(pos - begin), (uint32_t)length });
+        pos += length;
     }
 
     return true;
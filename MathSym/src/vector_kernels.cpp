@@ -0,0 +1,218 @@
+#include "vector_kernels.h"
+
+#include <cmath>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2
+#endif
+
+using namespace std;
+
+
+namespace {
+
+//
+// One register of doubles of the target instruction set. The kernels below
+// are written once against it; the remainder of each array that does not
+// fill a register is done with Scalar, which rounds the same way (there is
+// no fused multiply-add), so a value does not depend on its position.
+//
+#if defined(__AVX__)
+struct Vector {
+    static const size_t WIDTH = 4;
+    __m256d v;
+
+    static Vector load(const double * p) { return { _mm256_loadu_pd(p) }; }
+    static Vector broadcast(double value) { return { _mm256_set1_pd(value) }; }
+    void store(double * p) const { _mm256_storeu_pd(p, v); }
+    Vector operator+(Vector rhs) const { return { _mm256_add_pd(v, rhs.v) }; }
+    Vector operator-(Vector rhs) const { return { _mm256_sub_pd(v, rhs.v) }; }
+    Vector operator*(Vector rhs) const { return { _mm256_mul_pd(v, rhs.v) }; }
+    Vector operator/(Vector rhs) const { return { _mm256_div_pd(v, rhs.v) }; }
+};
+const char * INSTRUCTION_SET = "AVX";
+#elif defined(USE_SSE2)
+struct Vector {
+    static const size_t WIDTH = 2;
+    __m128d v;
+
+    static Vector load(const double * p) { return { _mm_loadu_pd(p) }; }
+    static Vector broadcast(double value) { return { _mm_set1_pd(value) }; }
+    void store(double * p) const { _mm_storeu_pd(p, v); }
+    Vector operator+(Vector rhs) const { return { _mm_add_pd(v, rhs.v) }; }
+    Vector operator-(Vector rhs) const { return { _mm_sub_pd(v, rhs.v) }; }
+    Vector operator*(Vector rhs) const { return { _mm_mul_pd(v, rhs.v) }; }
+    Vector operator/(Vector rhs) const { return { _mm_div_pd(v, rhs.v) }; }
+};
+const char * INSTRUCTION_SET = "SSE2";
+#endif
+
+struct Scalar {
+    static const size_t WIDTH = 1;
+    double v;
+
+    static Scalar load(const double * p) { return { *p }; }
+    static Scalar broadcast(double value) { return { value }; }
+    void store(double * p) const { *p = v; }
+    Scalar operator+(Scalar rhs) const { return { v + rhs.v }; }
+    Scalar operator-(Scalar rhs) const { return { v - rhs.v }; }
+    Scalar operator*(Scalar rhs) const { return { v * rhs.v }; }
+    Scalar operator/(Scalar rhs) const { return { v / rhs.v }; }
+};
+
+#if !defined(__AVX__) && !defined(USE_SSE2)
+typedef Scalar Vector;
+const char * INSTRUCTION_SET = "scalar";
+#endif
+
+
+// Applies op to the elements [i, count) with registers of type V, and
+// returns the index of the first element left over
+template<typename V, typename Op>
+size_t binaryLoop(const double * a, const double * b, size_t i, size_t count, double * out, Op op) {
+    for (; i + V::WIDTH <= count; i += V::WIDTH)
+        op(V::load(a + i), V::load(b + i)).store(out + i);
+    return i;
+}
+
+template<typename Op>
+void binary(const double * a, const double * b, size_t count, double * out, Op op) {
+    size_t i = binaryLoop<Vector>(a, b, 0, count, out, op);
+    binaryLoop<Scalar>(a, b, i, count, out, op);
+}
+
+
+// Horner's rule on UNROLL registers of x values at a time, since each
+// register alone waits on the latency of every multiply and add
+template<typename V, size_t UNROLL>
+size_t hornerLoop(const double * coefficients, size_t numCoefficients, const double * xs,
+    size_t i, size_t count, double * out) {
+    for (; i + UNROLL * V::WIDTH <= count; i += UNROLL * V::WIDTH) {
+        V x[UNROLL], y[UNROLL];
+        for (size_t u = 0; u < UNROLL; u++) {
+            x[u] = V::load(xs + i + u * V::WIDTH);
+            y[u] = V::broadcast(coefficients[numCoefficients - 1]);
+        }
+        for (size_t k = numCoefficients - 1; k-- > 0; ) {
+            V c = V::broadcast(coefficients[k]);
+            for (size_t u = 0; u < UNROLL; u++)
+                y[u] = y[u] * x[u] + c;
+        }
+        for (size_t u = 0; u < UNROLL; u++)
+            y[u].store(out + i + u * V::WIDTH);
+    }
+    return i;
+}
+
+
+// Index of the lowest set bit of a nonzero mask
+inline unsigned lowestBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+}   // namespace
+
+
+void VectorKernels::horner(const double * coefficients, size_t numCoefficients,
+    const double * xs, size_t count, double * out) {
+    if (numCoefficients == 0) {
+        fill(0, count, out);
+        return;
+    }
+
+    size_t i = hornerLoop<Vector, 4>(coefficients, numCoefficients, xs, 0, count, out);
+    i = hornerLoop<Vector, 1>(coefficients, numCoefficients, xs, i, count, out);
+    hornerLoop<Scalar, 1>(coefficients, numCoefficients, xs, i, count, out);
+}
+
+
+void VectorKernels::fill(double value, size_t count, double * out) {
+    Vector v = Vector::broadcast(value);
+    size_t i = 0;
+    for (; i + Vector::WIDTH <= count; i += Vector::WIDTH)
+        v.store(out + i);
+    for (; i < count; i++)
+        out[i] = value;
+}
+
+
+void VectorKernels::add(const double * a, const double * b, size_t count, double * out) {
+    binary(a, b, count, out, [](auto lhs, auto rhs) { return lhs + rhs; });
+}
+
+
+void VectorKernels::subtract(const double * a, const double * b, size_t count, double * out) {
+    binary(a, b, count, out, [](auto lhs, auto rhs) { return lhs - rhs; });
+}
+
+
+void VectorKernels::multiply(const double * a, const double * b, size_t count, double * out) {
+    binary(a, b, count, out, [](auto lhs, auto rhs) { return lhs * rhs; });
+}
+
+
+void VectorKernels::divide(const double * a, const double * b, size_t count, double * out) {
+    binary(a, b, count, out, [](auto lhs, auto rhs) { return lhs / rhs; });
+}
+
+
+void VectorKernels::negate(const double * a, size_t count, double * out) {
+    // 0 - a rather than -a, so that a zero value does not become -0
+    Vector zero = Vector::broadcast(0);
+    size_t i = 0;
+    for (; i + Vector::WIDTH <= count; i += Vector::WIDTH)
+        (zero - Vector::load(a + i)).store(out + i);
+    for (; i < count; i++)
+        out[i] = 0 - a[i];
+}
+
+
+void VectorKernels::power(const double * a, const double * b, size_t count, double * out) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = pow(a[i], b[i]);
+}
+
+
+size_t VectorKernels::findLineBreaks(const char * begin, const char * end, const char ** breaks,
+    size_t maxCount) {
+
+    size_t count = 0;
+    const char * p = begin;
+#if defined(__AVX__) || defined(USE_SSE2)
+    // A mask with a bit per byte equal to '\n', whose set bits are taken
+    // lowest first
+    const __m128i lineBreak = _mm_set1_epi8('\n');
+    for (; end - p >= 16 && count < maxCount; p += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, lineBreak));
+        for (; mask != 0; mask &= mask - 1) {
+            breaks[count++] = p + lowestBit(mask);
+            if (count == maxCount)
+                return count;
+        }
+    }
+#endif
+    for (; p != end && count < maxCount; p++) {
+        if (*p == '\n')
+            breaks[count++] = p;
+    }
+    return count;
+}
+
+
+const char * VectorKernels::instructionSet() {
+    return INSTRUCTION_SET;
+}